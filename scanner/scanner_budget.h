@@ -0,0 +1,314 @@
+/*
+   scanner_budget.h - per-cycle CPU / wall / I/O budget with a resumable cursor
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_env.c -o scanner_env
+
+   Heavy scanners (env, libs, proc_open_files, file_hashes) walk items in a stable
+   order (PIDs ascending, paths depth-first by name) and check the budget before each
+   item but the first: a cycle always finishes at least one item, so setup work
+   (cache loads, directory listing) eating the whole budget cannot stall the pass.
+   When a limit is hit the scan stops, the last finished item is written to the
+   cursor file, and the next cycle resumes after it; a cycle that reaches the end
+   clears the cursor, so every item is covered within a bounded number of cycles.
+
+       --budget-cpu-ms <ms>    process CPU time (all threads) per cycle
+       --budget-wall-ms <ms>   elapsed time per cycle (with --max-core-pct an item in
+                               progress still finishes, throttled, past the limit)
+       --budget-io-kb <kb>     bytes read (rchar of /proc/self/io) per cycle
+       --max-core-pct <pct>    CPU time stays within pct% of the time elapsed since
+                               budget_init(), i.e. pct% of one core whatever the host
+                               size. Setup, sorting and output count too; the excess
+                               is slept off before each item, inside long reads (maps
+                               lines, hashed file chunks, fd entries, cache loads) via
+                               budget_throttle(), and in budget_finish(). The clock is
+                               checked at most once per elapsed millisecond, so the cap
+                               holds to within about 1 ms of CPU
+       --cursor <file>         where the resume point is kept (needed for rotation)
+
+       ScanBudget b;
+       budget_init(&b);
+       ... if (budget_arg(&b, argc, argv, &i)) continue; ...
+       budget_begin(&b);                        loads the cursor
+       for each item after budget_resume_*():
+           if (budget_stop(&b)) break;          limit reached (or throttles)
+           ... work ... budget_throttle(&b);    in loops that can run long
+           budget_done_pid(&b, pid);            / budget_done_path()
+       budget_finish(&b);                       throttles, saves the cursor (temp + rename)
+
+   With any budget flag the scanner output becomes {"rows":<usual output>,"coverage":{...}}
+   (budget_print_coverage closes it): complete, resumed_after, cursor, items,
+   pass_cycles, pass_started, stopped_by and the CPU/wall/I/O actually spent.
+   Cursor file (text):
+       cursor <last item, empty = start of a pass>
+       cycles <cycles spent on the current pass>
+       started <unix time the current pass began>
+*/
+#ifndef SCANNER_BUDGET_H
+#define SCANNER_BUDGET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    unsigned long cpu_ms;          /* limits, 0 = none */
+    unsigned long wall_ms;
+    unsigned long io_kb;
+    unsigned int  core_pct;        /* --max-core-pct, 0 = no throttle */
+    const char   *cursor_file;
+
+    struct timespec cpu_start;     /* this cycle */
+    struct timespec wall_start;
+    struct timespec run_cpu_start; /* since budget_init(): --max-core-pct window */
+    struct timespec run_wall_start;
+    unsigned long long next_throttle_ns; /* run wall time of the next --max-core-pct check */
+    unsigned long long io_start;
+    char   resume[PATH_MAX];       /* loaded cursor: resume after this item ("" = from the start) */
+    char   last[PATH_MAX];         /* last item finished this cycle */
+    unsigned long pass_cycles;     /* cycles spent on the current pass, this one included */
+    long long pass_started;        /* unix time the current pass began */
+    size_t items;
+    const char *stopped_by;        /* limit that ended the cycle, NULL = reached the end */
+    unsigned long long throttled_ns;
+} ScanBudget;
+
+static inline void budget_init(ScanBudget *b) {
+    memset(b, 0, sizeof(*b));
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &b->run_cpu_start);
+    clock_gettime(CLOCK_MONOTONIC, &b->run_wall_start);
+}
+
+/* Any budget or cursor flag given: output carries coverage metadata */
+static inline bool budget_active(const ScanBudget *b) {
+    return b->cpu_ms || b->wall_ms || b->io_kb || b->core_pct || b->cursor_file;
+}
+
+/* Consume one of the budget flags at argv[*i] */
+static inline bool budget_arg(ScanBudget *b, int argc, char **argv, int *i) {
+    if (*i + 1 >= argc) return false;
+    const char *flag = argv[*i];
+    if (strcmp(flag, "--budget-cpu-ms") == 0) {
+        b->cpu_ms = strtoul(argv[++*i], NULL, 10);
+    } else if (strcmp(flag, "--budget-wall-ms") == 0) {
+        b->wall_ms = strtoul(argv[++*i], NULL, 10);
+    } else if (strcmp(flag, "--budget-io-kb") == 0) {
+        b->io_kb = strtoul(argv[++*i], NULL, 10);
+    } else if (strcmp(flag, "--max-core-pct") == 0) {
+        b->core_pct = (unsigned int)strtoul(argv[++*i], NULL, 10);
+        if (b->core_pct > 100) b->core_pct = 100;
+    } else if (strcmp(flag, "--cursor") == 0) {
+        b->cursor_file = argv[++*i];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static inline unsigned long long budget_ns_since(clockid_t clock, const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    long long ns = (long long)(now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+    return ns > 0 ? (unsigned long long)ns : 0;
+}
+
+/* rchar of this process: every byte read(), procfs included */
+static inline unsigned long long budget_io_bytes(void) {
+    FILE *f = fopen("/proc/self/io", "re");
+    if (!f) return 0;
+    unsigned long long rchar = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "rchar: %llu", &rchar) == 1) break;
+    }
+    fclose(f);
+    return rchar;
+}
+
+/* Sleep owed under --max-core-pct: CPU time since budget_init() above pct% of the elapsed time */
+static inline unsigned long long budget_throttle_due(const ScanBudget *b, unsigned long long *wall_ns) {
+    *wall_ns = budget_ns_since(CLOCK_MONOTONIC, &b->run_wall_start);
+    /* cpu / wall <= pct / 100, so wall must reach cpu * 100 / pct */
+    unsigned long long need_ns = budget_ns_since(CLOCK_PROCESS_CPUTIME_ID, &b->run_cpu_start) * 100ULL / b->core_pct;
+    return need_ns > *wall_ns ? need_ns - *wall_ns : 0;
+}
+
+static inline void budget_sleep(ScanBudget *b, unsigned long long wall_ns, unsigned long long ns) {
+    if (ns) {
+        struct timespec ts = { .tv_sec = (time_t)(ns / 1000000000ULL), .tv_nsec = (long)(ns % 1000000000ULL) };
+        nanosleep(&ts, NULL);
+        b->throttled_ns += ns;
+    }
+    b->next_throttle_ns = wall_ns + ns + 1000000ULL;
+}
+
+/* --max-core-pct inside an item; cheap enough per line (one monotonic read between checks) */
+static inline void budget_throttle(ScanBudget *b) {
+    if (!b->core_pct) return;
+    if (budget_ns_since(CLOCK_MONOTONIC, &b->run_wall_start) < b->next_throttle_ns) return;
+    unsigned long long wall_ns;
+    unsigned long long ns = budget_throttle_due(b, &wall_ns);
+    budget_sleep(b, wall_ns, ns);
+}
+
+/* budget_throttle() as a void * callback (sha256_fd_progress, HashCache.progress) */
+static inline void budget_throttle_cb(void *b) {
+    budget_throttle(b);
+}
+
+/* Start the cycle: load the cursor and take the clocks */
+static inline void budget_begin(ScanBudget *b) {
+    b->resume[0] = b->last[0] = '\0';
+    b->pass_cycles = 0;
+    b->pass_started = 0;
+    b->items = 0;
+    b->stopped_by = NULL;
+    b->throttled_ns = 0;
+
+    FILE *f = b->cursor_file ? fopen(b->cursor_file, "re") : NULL;
+    if (f) {
+        char line[PATH_MAX + 16];
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\n")] = '\0';
+            size_t len = strlen(line);
+            if (strncmp(line, "cursor ", 7) == 0 && len - 7 < sizeof(b->resume)) {
+                memcpy(b->resume, line + 7, len - 7 + 1);
+            } else if (strncmp(line, "cycles ", 7) == 0) {
+                b->pass_cycles = strtoul(line + 7, NULL, 10);
+            } else if (strncmp(line, "started ", 8) == 0) {
+                b->pass_started = strtoll(line + 8, NULL, 10);
+            }
+        }
+        fclose(f);
+    }
+    if (!b->resume[0]) {
+        b->pass_cycles = 0;
+        b->pass_started = (long long)time(NULL);
+    }
+    b->pass_cycles++;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &b->cpu_start);
+    clock_gettime(CLOCK_MONOTONIC, &b->wall_start);
+    if (b->io_kb) b->io_start = budget_io_bytes();
+}
+
+/* PID to resume after (0 = from the start) */
+static inline int budget_resume_pid(const ScanBudget *b) {
+    return b->resume[0] ? atoi(b->resume) : 0;
+}
+
+/* Path to resume after ("" = from the start) */
+static inline const char *budget_resume_path(const ScanBudget *b) {
+    return b->resume;
+}
+
+/*
+   Before each item: true once a limit is reached (the item is left for the next
+   cycle). Otherwise, with --max-core-pct, sleep off any CPU use above the share
+   (setup before the first item included). The first item of a cycle always runs,
+   so the cursor advances every cycle.
+*/
+static inline bool budget_stop(ScanBudget *b) {
+    if (b->stopped_by) return true;
+    if (!b->cpu_ms && !b->wall_ms && !b->io_kb && !b->core_pct) return false;
+
+    unsigned long long wall_ns = budget_ns_since(CLOCK_MONOTONIC, &b->wall_start);
+    if (b->items > 0) {
+        unsigned long long cpu_ns = budget_ns_since(CLOCK_PROCESS_CPUTIME_ID, &b->cpu_start);
+        if (b->cpu_ms && cpu_ns >= (unsigned long long)b->cpu_ms * 1000000ULL) b->stopped_by = "cpu_ms";
+        if (b->wall_ms && wall_ns >= (unsigned long long)b->wall_ms * 1000000ULL) b->stopped_by = "wall_ms";
+        if (b->io_kb && budget_io_bytes() - b->io_start >= (unsigned long long)b->io_kb * 1024ULL) b->stopped_by = "io_kb";
+        if (b->stopped_by) return true;
+    }
+
+    if (b->core_pct) {
+        unsigned long long run_wall_ns;
+        unsigned long long ns = budget_throttle_due(b, &run_wall_ns);
+        if (b->items > 0 && b->wall_ms && wall_ns + ns > (unsigned long long)b->wall_ms * 1000000ULL) {
+            b->stopped_by = "wall_ms";   /* the sleep alone would overrun */
+            return true;
+        }
+        budget_sleep(b, run_wall_ns, ns);
+    }
+    return false;
+}
+
+static inline void budget_done_pid(ScanBudget *b, int pid) {
+    snprintf(b->last, sizeof(b->last), "%d", pid);
+    b->items++;
+}
+
+static inline void budget_done_path(ScanBudget *b, const char *path) {
+    snprintf(b->last, sizeof(b->last), "%s", path);
+    b->items++;
+}
+
+/* Did this cycle start at the beginning and reach the end? */
+static inline bool budget_full_pass(const ScanBudget *b) {
+    return !b->resume[0] && !b->stopped_by;
+}
+
+/* End the cycle: pay off the output's CPU share, then write where the next one resumes (temp file + rename) */
+static inline int budget_finish(ScanBudget *b) {
+    b->next_throttle_ns = 0;
+    budget_throttle(b);
+    if (!b->cursor_file) return 0;
+
+    char tmp[PATH_MAX];
+    int needed = snprintf(tmp, sizeof(tmp), "%s.tmp", b->cursor_file);
+    if (needed < 0 || needed >= (int)sizeof(tmp)) return -1;
+    FILE *f = fopen(tmp, "we");
+    if (!f) {
+        fprintf(stderr, "Cannot write cursor '%s'\n", tmp);
+        return -1;
+    }
+    if (b->stopped_by) {
+        /* Nothing finished: keep the old resume point rather than restarting the pass */
+        fprintf(f, "cursor %s\ncycles %lu\nstarted %lld\n",
+                b->last[0] ? b->last : b->resume, b->pass_cycles, b->pass_started);
+    } else {
+        fprintf(f, "cursor \ncycles 0\nstarted %lld\n", (long long)time(NULL));
+    }
+    if (fclose(f) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return rename(tmp, b->cursor_file);
+}
+
+static inline void budget_print_string(const char *s) {
+    if (!s || !*s) {
+        printf("null");
+        return;
+    }
+    printf("\"");
+    for (const char *p = s; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
+    }
+    printf("\"");
+}
+
+/* Closes the {"rows": ...} object the caller opened before the scan */
+static inline void budget_print_coverage(const ScanBudget *b) {
+    unsigned long long cpu_ns = budget_ns_since(CLOCK_PROCESS_CPUTIME_ID, &b->cpu_start);
+    unsigned long long wall_ns = budget_ns_since(CLOCK_MONOTONIC, &b->wall_start);
+
+    printf(",\"coverage\":{\"complete\":%s,\"resumed_after\":", b->stopped_by ? "false" : "true");
+    budget_print_string(b->resume);
+    printf(",\"cursor\":");
+    budget_print_string(b->stopped_by ? (b->last[0] ? b->last : b->resume) : NULL);
+    printf(",\"items\":%zu,\"pass_cycles\":%lu,\"pass_started\":%lld,\"stopped_by\":",
+           b->items, b->pass_cycles, b->pass_started);
+    budget_print_string(b->stopped_by);
+    printf(",\"cpu_ms\":%llu,\"wall_ms\":%llu,\"throttled_ms\":%llu",
+           cpu_ns / 1000000ULL, wall_ns / 1000000ULL, b->throttled_ns / 1000000ULL);
+    if (b->io_kb) printf(",\"io_kb\":%llu", (budget_io_bytes() - b->io_start) / 1024ULL);
+    printf("}}\n");
+}
+
+#endif /* SCANNER_BUDGET_H */
@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>       /* for clock_gettime, nanosleep */
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* some/full lines of a PSI file (cpu.pressure, memory.pressure, io.pressure) */
+typedef struct {
+    bool   present;
+    double some_avg10;
+    double full_avg10;
+    unsigned long long some_total_us;  /* cumulative stall time */
+    unsigned long long full_total_us;
+} Pressure;
+
+typedef struct {
+    char  *path;                    /* relative to the root, "/" for the root itself */
+    unsigned long long id;          /* directory inode = cgroup id; a recreated cgroup gets a new one */
+    int    depth;
+    bool   has_cpu;                 /* cpu.stat read */
+    unsigned long long usage_usec;
+    unsigned long long user_usec;
+    unsigned long long system_usec;
+    unsigned long long nr_periods;  /* cpu.max enforcement periods */
+    unsigned long long nr_throttled;
+    unsigned long long throttled_usec;
+    bool   has_memory;              /* memory.current read */
+    unsigned long long memory_current;
+    unsigned long long memory_max;  /* 0 = "max" (unlimited) */
+    unsigned long long anon;        /* memory.stat */
+    unsigned long long file;        /* page cache, which per-process RSS sums miss */
+    unsigned long long kernel;
+    unsigned long long shmem;
+    unsigned long long sock;
+    unsigned long long file_dirty;
+    unsigned long long pgmajfault;
+    unsigned long long oom_kill;    /* memory.events */
+    bool   has_io;                  /* io.stat read */
+    unsigned long long rbytes;      /* io.stat, summed over devices */
+    unsigned long long wbytes;
+    unsigned long long rios;
+    unsigned long long wios;
+    Pressure cpu_pressure;
+    Pressure memory_pressure;
+    Pressure io_pressure;
+    bool   has_rate;                /* rates below are filled (second sample) */
+    double cpu_pct;                 /* usage_usec delta / wall time, 100 = one CPU */
+    double throttled_ratio;         /* nr_throttled delta / nr_periods delta */
+    double throttled_pct;           /* throttled_usec delta / wall time */
+    double rbps, wbps, riops, wiops;
+    double pgmajfault_rate;
+    double cpu_some_pct, memory_some_pct, memory_full_pct, io_some_pct, io_full_pct;  /* stall share of wall time */
+} CgroupStat;
+
+typedef struct {
+    const char *root;
+    unsigned int threads;      /* parallel readers */
+    unsigned int interval_ms;  /* > 0: second sample, compute rates */
+    int    max_depth;          /* -1 = unlimited */
+} CgroupScanOptions;
+
+/* Shared work queue for the reader threads */
+typedef struct {
+    CgroupStat     *cgroups;
+    size_t          count;
+    size_t          next;      /* next index to hand out */
+    int             root_fd;
+    pthread_mutex_t lock;
+} CgroupWork;
+
+static int path_cmp(const void *a, const void *b) {
+    return strcmp(((const CgroupStat *)a)->path, ((const CgroupStat *)b)->path);
+}
+
+static unsigned long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+/* Whole small file under dirfd into buf; false if missing (controller not enabled) */
+static bool read_small_file(int dirfd, const char *name, char *buf, size_t len) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) return false;
+    buf[n] = '\0';
+    return true;
+}
+
+/* "key value" lines: value of key, or 0 */
+static unsigned long long flat_value(const char *buf, const char *key) {
+    size_t klen = strlen(key);
+    for (const char *line = buf; line && *line; ) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ' ') return strtoull(line + klen + 1, NULL, 10);
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return 0;
+}
+
+static void read_pressure(int dirfd, const char *name, Pressure *p) {
+    char buf[256];
+    if (!read_small_file(dirfd, name, buf, sizeof(buf))) return;
+    p->present = true;
+    for (char *line = buf; line && *line; ) {
+        double avg10;
+        unsigned long long total;
+        if (sscanf(line, "some avg10=%lf avg60=%*f avg300=%*f total=%llu", &avg10, &total) == 2) {
+            p->some_avg10 = avg10;
+            p->some_total_us = total;
+        } else if (sscanf(line, "full avg10=%lf avg60=%*f avg300=%*f total=%llu", &avg10, &total) == 2) {
+            p->full_avg10 = avg10;
+            p->full_total_us = total;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+/* io.stat: "MAJ:MIN rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N" per device */
+static void read_io_stat(int dirfd, CgroupStat *c) {
+    char buf[8192];
+    if (!read_small_file(dirfd, "io.stat", buf, sizeof(buf))) return;
+    c->has_io = true;
+    for (char *line = buf; line && *line; ) {
+        unsigned long long rb, wb, ri, wi;
+        if (sscanf(line, "%*u:%*u rbytes=%llu wbytes=%llu rios=%llu wios=%llu", &rb, &wb, &ri, &wi) == 4) {
+            c->rbytes += rb;
+            c->wbytes += wb;
+            c->rios += ri;
+            c->wios += wi;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+/* All controller files of one cgroup; missing files leave their has_* false */
+static void read_cgroup(int root_fd, CgroupStat *c) {
+    const char *rel = c->path[1] ? c->path + 1 : ".";
+    int dirfd = openat(root_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return;   /* removed since the walk */
+
+    char buf[8192];
+    if (read_small_file(dirfd, "cpu.stat", buf, sizeof(buf))) {
+        c->has_cpu = true;
+        c->usage_usec = flat_value(buf, "usage_usec");
+        c->user_usec = flat_value(buf, "user_usec");
+        c->system_usec = flat_value(buf, "system_usec");
+        c->nr_periods = flat_value(buf, "nr_periods");
+        c->nr_throttled = flat_value(buf, "nr_throttled");
+        c->throttled_usec = flat_value(buf, "throttled_usec");
+    }
+    if (read_small_file(dirfd, "memory.current", buf, sizeof(buf))) {
+        c->has_memory = true;
+        c->memory_current = strtoull(buf, NULL, 10);
+        if (read_small_file(dirfd, "memory.max", buf, sizeof(buf))) c->memory_max = strtoull(buf, NULL, 10);
+        if (read_small_file(dirfd, "memory.stat", buf, sizeof(buf))) {
+            c->anon = flat_value(buf, "anon");
+            c->file = flat_value(buf, "file");
+            c->kernel = flat_value(buf, "kernel");
+            c->shmem = flat_value(buf, "shmem");
+            c->sock = flat_value(buf, "sock");
+            c->file_dirty = flat_value(buf, "file_dirty");
+            c->pgmajfault = flat_value(buf, "pgmajfault");
+        }
+        if (read_small_file(dirfd, "memory.events", buf, sizeof(buf))) c->oom_kill = flat_value(buf, "oom_kill");
+    }
+    read_io_stat(dirfd, c);
+    read_pressure(dirfd, "cpu.pressure", &c->cpu_pressure);
+    read_pressure(dirfd, "memory.pressure", &c->memory_pressure);
+    read_pressure(dirfd, "io.pressure", &c->io_pressure);
+    close(dirfd);
+}
+
+static void *cgroup_worker(void *arg) {
+    CgroupWork *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        size_t slot = w->next < w->count ? w->next++ : w->count;
+        pthread_mutex_unlock(&w->lock);
+        if (slot >= w->count) break;
+
+        read_cgroup(w->root_fd, &w->cgroups[slot]);
+    }
+    return NULL;
+}
+
+static bool add_cgroup(CgroupStat **list, size_t *count, size_t *capacity,
+                       const char *path, unsigned long long id, int depth) {
+    if (*count >= *capacity) {
+        size_t newcap = *capacity ? *capacity * 2 : 1024;
+        CgroupStat *n = realloc(*list, newcap * sizeof(CgroupStat));
+        if (!n) return false;
+        *list = n;
+        *capacity = newcap;
+    }
+    CgroupStat *c = &(*list)[*count];
+    memset(c, 0, sizeof(*c));
+    c->path = strdup(path);
+    if (!c->path) return false;
+    c->id = id;
+    c->depth = depth;
+    (*count)++;
+    return true;
+}
+
+/*
+   Enumerate cgroup directories breadth-first (list is its own queue).
+   Only directory entries are listed here; the per-cgroup files are read by the threads.
+*/
+static CgroupStat *walk_cgroups(int root_fd, int max_depth, size_t *out_count) {
+    CgroupStat *list = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    struct stat st;
+    if (fstat(root_fd, &st) < 0 || !add_cgroup(&list, &count, &capacity, "/", st.st_ino, 0)) {
+        *out_count = 0;
+        return list;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (max_depth >= 0 && list[i].depth >= max_depth) continue;
+
+        const char *rel = list[i].path[1] ? list[i].path + 1 : ".";
+        int fd = openat(root_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) continue;
+        DIR *dir = fdopendir(fd);
+        if (!dir) {
+            close(fd);
+            continue;
+        }
+
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL) {
+            if (ent->d_type != DT_DIR || ent->d_name[0] == '.') continue;
+
+            char path[4096];
+            int needed = snprintf(path, sizeof(path), "%s%s%s",
+                                  list[i].path, list[i].path[1] ? "/" : "", ent->d_name);
+            if (needed < 0 || needed >= (int)sizeof(path)) continue;
+
+            /* list may move in add_cgroup: copy what we need first */
+            int depth = list[i].depth + 1;
+            if (!add_cgroup(&list, &count, &capacity, path, ent->d_ino, depth)) break;
+        }
+        closedir(dir);
+    }
+
+    *out_count = count;
+    return list;
+}
+
+/* One full sample: walk, then read all cgroups in parallel; returned sorted by path */
+static CgroupStat *take_cgroup_sample(int root_fd, const CgroupScanOptions *opts, size_t *out_count) {
+    size_t count = 0;
+    CgroupStat *list = walk_cgroups(root_fd, opts->max_depth, &count);
+    if (!list || count == 0) {
+        *out_count = 0;
+        return list;
+    }
+
+    CgroupWork w = { .cgroups = list, .count = count, .next = 0, .root_fd = root_fd };
+    pthread_mutex_init(&w.lock, NULL);
+
+    unsigned int nthreads = opts->threads ? opts->threads : 1;
+    if (nthreads > count) nthreads = (unsigned int)count;
+    pthread_t *tids = malloc(nthreads * sizeof(pthread_t));
+    unsigned int started = 0;
+    if (tids) {
+        for (; started < nthreads; started++) {
+            if (pthread_create(&tids[started], NULL, cgroup_worker, &w) != 0) break;
+        }
+    }
+    if (started == 0) cgroup_worker(&w);   /* no threads: read inline */
+    for (unsigned int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+
+    pthread_mutex_destroy(&w.lock);
+    free(tids);
+
+    qsort(list, count, sizeof(CgroupStat), path_cmp);
+    *out_count = count;
+    return list;
+}
+
+static void free_cgroups(CgroupStat *list, size_t count) {
+    for (size_t i = 0; i < count; i++) free(list[i].path);
+    free(list);
+}
+
+static double per_sec(unsigned long long now, unsigned long long before, double secs) {
+    return now >= before ? (double)(now - before) / secs : 0.0;
+}
+
+/* Stall time delta (us) as percent of wall time */
+static double stall_pct(unsigned long long now, unsigned long long before, double secs) {
+    return per_sec(now, before, secs) / 10000.0;
+}
+
+static void compute_cgroup_rates(CgroupStat *cur, size_t cur_count, const CgroupStat *prev, size_t prev_count, double secs) {
+    for (size_t i = 0; i < cur_count; i++) {
+        CgroupStat *c = &cur[i];
+        const CgroupStat *p = bsearch(c, prev, prev_count, sizeof(CgroupStat), path_cmp);
+        if (!p || p->id != c->id) continue;   /* new or recreated */
+
+        c->has_rate = true;
+        c->cpu_pct = per_sec(c->usage_usec, p->usage_usec, secs) / 10000.0;
+        unsigned long long periods = c->nr_periods >= p->nr_periods ? c->nr_periods - p->nr_periods : 0;
+        unsigned long long throttled = c->nr_throttled >= p->nr_throttled ? c->nr_throttled - p->nr_throttled : 0;
+        c->throttled_ratio = periods ? (double)throttled / (double)periods : 0.0;
+        c->throttled_pct = per_sec(c->throttled_usec, p->throttled_usec, secs) / 10000.0;
+        c->rbps = per_sec(c->rbytes, p->rbytes, secs);
+        c->wbps = per_sec(c->wbytes, p->wbytes, secs);
+        c->riops = per_sec(c->rios, p->rios, secs);
+        c->wiops = per_sec(c->wios, p->wios, secs);
+        c->pgmajfault_rate = per_sec(c->pgmajfault, p->pgmajfault, secs);
+        c->cpu_some_pct = stall_pct(c->cpu_pressure.some_total_us, p->cpu_pressure.some_total_us, secs);
+        c->memory_some_pct = stall_pct(c->memory_pressure.some_total_us, p->memory_pressure.some_total_us, secs);
+        c->memory_full_pct = stall_pct(c->memory_pressure.full_total_us, p->memory_pressure.full_total_us, secs);
+        c->io_some_pct = stall_pct(c->io_pressure.some_total_us, p->io_pressure.some_total_us, secs);
+        c->io_full_pct = stall_pct(c->io_pressure.full_total_us, p->io_pressure.full_total_us, secs);
+    }
+}
+
+static void print_pressure(const char *name, const Pressure *p) {
+    if (!p->present) return;
+    printf(",\"%s\":{\"some_avg10\":%.2f,\"full_avg10\":%.2f,\"some_total_us\":%llu,\"full_total_us\":%llu}",
+           name, p->some_avg10, p->full_avg10, p->some_total_us, p->full_total_us);
+}
+
+/* Default root: pure v2 mount, else the v2 part of a hybrid setup */
+static const char *default_cgroup_root(void) {
+    if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup";
+    if (access("/sys/fs/cgroup/unified/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup/unified";
+    return "/sys/fs/cgroup";
+}
+
+/*
+   Scanner: cgroup v2 resource use, read from the controllers' own accounting
+   For every cgroup under opts->root: cpu.stat, memory.current/max/stat/events,
+   io.stat (summed over devices) and cpu/memory/io.pressure. Unlike per-process
+   sums this includes reaped children, page cache and kernel memory.
+   The directory walk is single-threaded (cheap); the controller files are read
+   by opts->threads threads in parallel.
+   With opts->interval_ms a second sample is taken and rates are added: cpu_pct,
+   throttled_ratio (throttled / enforcement periods), throttled_pct, io bytes/ops
+   per second, major faults per second and PSI stall percentages. A cgroup is
+   matched by path and directory inode, so a recreated cgroup gets no rate.
+   Files of disabled controllers are simply absent from the row.
+   Output: JSON array → replace with DB insert
+*/
+void scan_cgroups(const CgroupScanOptions *opts)
+{
+    int root_fd = open(opts->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        perror(opts->root);
+        printf("[]\n");
+        return;
+    }
+
+    size_t count = 0;
+    unsigned long long start_ms = now_ms();
+    CgroupStat *cgroups = take_cgroup_sample(root_fd, opts, &count);
+
+    if (opts->interval_ms > 0) {
+        struct timespec ts = { .tv_sec = opts->interval_ms / 1000,
+                               .tv_nsec = (long)(opts->interval_ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+
+        size_t cur_count = 0;
+        unsigned long long cur_ms = now_ms();
+        CgroupStat *cur = take_cgroup_sample(root_fd, opts, &cur_count);
+        double secs = (double)(cur_ms - start_ms) / 1000.0;
+        if (secs <= 0) secs = opts->interval_ms / 1000.0;
+        compute_cgroup_rates(cur, cur_count, cgroups, count, secs);
+
+        free_cgroups(cgroups, count);
+        cgroups = cur;
+        count = cur_count;
+    }
+    close(root_fd);
+
+    /* === OUTPUT – replace this block with your DB insert === */
+    printf("[\n");
+    for (size_t i = 0; i < count; i++) {
+        const CgroupStat *c = &cgroups[i];
+        printf("  {\"path\":\"");
+        for (const char *p = c->path; *p; p++) {
+            if (*p == '"' || *p == '\\') putchar('\\');
+            putchar(*p);
+        }
+        printf("\",\"id\":%llu", c->id);
+        if (c->has_cpu) {
+            printf(",\"usage_usec\":%llu,\"user_usec\":%llu,\"system_usec\":%llu,"
+                   "\"nr_periods\":%llu,\"nr_throttled\":%llu,\"throttled_usec\":%llu",
+                   c->usage_usec, c->user_usec, c->system_usec,
+                   c->nr_periods, c->nr_throttled, c->throttled_usec);
+        }
+        if (c->has_memory) {
+            printf(",\"memory_current\":%llu,\"memory_max\":%llu,\"anon\":%llu,\"file\":%llu,\"kernel\":%llu,"
+                   "\"shmem\":%llu,\"sock\":%llu,\"file_dirty\":%llu,\"pgmajfault\":%llu,\"oom_kill\":%llu",
+                   c->memory_current, c->memory_max, c->anon, c->file, c->kernel,
+                   c->shmem, c->sock, c->file_dirty, c->pgmajfault, c->oom_kill);
+        }
+        if (c->has_io) {
+            printf(",\"rbytes\":%llu,\"wbytes\":%llu,\"rios\":%llu,\"wios\":%llu",
+                   c->rbytes, c->wbytes, c->rios, c->wios);
+        }
+        print_pressure("cpu_pressure", &c->cpu_pressure);
+        print_pressure("memory_pressure", &c->memory_pressure);
+        print_pressure("io_pressure", &c->io_pressure);
+        if (c->has_rate) {
+            printf(",\"cpu_pct\":%.2f,\"throttled_ratio\":%.4f,\"throttled_pct\":%.2f,"
+                   "\"rbps\":%.1f,\"wbps\":%.1f,\"riops\":%.1f,\"wiops\":%.1f,\"pgmajfault_rate\":%.1f,"
+                   "\"cpu_some_pct\":%.2f,\"memory_some_pct\":%.2f,\"memory_full_pct\":%.2f,"
+                   "\"io_some_pct\":%.2f,\"io_full_pct\":%.2f",
+                   c->cpu_pct, c->throttled_ratio, c->throttled_pct,
+                   c->rbps, c->wbps, c->riops, c->wiops, c->pgmajfault_rate,
+                   c->cpu_some_pct, c->memory_some_pct, c->memory_full_pct,
+                   c->io_some_pct, c->io_full_pct);
+        }
+        printf("}%s\n", i < count - 1 ? "," : "");
+    }
+    printf("]\n");
+
+    free_cgroups(cgroups, count);
+}
+
+int main(int argc, char **argv)
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    CgroupScanOptions opts = { .root = default_cgroup_root(),
+                               .threads = ncpu > 0 ? (unsigned int)(ncpu < 8 ? ncpu : 8) : 1,
+                               .interval_ms = 0, .max_depth = -1 };
+    bool bad_args = false;
+
+    for (int i = 1; i < argc && !bad_args; i++) {
+        if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+            opts.root = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts.threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            opts.interval_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            opts.max_depth = atoi(argv[++i]);
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                    # Every cgroup v2 group: cpu/memory/io/pressure → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --interval <ms>    # Two samples, add rates and throttling ratios\n", argv[0]);
+        fprintf(stderr, "  %s --root <dir>       # cgroup2 mount (default /sys/fs/cgroup, or its unified/ on hybrid hosts)\n", argv[0]);
+        fprintf(stderr, "  %s --max-depth <n>    # Stop n levels below the root (0 = root only)\n", argv[0]);
+        fprintf(stderr, "  %s --threads <n>      # Parallel readers (default min(cpus, 8))\n", argv[0]);
+        return 1;
+    }
+
+    scan_cgroups(&opts);
+    return 0;
+}
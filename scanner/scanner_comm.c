@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
@@ -14,14 +16,15 @@ static int pid_cmp(const void *a, const void *b) {
    Output format: simple JSON array of objects
    Example:
    [{"pid":1,"name":"systemd"},{"pid":2,"name":"kthreadd"},...]
+   scope (may be NULL) limits the scan to members of cgroups; attrs adds
+   namespace/cgroup/container columns or grouping (scanner_proc_attrs.h).
 
    Replace the output block with your DB insert logic.
 */
-void scan_process_names_comm(void)
+void scan_process_names_comm(const ProcScope *scope, ProcAttrs *attrs)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc failed");
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, scope)) {
         return;
     }
 
@@ -29,56 +32,35 @@ void scan_process_names_comm(void)
     struct proc_info {
         int pid;
         char name[17];          /* TASK_COMM_LEN = 16 + null */
+        ProcAttr attr;
     };
 
     struct proc_info *procs = NULL;
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-
-        /* Skip if not a numeric directory (PID) */
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Build path: /proc/<pid>/comm */
-        char path[64];
-        snprintf(path, sizeof(path), "/proc/%d/comm", pid);
-
-        FILE *fp = fopen(path, "re");   /* e = O_CLOEXEC */
-        if (!fp) continue;              /* process may have died meanwhile */
-
-        char comm[17] = {0};
-        if (fgets(comm, sizeof(comm), fp)) {
-            /* Remove trailing newline if present */
-            size_t len = strlen(comm);
-            if (len > 0 && comm[len-1] == '\n')
-                comm[len-1] = '\0';
-
-            /* Grow array if needed */
-            if (count >= capacity) {
-                capacity = capacity ? capacity * 2 : 8192;
-                struct proc_info *new_procs = realloc(procs, capacity * sizeof(*procs));
-                if (!new_procs) {
-                    fclose(fp);
-                    continue;   /* skip on alloc failure – or handle error */
-                }
-                procs = new_procs;
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        /* Grow array if needed */
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 8192;
+            struct proc_info *new_procs = realloc(procs, capacity * sizeof(*procs));
+            if (!new_procs) {
+                proc_handle_close(&h);
+                continue;   /* skip on alloc failure – or handle error */
             }
-
-            procs[count].pid = pid;
-            strncpy(procs[count].name, comm, sizeof(procs[count].name) - 1);
-            procs[count].name[sizeof(procs[count].name) - 1] = '\0';
-            count++;
+            procs = new_procs;
         }
-        fclose(fp);
+
+        /* Same task->comm as /proc/<pid>/comm; the iterator already read it from stat */
+        procs[count].pid = h.pid;
+        snprintf(procs[count].name, sizeof(procs[count].name), "%s", proc_handle_comm(&h));
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, h.pid, &procs[count].attr);
+        count++;
+        proc_handle_close(&h);
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
 
     if (count == 0) {
         free(procs);
@@ -88,17 +70,19 @@ void scan_process_names_comm(void)
 
     /* Sort by PID (optional but nice for consistent output) */
     qsort(procs, count, sizeof(struct proc_info), pid_cmp);
+    proc_attrs_sort(attrs, procs, count, sizeof(struct proc_info), offsetof(struct proc_info, attr));
 
     /* === OUTPUT – replace this with your database insert === */
     printf("[\n");
     for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"name\":\"%s\"}",
+        proc_attrs_row_sep(attrs, i ? &procs[i-1].attr : NULL, &procs[i].attr);
+        printf("{\"pid\":%d,\"name\":\"%s\"",
                procs[i].pid,
                procs[i].name);
-        if (i < count - 1)
-            printf(",");
-        printf("\n");
+        proc_attrs_print(attrs, &procs[i].attr);
+        printf("}");
     }
+    proc_attrs_end(attrs, count > 0);
     printf("]\n");
 
     /* Alternative DB-style loop example:
@@ -110,8 +94,28 @@ void scan_process_names_comm(void)
     free(procs);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_process_names_comm();
+    ProcScope scope = { 0 };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                  # PID + comm of every process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --cgroup <path>[,<path>...] [--cgroup-threads]\n", argv[0]);
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  %s --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n", argv[0]);
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  %s --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n", argv[0]);
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    scan_process_names_comm(&scope, &attrs);
+    proc_scope_free(&scope);
+    proc_attrs_free(&attrs);
     return 0;
 }
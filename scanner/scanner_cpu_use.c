@@ -4,6 +4,12 @@
                         #include <ctype.h>
                         #include <string.h>
                         #include <unistd.h>     /* for sysconf(_SC_CLK_TCK) */
+                        #include <stdbool.h>
+                        #include <time.h>       /* for clock_gettime */
+                        #include "scanner_taskstats.h"
+                        #include "scanner_proc_handle.h"
+                        #include "scanner_proc_attrs.h"
+                        #include "scanner_topn.h"
 
                         #define CLK_TCK sysconf(_SC_CLK_TCK)
 
@@ -21,23 +27,171 @@
                             long          cstime;         /* kernel mode jiffies of reaped children */
                             unsigned long total_own;      /* utime + stime */
                             unsigned long total_with_child; /* utime + stime + cutime + cstime (if reaped) */
+                            bool          has_delay;      /* delay columns below are filled (--taskstats) */
+                            bool          exited;         /* final record from a taskstats exit notification */
+                            unsigned long long cpu_delay_count;  /* run-queue waits */
+                            unsigned long long cpu_delay_ns;
+                            unsigned long long blkio_delay_count; /* synchronous block I/O waits */
+                            unsigned long long blkio_delay_ns;
+                            unsigned long long swapin_delay_ns;
+                            unsigned long long reclaim_delay_ns; /* direct memory reclaim */
+                            ProcAttr      attr;           /* --ns / --group-by */
                         } ProcCpuTime;
 
+                        typedef struct {
+                            bool taskstats;              /* add delay accounting via TASKSTATS netlink */
+                            unsigned int exit_window_ms; /* > 0: also report processes exiting during this window */
+                            ProcScope scope;             /* --cgroup: only these cgroups' members */
+                            size_t top;                  /* --top: keep only the N largest by top_by; 0 = all */
+                            int top_by;                  /* CPU_BY_* */
+                        } CpuScanOptions;
+
+                        /* --by: column ranked by --top */
+                        enum { CPU_BY_TOTAL, CPU_BY_USER, CPU_BY_SYSTEM, CPU_BY_CHILDREN };
+                        static const char *const cpu_by_names[] = { "total", "user", "system", "children" };
+
+                        static unsigned long cpu_key(const ProcCpuTime *t, int by) {
+                            switch (by) {
+                                case CPU_BY_USER:     return t->utime;
+                                case CPU_BY_SYSTEM:   return t->stime;
+                                case CPU_BY_CHILDREN: return t->total_with_child;
+                                default:              return t->total_own;
+                            }
+                        }
+
+                        /* Append to the growing array, or offer to the --top heap; false if out of memory */
+                        static bool keep_row(TopN *top, ProcCpuTime **times, size_t *count, size_t *capacity,
+                                             const ProcCpuTime *row, double key) {
+                            if (topn_enabled(top)) {
+                                topn_push(top, key, row, NULL);
+                                return true;
+                            }
+                            if (*count >= *capacity) {
+                                size_t new_capacity = *capacity ? *capacity * 2 : 8192;
+                                ProcCpuTime *new_times = realloc(*times, new_capacity * sizeof(ProcCpuTime));
+                                if (!new_times) return false;
+                                *times = new_times;
+                                *capacity = new_capacity;
+                            }
+                            (*times)[(*count)++] = *row;
+                            return true;
+                        }
+
+                        /* Final record over the live row of the same process: exit values win, attributes stay */
+                        static void finish_row(ProcCpuTime *live, const ProcCpuTime *final, int by, double *key) {
+                            ProcAttr attr = live->attr;
+                            long cutime = live->cutime, cstime = live->cstime;
+                            *live = *final;
+                            live->attr = attr;
+                            live->cutime = cutime;
+                            live->cstime = cstime;
+                            live->total_with_child = live->total_own + (unsigned long)(cutime + cstime);
+                            *key = (double)cpu_key(live, by);
+                        }
+
+                        /*
+                        The row the walk kept for pid, NULL if none. Without --top the first live_count
+                        rows are the walk's, sorted by PID; with --top the heap holds at most N rows.
+                        */
+                        static ProcCpuTime *find_live(TopN *top, ProcCpuTime *times, size_t live_count, int pid, size_t *heap_index) {
+                            if (!topn_enabled(top)) return bsearch(&pid, times, live_count, sizeof(ProcCpuTime), pid_cmp);
+                            for (size_t i = 0; i < top->count; i++) {
+                                ProcCpuTime *row = topn_row(top, i);
+                                if (row->pid == pid && !row->exited) {
+                                    *heap_index = i;
+                                    return row;
+                                }
+                            }
+                            return NULL;
+                        }
+
+                        /* Remember a PID the walk admitted (--cgroup / --filter); false if out of memory */
+                        static bool note_pid(int **pids, size_t *count, size_t *capacity, int pid) {
+                            if (*count >= *capacity) {
+                                size_t new_capacity = *capacity ? *capacity * 2 : 1024;
+                                int *new_pids = realloc(*pids, new_capacity * sizeof(int));
+                                if (!new_pids) return false;
+                                *pids = new_pids;
+                                *capacity = new_capacity;
+                            }
+                            (*pids)[(*count)++] = pid;
+                            return true;
+                        }
+
+                        /* TASKSTATS record → delay columns */
+                        static void copy_delays(ProcCpuTime *t, const TaskstatsRecord *r) {
+                            t->has_delay = true;
+                            t->cpu_delay_count = r->cpu_delay_count;
+                            t->cpu_delay_ns = r->cpu_delay_ns;
+                            t->blkio_delay_count = r->blkio_delay_count;
+                            t->blkio_delay_ns = r->blkio_delay_ns;
+                            t->swapin_delay_ns = r->swapin_delay_ns;
+                            t->reclaim_delay_ns = r->reclaim_delay_ns;
+                        }
+
+                        static unsigned long long now_ms(void) {
+                            struct timespec ts;
+                            clock_gettime(CLOCK_MONOTONIC, &ts);
+                            return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+                        }
+
                         /*
                         Scanner: CPU time used (user / system / children) for all processes
                         All values in jiffies (divide by CLK_TCK to get seconds)
+                        With opts->taskstats every row also carries delay accounting for the whole thread
+                        group from TASKSTATS (run-queue, block I/O, swap-in and reclaim waits, in ns). CPU time
+                        stays from stat: TASKSTATS ac_utime/ac_stime are raw tick samples, not the adjusted
+                        values stat reports. With delay accounting off (kernel.task_delayacct=0) the query is
+                        skipped and the delay columns are left out rather than reported as 0.
+                        With opts->exit_window_ms, processes exiting during the scan and the window after it
+                        are added from their final taskstats record ("exited":true; no children times).
+                        attrs adds namespace/cgroup/container columns or grouping (scanner_proc_attrs.h);
+                        exited rows have no /proc entry left, so their attributes are unknown.
+                        A process walked live that exits in the window keeps a single row: the final values
+                        replace the live ones (children times and attributes stay) and it is marked exited.
+                        With opts->scope (--cgroup / --filter) an exited process can no longer be checked
+                        against it, so only exits of processes the walk admitted are reported.
+                        With opts->top only the N processes largest by opts->top_by are kept (bounded heap,
+                        scanner_topn.h; exit records compete too): attribute and TASKSTATS reads are skipped for
+                        processes that cannot make the cut, and rows come out largest first.
                         Output: JSON array → replace with DB insert
                         */
-                        void scan_process_cpu_time(void)
+                        void scan_process_cpu_time(const CpuScanOptions *opts, ProcAttrs *attrs)
                         {
                             if (CLK_TCK <= 0) {
                                 fprintf(stderr, "sysconf(_SC_CLK_TCK) failed\n");
                                 return;
                             }
 
-                            DIR *proc = opendir("/proc");
-                            if (!proc) {
-                                perror("opendir /proc");
+                            /* With delay accounting off every delay reads 0: skip the per-process query, leave the columns out */
+                            bool delayacct = taskstats_delayacct_enabled();
+                            bool query_delays = opts->taskstats && delayacct;
+                            if (opts->taskstats && !delayacct) {
+                                fprintf(stderr, "kernel.task_delayacct=0: delay columns omitted (sysctl -w kernel.task_delayacct=1)\n");
+                            }
+
+                            /* Separate connections: exit records would interleave with query replies */
+                            TaskstatsConn ts_conn = { .fd = -1 };
+                            TaskstatsConn exit_conn = { .fd = -1 };
+                            if (query_delays || opts->exit_window_ms > 0) {
+                                if (taskstats_open(&ts_conn) < 0) {
+                                    printf("[]\n");
+                                    return;
+                                }
+                                /* Subscribe before the walk so exits during the scan are not missed */
+                                if (opts->exit_window_ms > 0 &&
+                                    (taskstats_open(&exit_conn) < 0 || taskstats_subscribe_exits(&exit_conn) < 0)) {
+                                    taskstats_close(&exit_conn);
+                                    taskstats_close(&ts_conn);
+                                    printf("[]\n");
+                                    return;
+                                }
+                            }
+
+                            ProcIter it;
+                            if (!proc_iter_open_scope(&it, &opts->scope)) {
+                                taskstats_close(&exit_conn);
+                                taskstats_close(&ts_conn);
                                 return;
                             }
 
@@ -45,19 +199,30 @@
                             size_t capacity = 0;
                             size_t count = 0;
 
-                            struct dirent *ent;
-                            while ((ent = readdir(proc)) != NULL) {
-                                if (ent->d_type != DT_DIR) continue;
-                                if (!isdigit((unsigned char)ent->d_name[0])) continue;
+                            TopN top;
+                            if (!topn_init(&top, opts->top, sizeof(ProcCpuTime))) {
+                                proc_iter_close(&it);
+                                taskstats_close(&exit_conn);
+                                taskstats_close(&ts_conn);
+                                printf("[]\n");
+                                return;
+                            }
 
-                                int pid = atoi(ent->d_name);
-                                if (pid <= 0) continue;
+                            /* Exit records are matched against the walk, not the (gone) process */
+                            bool scoped = opts->scope.count > 0 || opts->scope.filter.count > 0;
+                            int *admitted = NULL;
+                            size_t admitted_count = 0, admitted_capacity = 0;
 
-                                char path[64];
-                                snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+                            ProcHandle h;
+                            while (proc_iter_next(&it, &h)) {
+                                int pid = h.pid;
+                                if (scoped && exit_conn.fd >= 0) note_pid(&admitted, &admitted_count, &admitted_capacity, pid);
 
-                                FILE *fp = fopen(path, "re");
-                                if (!fp) continue;
+                                FILE *fp = proc_handle_fopen(&h, "stat");
+                                if (!fp) {
+                                    proc_handle_close(&h);
+                                    continue;
+                                }
 
                                 int dummy_int;
                                 char dummy_char;
@@ -75,32 +240,89 @@
 
                                 fclose(fp);
 
-                                if (scanned != 8) continue;  /* parsing failed or process gone */
-
-                                /* Grow array */
-                                if (count >= capacity) {
-                                    capacity = capacity ? capacity * 2 : 8192;
-                                    ProcCpuTime *new_times = realloc(times, capacity * sizeof(ProcCpuTime));
-                                    if (!new_times) continue;
-                                    times = new_times;
+                                if (scanned != 8) {  /* parsing failed or process gone */
+                                    proc_handle_close(&h);
+                                    continue;
                                 }
 
-                                times[count].pid = pid;
-                                strncpy(times[count].comm, comm, sizeof(times[count].comm) - 1);
-                                times[count].comm[sizeof(times[count].comm) - 1] = '\0';
+                                ProcCpuTime row = { .pid = pid };
+                                memcpy(row.comm, comm, sizeof(row.comm));
 
-                                times[count].utime  = utime;
-                                times[count].stime  = stime;
-                                times[count].cutime = cutime;
-                                times[count].cstime = cstime;
+                                row.utime  = utime;
+                                row.stime  = stime;
+                                row.cutime = cutime;
+                                row.cstime = cstime;
 
-                                times[count].total_own        = utime + stime;
-                                times[count].total_with_child = utime + stime + (unsigned long)(cutime + cstime);
+                                row.total_own        = utime + stime;
+                                row.total_with_child = utime + stime + (unsigned long)(cutime + cstime);
+                                row.has_delay = false;
+                                row.exited = false;
+
+                                /* --top: the rest is only worth reading for rows that would be kept */
+                                double key = (double)cpu_key(&row, opts->top_by);
+                                if (!topn_would_enter(&top, key)) {
+                                    proc_handle_close(&h);
+                                    continue;
+                                }
+                                if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, pid, &row.attr);
 
-                                count++;
+                                /* TASKSTATS is keyed by PID: only trust the answer if h is still alive after it */
+                                TaskstatsRecord rec;
+                                if (query_delays && taskstats_query(&ts_conn, pid, true, &rec) == 0 &&
+                                    proc_handle_alive(&h)) {
+                                    copy_delays(&row, &rec);
+                                }
+                                proc_handle_close(&h);
+
+                                keep_row(&top, &times, &count, &capacity, &row, key);
                             }
 
-                            closedir(proc);
+                            proc_iter_close(&it);
+                            qsort(admitted, admitted_count, sizeof(int), pid_cmp);
+                            if (!topn_enabled(&top)) qsort(times, count, sizeof(ProcCpuTime), pid_cmp);
+                            size_t live_count = count;
+
+                            /* Final records of processes that exited during the scan + window */
+                            if (exit_conn.fd >= 0) {
+                                unsigned long long deadline = now_ms() + opts->exit_window_ms;
+                                TaskstatsRecord rec;
+                                for (;;) {
+                                    unsigned long long now = now_ms();
+                                    if (now >= deadline) break;
+                                    if (taskstats_read_exit(&exit_conn, &rec, (int)(deadline - now)) <= 0) break;
+                                    if (scoped && !bsearch(&rec.pid, admitted, admitted_count, sizeof(int), pid_cmp)) continue;
+
+                                    /* taskstats CPU time is in usec: convert so all rows share one unit */
+                                    ProcCpuTime t;
+                                    memset(&t, 0, sizeof(t));
+                                    t.pid = rec.pid;
+                                    snprintf(t.comm, sizeof(t.comm), "%s", rec.comm);
+                                    t.utime = (unsigned long)(rec.utime_us * (unsigned long long)CLK_TCK / 1000000ULL);
+                                    t.stime = (unsigned long)(rec.stime_us * (unsigned long long)CLK_TCK / 1000000ULL);
+                                    t.total_own = t.utime + t.stime;
+                                    t.total_with_child = t.total_own;
+                                    t.exited = true;
+                                    proc_attrs_clear(&t.attr, t.pid);
+                                    if (delayacct) copy_delays(&t, &rec);
+
+                                    double key;
+                                    size_t heap_index = 0;
+                                    ProcCpuTime *live = find_live(&top, times, live_count, t.pid, &heap_index);
+                                    if (live && !live->exited) {
+                                        finish_row(live, &t, opts->top_by, &key);
+                                        if (topn_enabled(&top)) topn_rekey(&top, heap_index, key);
+                                        continue;
+                                    }
+
+                                    key = (double)cpu_key(&t, opts->top_by);
+                                    if (!topn_would_enter(&top, key)) continue;
+                                    if (!keep_row(&top, &times, &count, &capacity, &t, key)) break;
+                                }
+                            }
+                            free(admitted);
+                            taskstats_close(&exit_conn);
+                            taskstats_close(&ts_conn);
+                            if (topn_enabled(&top)) times = topn_finish(&top, &count);
 
                             if (count == 0) {
                                 free(times);
@@ -108,18 +330,24 @@
                                 return;
                             }
 
-                            /* Sort by PID */
-                            qsort(times, count, sizeof(ProcCpuTime), pid_cmp);
+                            /* Sort by PID (--top: already largest first) */
+                            if (!opts->top) {
+                                qsort(times, count, sizeof(ProcCpuTime), pid_cmp);
+                                proc_attrs_sort(attrs, times, count, sizeof(ProcCpuTime), offsetof(ProcCpuTime, attr));
+                            } else {
+                                proc_attrs_sort_ranked(attrs, times, count, sizeof(ProcCpuTime), offsetof(ProcCpuTime, attr));
+                            }
 
                             /* === OUTPUT – replace this with your database insert logic === */
                             printf("[\n");
                             for (size_t i = 0; i < count; i++) {
-                                printf("  {\"pid\":%d,\"comm\":\"%s\","
+                                proc_attrs_row_sep(attrs, i ? &times[i-1].attr : NULL, &times[i].attr);
+                                printf("{\"pid\":%d,\"comm\":\"%s\","
                                     "\"user_jiffies\":%lu,\"system_jiffies\":%lu,"
                                     "\"total_own_jiffies\":%lu,"
                                     "\"children_user_jiffies\":%ld,\"children_system_jiffies\":%ld,"
                                     "\"total_with_children_jiffies\":%lu,"
-                                    "\"jiffies_per_sec\":%ld}",
+                                    "\"jiffies_per_sec\":%ld",
                                     times[i].pid, times[i].comm,
                                     times[i].utime, times[i].stime,
                                     times[i].total_own,
@@ -127,9 +355,19 @@
                                     times[i].total_with_child,
                                     CLK_TCK);
 
-                                if (i < count - 1) printf(",");
-                                printf("\n");
+                                if (times[i].has_delay) {
+                                    printf(",\"cpu_delay_count\":%llu,\"cpu_delay_ns\":%llu,"
+                                        "\"blkio_delay_count\":%llu,\"blkio_delay_ns\":%llu,"
+                                        "\"swapin_delay_ns\":%llu,\"reclaim_delay_ns\":%llu",
+                                        times[i].cpu_delay_count, times[i].cpu_delay_ns,
+                                        times[i].blkio_delay_count, times[i].blkio_delay_ns,
+                                        times[i].swapin_delay_ns, times[i].reclaim_delay_ns);
+                                }
+                                if (times[i].exited) printf(",\"exited\":true");
+                                proc_attrs_print(attrs, &times[i].attr);
+                                printf("}");
                             }
+                            proc_attrs_end(attrs, count > 0);
                             printf("]\n");
 
                             /* Example DB replacement:
@@ -144,8 +382,50 @@
                             free(times);
                         }
 
-                        int main(void)
+                        int main(int argc, char **argv)
                         {
-                            scan_process_cpu_time();
+                            CpuScanOptions opts = { .taskstats = false, .exit_window_ms = 0, .scope = { 0 },
+                                                  .top = 0, .top_by = CPU_BY_TOTAL };
+                            ProcAttrs attrs;
+                            proc_attrs_init(&attrs);
+                            bool bad_args = false;
+
+                            for (int i = 1; i < argc; i++) {
+                                if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+                                if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+                                if (strcmp(argv[i], "--taskstats") == 0) {
+                                    opts.taskstats = true;
+                                } else if (strcmp(argv[i], "--exit-window") == 0 && i + 1 < argc) {
+                                    opts.exit_window_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+                                } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+                                    opts.top = strtoul(argv[++i], NULL, 10);
+                                    if (opts.top == 0) bad_args = true;
+                                } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+                                    opts.top_by = topn_field(argv[++i], cpu_by_names, sizeof(cpu_by_names) / sizeof(cpu_by_names[0]));
+                                    if (opts.top_by < 0) bad_args = true;
+                                } else {
+                                    bad_args = true;
+                                }
+                            }
+
+                            if (bad_args) {
+                                fprintf(stderr, "Usage:\n");
+                                fprintf(stderr, "  %s                        # CPU time per process → JSON\n", argv[0]);
+                                fprintf(stderr, "  %s --taskstats            # + run-queue/block-I/O/swap-in/reclaim delays (TASKSTATS, root, kernel.task_delayacct=1)\n", argv[0]);
+                                fprintf(stderr, "  %s --exit-window <ms>     # + final records of processes exiting within <ms>\n", argv[0]);
+                                fprintf(stderr, "  ... --top <n> [--by total|user|system|children]\n");
+                                fprintf(stderr, "      # Only the n largest processes (default by total), largest first; other reads skipped for the rest\n");
+                                fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+                                fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+                                fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+                                fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+                                fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+                                fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+                                return 1;
+                            }
+
+                            scan_process_cpu_time(&opts, &attrs);
+                            proc_scope_free(&opts.scope);
+                            proc_attrs_free(&attrs);
                             return 0;
                         }
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdbool.h>
+#include "scanner_names.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
@@ -19,9 +21,11 @@ typedef struct {
 /*
    Scanner: User/group/UID/GID info for all running processes
    Reads /proc/<pid>/status for Uid/Gid lines + /proc/<pid>/comm
+   With names (may be NULL) each id also gets its user/group name (null if it
+   does not resolve) from the cached tables in scanner_names.h
    Output: JSON array → replace with your DB insert loop
 */
-void scan_process_credentials(void)
+void scan_process_credentials(NameCache *names)
 {
     DIR *proc = opendir("/proc");
     if (!proc) {
@@ -117,10 +121,21 @@ void scan_process_credentials(void)
     for (size_t i = 0; i < count; i++) {
         printf("  {\"pid\":%d,\"comm\":\"%s\","
                "\"ruid\":%u,\"euid\":%u,\"suid\":%u,\"fsuid\":%u,"
-               "\"rgid\":%u,\"egid\":%u,\"sgid\":%u,\"fsgid\":%u}",
+               "\"rgid\":%u,\"egid\":%u,\"sgid\":%u,\"fsgid\":%u",
                creds[i].pid, creds[i].comm,
                creds[i].ruid, creds[i].euid, creds[i].suid, creds[i].fsuid,
                creds[i].rgid, creds[i].egid, creds[i].sgid, creds[i].fsgid);
+        if (names) {
+            names_print(",\"ruser\":", names_user(names, creds[i].ruid));
+            names_print(",\"euser\":", names_user(names, creds[i].euid));
+            names_print(",\"suser\":", names_user(names, creds[i].suid));
+            names_print(",\"fsuser\":", names_user(names, creds[i].fsuid));
+            names_print(",\"rgroup\":", names_group(names, creds[i].rgid));
+            names_print(",\"egroup\":", names_group(names, creds[i].egid));
+            names_print(",\"sgroup\":", names_group(names, creds[i].sgid));
+            names_print(",\"fsgroup\":", names_group(names, creds[i].fsgid));
+        }
+        printf("}");
 
         if (i < count - 1) printf(",");
         printf("\n");
@@ -139,8 +154,33 @@ void scan_process_credentials(void)
     free(creds);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_process_credentials();
+    bool resolve = false;
+    const char *names_cache = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--names") == 0) {
+            resolve = true;
+        } else if (strcmp(argv[i], "--names-cache") == 0 && i + 1 < argc) {
+            resolve = true;
+            names_cache = argv[++i];
+        } else {
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s            # UIDs/GIDs per process → JSON\n", argv[0]);
+            fprintf(stderr, "  %s --names    # + user/group names (/etc/passwd, /etc/group, then NSS)\n", argv[0]);
+            fprintf(stderr, "  %s --names-cache <file>  # --names, reusing NSS answers from previous runs\n", argv[0]);
+            return 1;
+        }
+    }
+
+    NameCache names;
+    names_init(&names);
+    if (resolve) names_refresh(&names);
+    if (names_cache) names_cache_load(&names, names_cache);
+
+    scan_process_credentials(resolve ? &names : NULL);
+    if (names_cache) names_cache_save(&names, names_cache);
+    names_free(&names);
     return 0;
 }
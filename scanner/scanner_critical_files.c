@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <limits.h>
 #include <time.h>
+#include <stdbool.h>
+#include "scanner_names.h"
 
 /* File info structure (must be defined before comparator) */
 typedef struct {
@@ -83,8 +85,9 @@ static void scan_dir(const char *dir, FileInfo **files, size_t *count, size_t *c
 /*
    Scanner: Files in critical directories
    Recursively scans: /etc, /bin, /sbin, /usr/bin, /lib, /var, /tmp, /home, /root
+   With names (may be NULL) rows also carry "user"/"group" (scanner_names.h)
 */
-void scan_critical_files(void)
+void scan_critical_files(NameCache *names)
 {
     const char *dirs[] = {
         "/etc", "/bin", "/sbin", "/usr/bin", "/lib",
@@ -121,9 +124,14 @@ void scan_critical_files(void)
             if (*p == '"' || *p == '\\') putchar('\\');
             putchar(*p);
         }
-        printf("\",\"size\":%lld,\"mode\":\"%s\",\"uid\":%u,\"gid\":%u,\"mtime\":%ld}",
+        printf("\",\"size\":%lld,\"mode\":\"%s\",\"uid\":%u,\"gid\":%u,\"mtime\":%ld",
                (long long)files[i].size, mode_str,
                files[i].uid, files[i].gid, (long)files[i].mtime);
+        if (names) {
+            names_print(",\"user\":", names_user(names, files[i].uid));
+            names_print(",\"group\":", names_group(names, files[i].gid));
+        }
+        printf("}");
 
         if (i < count - 1) printf(",");
         printf("\n");
@@ -133,8 +141,33 @@ void scan_critical_files(void)
     free(files);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_critical_files();
+    bool resolve = false;
+    const char *names_cache = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--names") == 0) {
+            resolve = true;
+        } else if (strcmp(argv[i], "--names-cache") == 0 && i + 1 < argc) {
+            resolve = true;
+            names_cache = argv[++i];
+        } else {
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s            # Files in critical directories → JSON\n", argv[0]);
+            fprintf(stderr, "  %s --names    # + user/group names (/etc/passwd, /etc/group, then NSS)\n", argv[0]);
+            fprintf(stderr, "  %s --names-cache <file>  # --names, reusing NSS answers from previous runs\n", argv[0]);
+            return 1;
+        }
+    }
+
+    NameCache names;
+    names_init(&names);
+    if (resolve) names_refresh(&names);
+    if (names_cache) names_cache_load(&names, names_cache);
+
+    scan_critical_files(resolve ? &names : NULL);
+    if (names_cache) names_cache_save(&names, names_cache);
+    names_free(&names);
     return 0;
 }
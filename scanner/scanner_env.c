@@ -1,55 +1,266 @@
 #include <stdio.h>
-#include <dirent.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_budget.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
     return (*(const int *)a) - (*(const int *)b);
 }
 
+/*
+   Interned byte strings: bytes in one arena, open-addressing set of ids.
+   Used twice: for "KEY=VALUE" strings, and for whole environments (the
+   sequence of variable ids, stored as bytes).
+*/
+typedef struct {
+    size_t off;            /* offset into arena */
+    size_t len;
+    unsigned long hash;
+} InternEntry;
+
+typedef struct {
+    char        *arena;
+    size_t       arena_len;
+    size_t       arena_cap;
+    InternEntry *items;    /* id → entry */
+    size_t       count;
+    size_t       capacity;
+    unsigned    *slots;    /* hash slot → id + 1 (0 = empty) */
+    size_t       slot_mask;
+} InternTable;
+
 typedef struct {
-    int    pid;
-    char   comm[17];
-    char **env_vars;          /* dynamic array of "KEY=VALUE" strings */
-    size_t env_count;
-    size_t env_capacity;
+    int      pid;
+    char     comm[17];
+    unsigned env_id;       /* id in the environment table */
+    ProcAttr attr;         /* --ns / --group-by */
 } ProcEnv;
 
-static void add_env_var(ProcEnv *p, const char *var) {
-    if (p->env_count >= p->env_capacity) {
-        p->env_capacity = p->env_capacity ? p->env_capacity * 2 : 64;
-        char **new_env = realloc(p->env_vars, p->env_capacity * sizeof(char *));
-        if (!new_env) return;
-        p->env_vars = new_env;
+/* Key filters (--allow / --deny), applied to the KEY before anything is copied */
+typedef struct {
+    const char **allow;    /* NULL = allow all */
+    size_t       allow_count;
+    const char **deny;
+    size_t       deny_count;
+} EnvFilter;
+
+static unsigned long bytes_hash(const void *data, size_t len) {
+    const unsigned char *p = data;
+    unsigned long h = 1469598103934665603UL;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 1099511628211UL;
+    return h;
+}
+
+static bool intern_init(InternTable *t) {
+    memset(t, 0, sizeof(*t));
+    t->slot_mask = 4095;
+    t->slots = calloc(t->slot_mask + 1, sizeof(unsigned));
+    return t->slots != NULL;
+}
+
+static void intern_free(InternTable *t) {
+    free(t->arena);
+    free(t->items);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static const char *intern_data(const InternTable *t, unsigned id) {
+    return t->arena + t->items[id].off;
+}
+
+static void intern_rehash(InternTable *t) {
+    size_t new_size = (t->slot_mask + 1) * 2;
+    unsigned *new_slots = calloc(new_size, sizeof(unsigned));
+    if (!new_slots) return;   /* keep probing the old, fuller table */
+    free(t->slots);
+    t->slots = new_slots;
+    t->slot_mask = new_size - 1;
+    for (size_t id = 0; id < t->count; id++) {
+        size_t i = t->items[id].hash & t->slot_mask;
+        while (t->slots[i]) i = (i + 1) & t->slot_mask;
+        t->slots[i] = (unsigned)id + 1;
+    }
+}
+
+/* Id of data[0..len), copying it into the arena only on first sight; -1 on allocation failure */
+static long intern_bytes(InternTable *t, const void *data, size_t len) {
+    unsigned long h = bytes_hash(data, len);
+    size_t i = h & t->slot_mask;
+    for (; t->slots[i]; i = (i + 1) & t->slot_mask) {
+        const InternEntry *e = &t->items[t->slots[i] - 1];
+        if (e->hash == h && e->len == len && memcmp(t->arena + e->off, data, len) == 0) {
+            return (long)t->slots[i] - 1;
+        }
     }
 
-    p->env_vars[p->env_count] = strdup(var);
-    if (p->env_vars[p->env_count]) p->env_count++;
+    /* Keep entries aligned so id sequences can be read back as unsigned[] */
+    size_t off = (t->arena_len + sizeof(unsigned) - 1) & ~(sizeof(unsigned) - 1);
+    if (off + len + 1 > t->arena_cap) {
+        size_t new_cap = t->arena_cap ? t->arena_cap * 2 : 65536;
+        while (new_cap < off + len + 1) new_cap *= 2;
+        char *new_arena = realloc(t->arena, new_cap);
+        if (!new_arena) return -1;
+        t->arena = new_arena;
+        t->arena_cap = new_cap;
+    }
+    if (t->count >= t->capacity) {
+        size_t new_cap = t->capacity ? t->capacity * 2 : 1024;
+        InternEntry *new_items = realloc(t->items, new_cap * sizeof(InternEntry));
+        if (!new_items) return -1;
+        t->items = new_items;
+        t->capacity = new_cap;
+    }
+
+    unsigned id = (unsigned)t->count++;
+    t->items[id].off = off;
+    t->items[id].len = len;
+    t->items[id].hash = h;
+    memcpy(t->arena + off, data, len);
+    t->arena[off + len] = '\0';
+    t->arena_len = off + len + 1;
+
+    t->slots[i] = id + 1;
+    if (t->count * 2 > t->slot_mask + 1) intern_rehash(t);
+    return id;
+}
+
+/* KEY matches pattern: exact, or prefix when the pattern ends in '*' */
+static bool key_matches(const char *key, size_t key_len, const char *pattern) {
+    size_t plen = strlen(pattern);
+    if (plen > 0 && pattern[plen - 1] == '*') {
+        return key_len >= plen - 1 && memcmp(key, pattern, plen - 1) == 0;
+    }
+    return key_len == plen && memcmp(key, pattern, plen) == 0;
+}
+
+static bool key_allowed(const EnvFilter *f, const char *var, size_t len) {
+    const char *eq = memchr(var, '=', len);
+    size_t key_len = eq ? (size_t)(eq - var) : len;
+
+    if (f->allow) {
+        bool hit = false;
+        for (size_t i = 0; i < f->allow_count && !hit; i++) hit = key_matches(var, key_len, f->allow[i]);
+        if (!hit) return false;
+    }
+    for (size_t i = 0; i < f->deny_count; i++) {
+        if (key_matches(var, key_len, f->deny[i])) return false;
+    }
+    return true;
 }
 
-static void free_procenv(ProcEnv *p) {
-    for (size_t i = 0; i < p->env_count; i++) {
-        free(p->env_vars[i]);
+/* Read all of the process's environ into *buf (grown as needed, reused across processes) */
+static ssize_t read_environ(const ProcHandle *h, char **buf, size_t *cap) {
+    int fd = proc_handle_openat(h, "environ");
+    if (fd < 0) return -1;  /* no access or process gone */
+
+    /* procfs reports size 0: read until EOF instead of trusting stat/ftell */
+    size_t len = 0;
+    for (;;) {
+        if (len == *cap) {
+            size_t new_cap = *cap ? *cap * 2 : 65536;
+            char *new_buf = realloc(*buf, new_cap);
+            if (!new_buf) break;
+            *buf = new_buf;
+            *cap = new_cap;
+        }
+        ssize_t n = read(fd, *buf + len, *cap - len);
+        if (n <= 0) break;
+        len += (size_t)n;
     }
-    free(p->env_vars);
-    p->env_vars = NULL;
-    p->env_count = p->env_capacity = 0;
+    close(fd);
+    return (ssize_t)len;
+}
+
+/*
+   Split environ in place (NUL-separated, memchr) and build the id sequence of the
+   variables that pass the filter. Only variables not seen before on this host are
+   copied (into the variable table). Returns the number of ids.
+*/
+static size_t split_environ(const char *buf, size_t len, const EnvFilter *filter,
+                            InternTable *vars, unsigned **ids, size_t *ids_cap) {
+    size_t n = 0;
+    const char *p = buf;
+    const char *end = buf + len;
+
+    while (p < end) {
+        const char *nul = memchr(p, '\0', (size_t)(end - p));
+        size_t var_len = nul ? (size_t)(nul - p) : (size_t)(end - p);
+
+        if (var_len > 0 && key_allowed(filter, p, var_len)) {
+            long id = intern_bytes(vars, p, var_len);
+            if (id >= 0) {
+                if (n >= *ids_cap) {
+                    size_t new_cap = *ids_cap ? *ids_cap * 2 : 256;
+                    unsigned *new_ids = realloc(*ids, new_cap * sizeof(unsigned));
+                    if (!new_ids) break;
+                    *ids = new_ids;
+                    *ids_cap = new_cap;
+                }
+                (*ids)[n++] = (unsigned)id;
+            }
+        }
+        p += var_len + 1;  /* skip null */
+    }
+    return n;
+}
+
+/* JSON string with " and \ escaped */
+static void print_json_var(const char *var) {
+    printf("\"");
+    for (const char *p = var; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
+    }
+    printf("\"");
+}
+
+static void print_env_array(const InternTable *vars, const InternTable *envs, unsigned env_id) {
+    const unsigned *ids = (const unsigned *)intern_data(envs, env_id);
+    size_t n = envs->items[env_id].len / sizeof(unsigned);
+
+    printf("[");
+    for (size_t j = 0; j < n; j++) {
+        print_json_var(intern_data(vars, ids[j]));
+        if (j < n - 1) printf(",");
+    }
+    printf("]");
 }
 
 /*
    Scanner: Environment variables for all running processes
    Reads /proc/<pid>/environ (null-separated bytes) and splits into "KEY=VALUE" strings
+   Each distinct variable and each distinct environment is stored once host-wide, so
+   hundreds of workers with the same environment cost one copy.
+   Keys are checked against filter (allow list, then deny list; "PREFIX*" patterns)
+   before anything is copied.
    Note: requires root or same-user to read other processes' env (sensitive data!)
    Output: JSON array of {pid, comm, env: ["KEY1=VALUE1", "KEY2=VALUE2", ...]}
+   With dedup: {"environments":[{id, pids: [...], env: [...]}], "processes":[{pid, comm, env_id}]}
+   attrs adds namespace/cgroup/container columns or grouping to the per-process rows
+   (scanner_proc_attrs.h)
+   budget (scanner_budget.h) stops the walk at its limit; the walk starts after its
+   cursor PID, and the rows cover only the processes visited this cycle
 */
-void scan_environment_variables(void)
+void scan_environment_variables(const EnvFilter *filter, bool dedup, const ProcScope *scope, ProcAttrs *attrs,
+                                ScanBudget *budget)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    InternTable vars, envs;
+    if (!intern_init(&vars) || !intern_init(&envs)) {
+        intern_free(&vars);
+        printf("[]\n");
+        return;
+    }
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, scope)) {
+        intern_free(&vars);
+        intern_free(&envs);
         return;
     }
 
@@ -57,85 +268,29 @@ void scan_environment_variables(void)
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
-        }
-
-        /* Open /proc/<pid>/environ */
-        char env_path[64];
-        snprintf(env_path, sizeof(env_path), "/proc/%d/environ", pid);
-
-        FILE *fe = fopen(env_path, "re");
-        if (!fe) continue;  /* no access or process gone */
-
-        /* Read the entire null-separated file */
-        fseek(fe, 0, SEEK_END);
-        long size = ftell(fe);
-        fseek(fe, 0, SEEK_SET);
-
-        if (size <= 0) {
-            fclose(fe);
-            continue;
-        }
-
-        char *buffer = malloc(size + 1);  /* +1 for safety */
-        if (!buffer) {
-            fclose(fe);
-            continue;
-        }
-
-        size_t read_size = fread(buffer, 1, size, fe);
-        fclose(fe);
-
-        if (read_size == 0) {
-            free(buffer);
-            continue;
+    char *buffer = NULL;        /* environ bytes, reused for every process */
+    size_t buffer_cap = 0;
+    unsigned *ids = NULL;       /* variable ids of the current process */
+    size_t ids_cap = 0;
+
+    /* environ and comm are both read through the same handle: a recycled PID cannot mix */
+    proc_iter_resume_after(&it, budget_resume_pid(budget));
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        if (budget_stop(budget)) {
+            proc_handle_close(&h);
+            break;
         }
+        budget_done_pid(budget, h.pid);   /* once started, a process is always finished */
 
-        buffer[read_size] = '\0';  /* ensure null-terminated */
-
-        ProcEnv info = { .pid = pid, .env_count = 0, .env_capacity = 0, .env_vars = NULL };
-        /* replaced strncpy with snprintf to avoid truncation warning */
-        snprintf(info.comm, sizeof(info.comm), "%s", comm);
-
-        /* Split by null bytes */
-        char *start = buffer;
-        char *end;
-        while (start < buffer + read_size) {
-            end = start;
-            while (*end != '\0' && end < buffer + read_size) end++;
-            if (end > start) {  /* non-empty var */
-                char var[1024];  /* reasonable max per var */
-                size_t len = end - start;
-                if (len >= sizeof(var)) len = sizeof(var) - 1;
-                strncpy(var, start, len);
-                var[len] = '\0';
-                add_env_var(&info, var);
-            }
-            start = end + 1;  /* skip null */
+        ssize_t read_size = read_environ(&h, &buffer, &buffer_cap);
+        size_t n = 0;
+        if (read_size > 0) {   /* else no access, gone, or kernel thread */
+            n = split_environ(buffer, (size_t)read_size, filter, &vars, &ids, &ids_cap);
         }
-
-        free(buffer);
-
-        if (info.env_count == 0) {
-            free_procenv(&info);
+        long env_id = n > 0 ? intern_bytes(&envs, ids, n * sizeof(unsigned)) : -1;
+        if (env_id < 0) {
+            proc_handle_close(&h);
             continue;
         }
 
@@ -144,60 +299,155 @@ void scan_environment_variables(void)
             capacity = capacity ? capacity * 2 : 8192;
             ProcEnv *new_proc = realloc(processes, capacity * sizeof(ProcEnv));
             if (!new_proc) {
-                free_procenv(&info);
+                proc_handle_close(&h);
                 continue;
             }
             processes = new_proc;
         }
 
-        processes[count++] = info;
+        processes[count].pid = h.pid;
+        snprintf(processes[count].comm, sizeof(processes[count].comm), "%s", proc_handle_comm(&h));
+        processes[count].env_id = (unsigned)env_id;
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, h.pid, &processes[count].attr);
+        count++;
+        proc_handle_close(&h);
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
+    free(buffer);
+    free(ids);
 
     if (count == 0) {
         free(processes);
-        printf("[]\n");
+        intern_free(&vars);
+        intern_free(&envs);
+        printf(dedup ? "{\"environments\":[],\"processes\":[]}\n" : "[]\n");
         return;
     }
 
     /* Sort by PID */
     qsort(processes, count, sizeof(ProcEnv), pid_cmp);
+    proc_attrs_sort(attrs, processes, count, sizeof(ProcEnv), offsetof(ProcEnv, attr));
 
     /* === OUTPUT – replace this block with your DB insert === */
-    printf("[\n");
-    for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\",\"env\":[",
-               processes[i].pid, processes[i].comm);
-
-        for (size_t j = 0; j < processes[i].env_count; j++) {
-            /* Escape quotes and backslashes in value (for JSON safety) */
-            printf("\"");
-            for (char *p = processes[i].env_vars[j]; *p; p++) {
-                if (*p == '"' || *p == '\\') putchar('\\');
-                putchar(*p);
+    if (dedup) {
+        printf("{\"environments\":[\n");
+        for (size_t e = 0; e < envs.count; e++) {
+            printf("  {\"id\":%zu,\"pids\":[", e);
+            bool first = true;
+            for (size_t i = 0; i < count; i++) {
+                if (processes[i].env_id != e) continue;
+                printf("%s%d", first ? "" : ",", processes[i].pid);
+                first = false;
             }
-            printf("\"");
-            if (j < processes[i].env_count - 1) printf(",");
+            printf("],\"env\":");
+            print_env_array(&vars, &envs, (unsigned)e);
+            printf("}%s\n", e < envs.count - 1 ? "," : "");
         }
-
-        printf("]}");
-        if (i < count - 1) printf(",");
-        printf("\n");
+        printf("],\"processes\":[\n");
+        for (size_t i = 0; i < count; i++) {
+            proc_attrs_row_sep(attrs, i ? &processes[i-1].attr : NULL, &processes[i].attr);
+            printf("{\"pid\":%d,\"comm\":\"%s\",\"env_id\":%u",
+                   processes[i].pid, processes[i].comm, processes[i].env_id);
+            proc_attrs_print(attrs, &processes[i].attr);
+            printf("}");
+        }
+        proc_attrs_end(attrs, true);
+        printf("]}\n");
+    } else {
+        printf("[\n");
+        for (size_t i = 0; i < count; i++) {
+            proc_attrs_row_sep(attrs, i ? &processes[i-1].attr : NULL, &processes[i].attr);
+            printf("{\"pid\":%d,\"comm\":\"%s\",\"env\":",
+                   processes[i].pid, processes[i].comm);
+            print_env_array(&vars, &envs, processes[i].env_id);
+            proc_attrs_print(attrs, &processes[i].attr);
+            printf("}");
+        }
+        proc_attrs_end(attrs, true);
+        printf("]\n");
     }
-    printf("]\n");
 
     /* Example DB replacement: insert pid, comm, then for each env_var: insert(pid, env_var) */
 
     /* Cleanup */
-    for (size_t i = 0; i < count; i++) {
-        free_procenv(&processes[i]);
-    }
     free(processes);
+    intern_free(&vars);
+    intern_free(&envs);
 }
 
-int main(void)
+/* Split "A,B,C" in place into a pattern list */
+static const char **parse_key_list(char *list, size_t *count) {
+    size_t n = 1;
+    for (const char *p = list; *p; p++) n += *p == ',';
+    const char **keys = malloc(n * sizeof(char *));
+    if (!keys) return NULL;
+
+    *count = 0;
+    for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        keys[(*count)++] = tok;
+    }
+    return keys;
+}
+
+int main(int argc, char **argv)
 {
-    scan_environment_variables();
+    EnvFilter filter = { .allow = NULL, .allow_count = 0, .deny = NULL, .deny_count = 0 };
+    bool dedup = false;
+    ProcScope scope = { 0 };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    ScanBudget budget;
+    budget_init(&budget);
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (budget_arg(&budget, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--dedup") == 0) {
+            dedup = true;
+        } else if (strcmp(argv[i], "--allow") == 0 && i + 1 < argc) {
+            free(filter.allow);
+            filter.allow = parse_key_list(argv[++i], &filter.allow_count);
+            if (!filter.allow) bad_args = true;
+        } else if (strcmp(argv[i], "--deny") == 0 && i + 1 < argc) {
+            free(filter.deny);
+            filter.deny = parse_key_list(argv[++i], &filter.deny_count);
+            if (!filter.deny) bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                    # Environment of every process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --dedup            # Each distinct environment once, processes by env_id\n", argv[0]);
+        fprintf(stderr, "  %s --allow K1,K2,P*   # Only these keys (PREFIX* allowed)\n", argv[0]);
+        fprintf(stderr, "  %s --deny K1,P*       # Drop these keys (e.g. secrets)\n", argv[0]);
+        fprintf(stderr, "  ... --budget-cpu-ms <ms> | --budget-wall-ms <ms> | --budget-io-kb <kb> | --max-core-pct <pct> --cursor <file>\n");
+        fprintf(stderr, "      # Stop at the budget and resume from the cursor next cycle; output gains coverage metadata\n");
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    bool budgeted = budget_active(&budget);
+    budget_begin(&budget);
+    if (budgeted) printf("{\"rows\":");
+    scan_environment_variables(&filter, dedup, &scope, &attrs, &budget);
+    if (budgeted) {
+        budget_finish(&budget);
+        budget_print_coverage(&budget);
+    }
+    proc_scope_free(&scope);
+    proc_attrs_free(&attrs);
+    free(filter.allow);
+    free(filter.deny);
     return 0;
 }
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>     /* for readlinkat */
+#include <limits.h>     /* for PATH_MAX */
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "scanner_proc_handle.h"
+#include "scanner_sha256.h"
+
+#define DELETED_SUFFIX " (deleted)"
+
+/* One running executable, shared by every process running the same inode */
+typedef struct {
+    unsigned long long dev;
+    unsigned long long ino;
+    long long size;
+    size_t    path_off;       /* arena offset, " (deleted)" stripped */
+    char      sha256[SHA256_HEX_LEN + 1];   /* empty: not readable */
+    bool      deleted;        /* inode no longer linked at path */
+    bool      replaced;       /* path now names a different file (upgrade while running) */
+    size_t    refcount;       /* processes running it */
+} ExeEntry;
+
+typedef struct {
+    ExeEntry *exes;
+    size_t    count;
+    size_t    capacity;
+    size_t   *slots;          /* (dev, ino) hash slot → index + 1 (0 = empty) */
+    size_t    slot_mask;
+    char     *arena;          /* paths, NUL-terminated */
+    size_t    arena_len;
+    size_t    arena_cap;
+} ExeTable;
+
+typedef struct {
+    int      pid;
+    char     comm[17];
+    unsigned exe_id;          /* index into ExeTable */
+} ProcExe;
+
+typedef struct {
+    bool        by_exe;       /* one row per executable with its PIDs */
+    const char *cache_file;   /* persistent hash cache */
+    ProcScope   scope;        /* --cgroup: only these cgroups' members */
+} ExeScanOptions;
+
+/* Comparator for qsort by PID */
+static int pid_cmp(const void *a, const void *b) {
+    return ((const ProcExe *)a)->pid - ((const ProcExe *)b)->pid;
+}
+
+static size_t exe_slot(const ExeTable *t, unsigned long long dev, unsigned long long ino) {
+    unsigned long long h = (ino * 0x9e3779b97f4a7c15ULL) ^ (dev * 0xc2b2ae3d27d4eb4fULL);
+    size_t i = (size_t)(h >> 17) & t->slot_mask;
+    while (t->slots[i]) {
+        const ExeEntry *e = &t->exes[t->slots[i] - 1];
+        if (e->dev == dev && e->ino == ino) break;
+        i = (i + 1) & t->slot_mask;
+    }
+    return i;
+}
+
+static bool exe_table_grow_slots(ExeTable *t) {
+    size_t cap = t->slots ? (t->slot_mask + 1) * 2 : 1024;
+    size_t *slots = calloc(cap, sizeof(size_t));
+    if (!slots) return false;
+    free(t->slots);
+    t->slots = slots;
+    t->slot_mask = cap - 1;
+    for (size_t id = 0; id < t->count; id++) {
+        t->slots[exe_slot(t, t->exes[id].dev, t->exes[id].ino)] = id + 1;
+    }
+    return true;
+}
+
+/* Index of the entry for (dev, ino); *created tells whether it is new. -1 on allocation failure */
+static long exe_lookup(ExeTable *t, const struct stat *st, const char *path, size_t path_len, bool *created) {
+    *created = false;
+    if ((t->count + 1) * 2 > (t->slots ? t->slot_mask + 1 : 0) && !exe_table_grow_slots(t)) return -1;
+
+    size_t slot = exe_slot(t, (unsigned long long)st->st_dev, (unsigned long long)st->st_ino);
+    if (t->slots[slot]) return (long)(t->slots[slot] - 1);
+
+    if (t->count >= t->capacity) {
+        size_t cap = t->capacity ? t->capacity * 2 : 256;
+        ExeEntry *exes = realloc(t->exes, cap * sizeof(ExeEntry));
+        if (!exes) return -1;
+        t->exes = exes;
+        t->capacity = cap;
+    }
+    if (t->arena_len + path_len + 1 > t->arena_cap) {
+        size_t cap = t->arena_cap ? t->arena_cap * 2 : 16384;
+        while (cap < t->arena_len + path_len + 1) cap *= 2;
+        char *arena = realloc(t->arena, cap);
+        if (!arena) return -1;
+        t->arena = arena;
+        t->arena_cap = cap;
+    }
+
+    ExeEntry *e = &t->exes[t->count];
+    memset(e, 0, sizeof(*e));
+    e->dev = (unsigned long long)st->st_dev;
+    e->ino = (unsigned long long)st->st_ino;
+    e->size = (long long)st->st_size;
+    e->path_off = t->arena_len;
+    memcpy(t->arena + t->arena_len, path, path_len);
+    t->arena[t->arena_len + path_len] = '\0';
+    t->arena_len += path_len + 1;
+
+    t->slots[slot] = ++t->count;
+    *created = true;
+    return (long)(t->count - 1);
+}
+
+static void exe_table_free(ExeTable *t) {
+    free(t->exes);
+    free(t->slots);
+    free(t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+/*
+   First sighting of an executable: hash it through the process's own exe link
+   (works for deleted binaries too) and check whether its path still names it.
+   The path is resolved under /proc/<pid>/root so container binaries are checked
+   in their own mount namespace.
+*/
+static void exe_inspect(ExeEntry *e, const char *path, const ProcHandle *h, HashCache *cache) {
+    int fd = proc_handle_openat(h, "exe");
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || sha256_cached(cache, fd, &st, e->sha256) != 0) e->sha256[0] = '\0';
+        close(fd);
+    }
+
+    if (path[0] != '/') return;   /* not a filesystem path */
+    char rooted[PATH_MAX];
+    int n = snprintf(rooted, sizeof(rooted), "root%s", path);
+    if (n < 0 || n >= (int)sizeof(rooted)) return;
+
+    struct stat on_disk;
+    if (fstatat(h->dirfd, rooted, &on_disk, 0) == 0) {
+        e->replaced = (unsigned long long)on_disk.st_dev != e->dev || (unsigned long long)on_disk.st_ino != e->ino;
+    } else if (!e->deleted) {
+        e->replaced = true;   /* renamed away, or gone without the kernel marking it */
+    }
+}
+
+static void print_json_path(const char *path) {
+    printf("\"");
+    for (const char *p = path; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
+    }
+    printf("\"");
+}
+
+/* Shared columns of an executable */
+static void print_exe(const ExeTable *t, const ExeEntry *e) {
+    printf("\"exe\":");
+    print_json_path(t->arena + e->path_off);
+    printf(",\"dev\":\"%02x:%02x\",\"inode\":%llu,\"size\":%lld,\"sha256\":",
+           major((dev_t)e->dev), minor((dev_t)e->dev), e->ino, e->size);
+    if (e->sha256[0]) printf("\"%s\"", e->sha256);
+    else printf("null");
+    printf(",\"deleted\":%s,\"replaced\":%s", e->deleted ? "true" : "false", e->replaced ? "true" : "false");
+}
+
+/* Executable order for --by-exe: most shared first, then by path */
+static const ExeTable *sort_table;
+static int exe_ref_cmp(const void *a, const void *b) {
+    const ExeEntry *ea = &sort_table->exes[*(const size_t *)a];
+    const ExeEntry *eb = &sort_table->exes[*(const size_t *)b];
+    if (ea->refcount != eb->refcount) return ea->refcount < eb->refcount ? 1 : -1;
+    return strcmp(sort_table->arena + ea->path_off, sort_table->arena + eb->path_off);
+}
+
+/* Reverse index: one row per executable with refcount and the PIDs running it */
+static void print_by_exe(const ExeTable *t, const ProcExe *procs, size_t count) {
+    /* CSR layout: pid lists for all executables in one array, sliced by refcount */
+    size_t *start = calloc(t->count + 1, sizeof(size_t));
+    size_t *fill = calloc(t->count, sizeof(size_t));
+    size_t *order = malloc(t->count * sizeof(size_t));
+    int *pids = malloc(count * sizeof(int));
+    if (!start || !fill || !order || !pids) {
+        printf("[]\n");
+        goto out;
+    }
+
+    for (size_t id = 0; id < t->count; id++) start[id + 1] = start[id] + t->exes[id].refcount;
+    /* procs are sorted by PID, so every list comes out sorted */
+    for (size_t i = 0; i < count; i++) {
+        unsigned id = procs[i].exe_id;
+        pids[start[id] + fill[id]++] = procs[i].pid;
+    }
+
+    for (size_t id = 0; id < t->count; id++) order[id] = id;
+    sort_table = t;
+    qsort(order, t->count, sizeof(size_t), exe_ref_cmp);
+
+    /* === OUTPUT – replace this block with your DB insert === */
+    printf("[\n");
+    for (size_t k = 0; k < t->count; k++) {
+        size_t id = order[k];
+        const ExeEntry *e = &t->exes[id];
+        printf("  {");
+        print_exe(t, e);
+        printf(",\"refcount\":%zu,\"pids\":[", e->refcount);
+        for (size_t j = start[id]; j < start[id + 1]; j++) {
+            printf("%d%s", pids[j], j + 1 < start[id + 1] ? "," : "");
+        }
+        printf("]}%s\n", k < t->count - 1 ? "," : "");
+    }
+    printf("]\n");
+
+out:
+    free(start);
+    free(fill);
+    free(order);
+    free(pids);
+}
+
+/*
+   Scanner: Executable each process is running (/proc/<pid>/exe)
+   Executables are deduplicated by (dev, inode): 5,000 workers of one binary cost
+   one SHA-256 (read through the exe link, so deleted binaries hash too). With
+   opts->cache_file digests persist across runs (scanner_sha256.h) and an
+   unchanged binary is not read at all.
+   "deleted": the running inode was unlinked; "replaced": the path now names a
+   different file (upgraded on disk, process still runs the old one).
+   Kernel threads have no exe and are skipped; hashing another user's binary
+   through its exe link requires root (ptrace access), else sha256 is null.
+   Output: JSON array of {pid, comm, exe, dev, inode, size, sha256, deleted, replaced}
+   With by_exe: {exe, dev, inode, size, sha256, deleted, replaced, refcount, pids: [...]},
+   most shared first
+*/
+void scan_running_executables(const ExeScanOptions *opts)
+{
+    HashCache cache;
+    hash_cache_init(&cache);
+    if (opts->cache_file) hash_cache_load(&cache, opts->cache_file);
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, &opts->scope)) {
+        hash_cache_free(&cache);
+        return;
+    }
+
+    ExeTable table = { 0 };
+    ProcExe *procs = NULL;
+    size_t capacity = 0;
+    size_t count = 0;
+
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        char target[PATH_MAX];
+        ssize_t len = readlinkat(h.dirfd, "exe", target, sizeof(target) - 1);
+        struct stat st;
+        if (len <= 0 || fstatat(h.dirfd, "exe", &st, 0) != 0) {   /* kernel thread, gone, or no access */
+            proc_handle_close(&h);
+            continue;
+        }
+        target[len] = '\0';
+
+        bool deleted = false;
+        size_t suffix_len = strlen(DELETED_SUFFIX);
+        if ((size_t)len > suffix_len && strcmp(target + len - suffix_len, DELETED_SUFFIX) == 0) {
+            deleted = true;
+            len -= (ssize_t)suffix_len;
+            target[len] = '\0';
+        }
+
+        bool created;
+        long id = exe_lookup(&table, &st, target, (size_t)len, &created);
+        if (id < 0) {
+            proc_handle_close(&h);
+            continue;
+        }
+        if (created) {
+            table.exes[id].deleted = deleted;
+            exe_inspect(&table.exes[id], target, &h, &cache);
+        }
+
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 8192;
+            ProcExe *new_procs = realloc(procs, capacity * sizeof(ProcExe));
+            if (!new_procs) {
+                proc_handle_close(&h);
+                continue;
+            }
+            procs = new_procs;
+        }
+
+        procs[count].pid = h.pid;
+        snprintf(procs[count].comm, sizeof(procs[count].comm), "%s", proc_handle_comm(&h));
+        procs[count].exe_id = (unsigned)id;
+        table.exes[id].refcount++;
+        count++;
+        proc_handle_close(&h);
+    }
+    proc_iter_close(&it);
+
+    if (opts->cache_file) hash_cache_save(&cache, opts->cache_file);
+    hash_cache_free(&cache);
+
+    if (count == 0) {
+        free(procs);
+        exe_table_free(&table);
+        printf("[]\n");
+        return;
+    }
+
+    /* Sort by PID */
+    qsort(procs, count, sizeof(ProcExe), pid_cmp);
+
+    if (opts->by_exe) {
+        print_by_exe(&table, procs, count);
+    } else {
+        /* === OUTPUT – replace this block with your DB insert === */
+        printf("[\n");
+        for (size_t i = 0; i < count; i++) {
+            printf("  {\"pid\":%d,\"comm\":\"%s\",", procs[i].pid, procs[i].comm);
+            print_exe(&table, &table.exes[procs[i].exe_id]);
+            printf("}%s\n", i < count - 1 ? "," : "");
+        }
+        printf("]\n");
+    }
+
+    free(procs);
+    exe_table_free(&table);
+}
+
+int main(int argc, char **argv)
+{
+    ExeScanOptions opts = { .by_exe = false, .cache_file = NULL, .scope = { 0 } };
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--by-exe") == 0) {
+            opts.by_exe = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            opts.cache_file = argv[++i];
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                # Executable + SHA-256 per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --by-exe       # One row per executable with refcount and PIDs\n", argv[0]);
+        fprintf(stderr, "  %s --cache <file> # Keep digests across runs (unchanged binaries are not re-read)\n", argv[0]);
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        return 1;
+    }
+
+    scan_running_executables(&opts);
+    proc_scope_free(&opts.scope);
+    return 0;
+}
@@ -3,6 +3,11 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_topn.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
@@ -14,20 +19,78 @@ typedef struct {
     char  comm[17];           /* short process name */
     int   open_fds;           /* number of entries in /proc/pid/fd */
     int   fdinfo_count;       /* optional: number in /proc/pid/fdinfo (usually same) */
+    ProcAttr attr;            /* --ns / --group-by */
 } ProcFDCount;
 
+typedef struct {
+    bool fdinfo;              /* also walk /proc/<pid>/fdinfo (opt-in) */
+    bool force_readdir;       /* ignore the st_size fast path */
+    ProcScope scope;          /* --cgroup: only these cgroups' members */
+    size_t top;               /* --top: keep only the N processes with most fds; 0 = all */
+} FdCountOptions;
+
+/* --by: only one ranking column here, accepted for symmetry with the other scanners */
+static const char *const fd_by_names[] = { "fds" };
+
+/* Count entries of a process's fd-style directory ("fd", "fdinfo"), skipping . and .. */
+static int count_dir_entries(const ProcHandle *h, const char *name) {
+    DIR *dir = proc_handle_opendir(h, name);
+    if (!dir) return -1;   /* process vanished or no access */
+
+    int n = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.' &&
+            (de->d_name[1] == '\0' || (de->d_name[1] == '.' && de->d_name[2] == '\0'))) {
+            continue;
+        }
+        n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+/*
+   Since Linux 6.2, stat() on /proc/<pid>/fd reports the number of open fds in
+   st_size (older kernels report 0). Detect once: with a directory stream open on
+   our own fd dir, st_size must be non-zero and match the readdir count.
+*/
+static bool fd_size_supported(void) {
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) return false;
+
+    struct stat st;
+    bool ok = fstat(dirfd(dir), &st) == 0 && st.st_size > 0;
+
+    int n = 0;
+    struct dirent *de;
+    while (ok && (de = readdir(dir)) != NULL) {
+        if (de->d_name[0] != '.') n++;
+    }
+    closedir(dir);
+    return ok && st.st_size == n;
+}
+
 /*
    Scanner: Open file descriptors count for all running processes
-   Counts entries in /proc/<pid>/fd directory (most accurate & efficient method)
-   Also optionally counts /proc/<pid>/fdinfo (should match)
+   Counts entries in /proc/<pid>/fd: O(1) via st_size on Linux >= 6.2 (detected
+   once at startup), readdir on older kernels. Every read goes through the
+   process's ProcHandle (scanner_proc_handle.h), so a recycled PID is never mixed in
+   Also optionally counts /proc/<pid>/fdinfo (should match), opt-in since it is a
+   second full directory walk per process
+   attrs adds namespace/cgroup/container columns or grouping (scanner_proc_attrs.h)
+   With opts->top the fd count is taken first and comm, fdinfo and attributes are
+   only read for processes that make the top N (bounded heap, scanner_topn.h);
+   rows come out most fds first
 
    Output: JSON array → replace print block with your DB insert logic
 */
-void scan_open_file_descriptors(void)
+void scan_open_file_descriptors(const FdCountOptions *opts, ProcAttrs *attrs)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    bool fast_path = !opts->force_readdir && fd_size_supported();
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, &opts->scope)) {
         return;
     }
 
@@ -35,60 +98,45 @@ void scan_open_file_descriptors(void)
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Build /proc/<pid>/comm for nicer output */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = {0};
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
-        }
+    TopN top;
+    if (!topn_init(&top, opts->top, sizeof(ProcFDCount))) {
+        proc_iter_close(&it);
+        printf("[]\n");
+        return;
+    }
 
-        /* Count open fds: number of entries in /proc/<pid>/fd */
-        char fd_path[64];
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
-
-        DIR *fddir = opendir(fd_path);
-        if (!fddir) continue;   /* process vanished or no access */
-
-        int fd_count = 0;
-        struct dirent *fdent;
-        while ((fdent = readdir(fddir)) != NULL) {
-            /* Skip . and .. */
-            if (fdent->d_name[0] == '.' &&
-                (fdent->d_name[1] == '\0' || (fdent->d_name[1] == '.' && fdent->d_name[2] == '\0'))) {
-                continue;
-            }
-            fd_count++;
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        /* Count open fds: st_size of /proc/<pid>/fd when supported, else readdir */
+        int fd_count;
+        if (fast_path) {
+            struct stat st;
+            fd_count = fstatat(h.dirfd, "fd", &st, 0) == 0 ? (int)st.st_size : -1;   /* -1: vanished or no access */
+        } else {
+            fd_count = count_dir_entries(&h, "fd");
         }
-        closedir(fddir);
 
-        if (fd_count == 0) continue;   /* rare, but skip empty */
+        /* rare, but skip empty */
+        if (fd_count <= 0 || !topn_would_enter(&top, fd_count)) {
+            proc_handle_close(&h);
+            continue;
+        }
 
         /* Optional: also count fdinfo (usually same number) */
         int fdinfo_count = 0;
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fdinfo", pid);
-        DIR *fdinfodir = opendir(fd_path);
-        if (fdinfodir) {
-            while ((fdent = readdir(fdinfodir)) != NULL) {
-                if (fdent->d_name[0] == '.' && 
-                    (fdent->d_name[1] == '\0' || (fdent->d_name[1] == '.' && fdent->d_name[2] == '\0'))) continue;
-                fdinfo_count++;
-            }
-            closedir(fdinfodir);
+        if (opts->fdinfo) {
+            fdinfo_count = count_dir_entries(&h, "fdinfo");
+            if (fdinfo_count < 0) fdinfo_count = 0;
+        }
+
+        ProcFDCount row = { .pid = h.pid, .open_fds = fd_count, .fdinfo_count = fdinfo_count };
+        snprintf(row.comm, sizeof(row.comm), "%s", proc_handle_comm(&h));
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, h.pid, &row.attr);
+        proc_handle_close(&h);
+
+        if (topn_enabled(&top)) {
+            topn_push(&top, fd_count, &row, NULL);
+            continue;
         }
 
         /* Grow array */
@@ -99,16 +147,11 @@ void scan_open_file_descriptors(void)
             fds = new_fds;
         }
 
-        fds[count].pid = pid;
-        strncpy(fds[count].comm, comm, sizeof(fds[count].comm) - 1);
-        fds[count].comm[sizeof(fds[count].comm) - 1] = '\0';
-        fds[count].open_fds = fd_count;
-        fds[count].fdinfo_count = fdinfo_count;
-
-        count++;
+        fds[count++] = row;
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
+    if (topn_enabled(&top)) fds = topn_finish(&top, &count);
 
     if (count == 0) {
         free(fds);
@@ -116,19 +159,25 @@ void scan_open_file_descriptors(void)
         return;
     }
 
-    /* Sort by PID for consistent output */
-    qsort(fds, count, sizeof(ProcFDCount), pid_cmp);
+    /* Sort by PID for consistent output (--top: already most fds first) */
+    if (!opts->top) {
+        qsort(fds, count, sizeof(ProcFDCount), pid_cmp);
+        proc_attrs_sort(attrs, fds, count, sizeof(ProcFDCount), offsetof(ProcFDCount, attr));
+    } else {
+        proc_attrs_sort_ranked(attrs, fds, count, sizeof(ProcFDCount), offsetof(ProcFDCount, attr));
+    }
 
     /* === OUTPUT – replace this with your database insert code === */
     printf("[\n");
     for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\",\"open_fds\":%d,\"fdinfo_count\":%d}",
-               fds[i].pid, fds[i].comm,
-               fds[i].open_fds, fds[i].fdinfo_count);
-
-        if (i < count - 1) printf(",");
-        printf("\n");
+        proc_attrs_row_sep(attrs, i ? &fds[i-1].attr : NULL, &fds[i].attr);
+        printf("{\"pid\":%d,\"comm\":\"%s\",\"open_fds\":%d",
+               fds[i].pid, fds[i].comm, fds[i].open_fds);
+        if (opts->fdinfo) printf(",\"fdinfo_count\":%d", fds[i].fdinfo_count);
+        proc_attrs_print(attrs, &fds[i].attr);
+        printf("}");
     }
+    proc_attrs_end(attrs, count > 0);
     printf("]\n");
 
     /* Example DB-style loop:
@@ -141,8 +190,48 @@ void scan_open_file_descriptors(void)
     free(fds);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_open_file_descriptors();
+    FdCountOptions opts = { .fdinfo = false, .force_readdir = false, .scope = { 0 }, .top = 0 };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--fdinfo") == 0) {
+            opts.fdinfo = true;
+        } else if (strcmp(argv[i], "--readdir") == 0) {
+            opts.force_readdir = true;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            opts.top = strtoul(argv[++i], NULL, 10);
+            if (opts.top == 0) bad_args = true;
+        } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+            if (topn_field(argv[++i], fd_by_names, sizeof(fd_by_names) / sizeof(fd_by_names[0])) < 0) bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s             # Open fd count per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --fdinfo    # Also count /proc/<pid>/fdinfo (fdinfo_count)\n", argv[0]);
+        fprintf(stderr, "  %s --readdir   # Count by readdir even if st_size is supported\n", argv[0]);
+        fprintf(stderr, "  ... --top <n> [--by fds]\n");
+        fprintf(stderr, "      # Only the n processes with most fds, most first; comm/fdinfo skipped for the rest\n");
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    scan_open_file_descriptors(&opts, &attrs);
+    proc_scope_free(&opts.scope);
+    proc_attrs_free(&attrs);
     return 0;
 }
@@ -7,11 +7,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <limits.h>
-#include <openssl/evp.h>
+#include <fcntl.h>
+#include "scanner_sha256.h"
+#include "scanner_budget.h"
 
 typedef struct {
     char path[PATH_MAX];
-    char sha256[EVP_MAX_MD_SIZE * 2 + 1];  /* hex string + null */
+    char sha256[SHA256_HEX_LEN + 1];  /* hex string + null */
 } FileHash;
 
 /* Comparator for qsort by path (alphabetical) */
@@ -20,86 +22,95 @@ static int path_cmp(const void *a, const void *b) {
                   ((const FileHash *)b)->path);
 }
 
-/* Compute SHA-256 hex digest of a file using EVP (modern OpenSSL) */
-static int compute_sha256(const char *path, char *digest) {
-    FILE *fp = fopen(path, "rb");
-    if (!fp) return -1;
-
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx) { fclose(fp); return -1; }
-
-    const EVP_MD *md = EVP_sha256();
-    if (!md) { EVP_MD_CTX_free(mdctx); fclose(fp); return -1; }
-
-    if (EVP_DigestInit_ex(mdctx, md, NULL) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        fclose(fp);
-        return -1;
+/* Hex digest of one regular file; through cache (may be NULL) when given. --max-core-pct applies per chunk */
+static int hash_file(const char *path, HashCache *cache, ScanBudget *budget, char *digest) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc;
+    if (cache) {
+        struct stat st;
+        rc = fstat(fd, &st) == 0 ? sha256_cached(cache, fd, &st, digest) : -1;
+    } else {
+        rc = sha256_fd_progress(fd, digest, budget_throttle_cb, budget);
     }
+    close(fd);
+    return rc;
+}
 
-    unsigned char buffer[8192];
-    size_t len;
-    while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        if (EVP_DigestUpdate(mdctx, buffer, len) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            fclose(fp);
-            return -1;
-        }
-    }
+static int name_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
 
-    if (ferror(fp)) {
-        EVP_MD_CTX_free(mdctx);
-        fclose(fp);
-        return -1;
+/* strcmp with '/' before every other byte: the order of a depth-first walk by sorted names */
+static int walk_path_cmp(const char *a, const char *b) {
+    for (;; a++, b++) {
+        unsigned char ca = *a == '/' ? 1 : (unsigned char)*a;
+        unsigned char cb = *b == '/' ? 1 : (unsigned char)*b;
+        if (ca != cb || !ca) return (ca > cb) - (ca < cb);
     }
+}
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        fclose(fp);
-        return -1;
-    }
+/* Already covered by the pass: at or before the cursor and not a directory holding it */
+static bool before_cursor(const char *path, const char *cursor) {
+    if (!cursor[0] || walk_path_cmp(path, cursor) > 0) return false;
+    size_t len = strlen(path);
+    return !(strncmp(cursor, path, len) == 0 && cursor[len] == '/');
+}
 
-    EVP_MD_CTX_free(mdctx);
-    fclose(fp);
+/* Entry names of dir sorted, so a budgeted walk can stop and resume at a path */
+static char **read_sorted_names(const char *dir, ScanBudget *budget, size_t *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (!d) return NULL;
 
-    for (unsigned int i = 0; i < hash_len; ++i) {
-        sprintf(digest + i * 2, "%02x", hash[i]);
+    char **names = NULL;
+    size_t capacity = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        budget_throttle(budget);
+        if (*count >= capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char **new_names = realloc(names, capacity * sizeof(char *));
+            if (!new_names) break;
+            names = new_names;
+        }
+        if ((names[*count] = strdup(e->d_name)) != NULL) (*count)++;
     }
-    digest[hash_len * 2] = '\0';
-    return 0;
+    closedir(d);
+    if (*count) qsort(names, *count, sizeof(char *), name_cmp);
+    return names;
 }
 
-/* Recursive scanner function – only hash regular files */
-static void scan_dir(const char *dir, FileHash **hashes, size_t *count, size_t *capacity) {
-    DIR *d = opendir(dir);
-    if (!d) {
+/* Recursive scanner function – only hash regular files; stops when the budget runs out */
+static void scan_dir(const char *dir, HashCache *cache, ScanBudget *budget,
+                     FileHash **hashes, size_t *count, size_t *capacity) {
+    size_t name_count;
+    char **names = read_sorted_names(dir, budget, &name_count);
+    if (!names) {
         /* cannot open directory – skip silently */
         return;
     }
 
-    struct dirent *e;
-    while ((e = readdir(d)) != NULL) {
-        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
-
+    for (size_t i = 0; i < name_count && !budget->stopped_by; i++) {
         char full[PATH_MAX];
-        int rc = snprintf(full, sizeof(full), "%s/%s", dir, e->d_name);
-        if (rc < 0) continue;
+        int rc = snprintf(full, sizeof(full), "%s/%s", dir, names[i]);
+        if (rc < 0 || rc >= (int)sizeof(full)) continue;
+        if (before_cursor(full, budget_resume_path(budget))) continue;
 
         struct stat st;
         if (lstat(full, &st) < 0) continue;
 
         /* If regular file, compute hash */
         if (S_ISREG(st.st_mode)) {
+            if (budget_stop(budget)) break;
+            budget_done_path(budget, full);   /* once started, a file is always finished */
+
             /* Grow array if needed */
             if (*count >= *capacity) {
                 *capacity = *capacity ? *capacity * 2 : 8192;
                 FileHash *new_hashes = realloc(*hashes, *capacity * sizeof(FileHash));
-                if (!new_hashes) {
-                    closedir(d);
-                    return;
-                }
+                if (!new_hashes) break;
                 *hashes = new_hashes;
             }
 
@@ -109,7 +120,7 @@ static void scan_dir(const char *dir, FileHash **hashes, size_t *count, size_t *
             memcpy((*hashes)[*count].path, full, plen);
             (*hashes)[*count].path[plen] = '\0';
 
-            if (compute_sha256(full, (*hashes)[*count].sha256) == 0) {
+            if (hash_file(full, cache, budget, (*hashes)[*count].sha256) == 0) {
                 (*count)++;
             } else {
                 /* failed to read/hash — skip this file */
@@ -118,26 +129,42 @@ static void scan_dir(const char *dir, FileHash **hashes, size_t *count, size_t *
 
         /* Recurse if directory (not symlink) */
         if (S_ISDIR(st.st_mode) && !S_ISLNK(st.st_mode)) {
-            scan_dir(full, hashes, count, capacity);
+            scan_dir(full, cache, budget, hashes, count, capacity);
         }
     }
 
-    closedir(d);
+    for (size_t i = 0; i < name_count; i++) free(names[i]);
+    free(names);
 }
 
 /*
    Scanner: SHA-256 hash of files for integrity checking
    Recursively scans a directory (default: current, or from argv[1])
    Only computes for regular files (skips dirs, symlinks, devices, etc.)
-   Uses OpenSSL EVP API (modern, not deprecated).
+   Uses OpenSSL EVP API (modern, not deprecated), shared via scanner_sha256.h.
+   With cache_file, files whose (dev, inode, size, mtime, ctime) match the previous
+   run reuse the cached digest instead of being read again.
+   Directories are walked in sorted name order, so budget (scanner_budget.h) can stop
+   at its limit and the next cycle resume after the cursor path. A cycle that does not
+   cover the whole tree keeps the cache entries it did not look up.
 */
-void scan_file_hashes(const char *start_dir)
+void scan_file_hashes(const char *start_dir, const char *cache_file, ScanBudget *budget)
 {
     FileHash *hashes = NULL;
     size_t capacity = 0;
     size_t count = 0;
 
-    scan_dir(start_dir, &hashes, &count, &capacity);
+    HashCache cache;
+    hash_cache_init(&cache);
+    if (cache_file) hash_cache_load(&cache, cache_file);
+    cache.progress = budget_throttle_cb;
+    cache.progress_arg = budget;
+
+    scan_dir(start_dir, cache_file ? &cache : NULL, budget, &hashes, &count, &capacity);
+
+    cache.keep_unseen = !budget_full_pass(budget);
+    if (cache_file) hash_cache_save(&cache, cache_file);
+    hash_cache_free(&cache);
 
     if (count == 0) {
         free(hashes);
@@ -169,7 +196,34 @@ void scan_file_hashes(const char *start_dir)
 
 int main(int argc, char **argv)
 {
-    const char *dir = (argc > 1) ? argv[1] : ".";
-    scan_file_hashes(dir);
+    const char *dir = ".";
+    const char *cache_file = NULL;
+    ScanBudget budget;
+    budget_init(&budget);
+
+    for (int i = 1; i < argc; i++) {
+        if (budget_arg(&budget, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_file = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s [dir]                   # SHA-256 of regular files under dir (default .) → JSON\n", argv[0]);
+            fprintf(stderr, "  %s --cache <file> [dir]    # Reuse digests of files unchanged since the last run\n", argv[0]);
+            fprintf(stderr, "  %s --budget-cpu-ms <ms> | --budget-wall-ms <ms> | --budget-io-kb <kb> | --max-core-pct <pct> --cursor <file> [dir]\n", argv[0]);
+            fprintf(stderr, "      # Stop at the budget and resume from the cursor next cycle; output gains coverage metadata\n");
+            return 1;
+        } else {
+            dir = argv[i];
+        }
+    }
+
+    bool budgeted = budget_active(&budget);
+    budget_begin(&budget);
+    if (budgeted) printf("{\"rows\":");
+    scan_file_hashes(dir, cache_file, &budget);
+    if (budgeted) {
+        budget_finish(&budget);
+        budget_print_coverage(&budget);
+    }
     return 0;
 }
@@ -7,6 +7,8 @@
 #include <unistd.h>
 #include <limits.h>
 #include <time.h>
+#include <stdbool.h>
+#include "scanner_names.h"
 
 /* File info structure MUST be defined before comparator */
 typedef struct {
@@ -103,8 +105,8 @@ static void scan_dir(const char *dir, FileInfo **files,
 
 
 
-/* Main scanner */
-void scan_file_metadata(const char *start_dir)
+/* Main scanner (names may be NULL: numeric uid/gid only) */
+void scan_file_metadata(const char *start_dir, NameCache *names)
 {
     FileInfo *files=NULL;
 
@@ -153,7 +155,7 @@ void scan_file_metadata(const char *start_dir)
                "\"gid\":%u,"
                "\"mtime\":%ld,"
                "\"ctime\":%ld,"
-               "\"atime\":%ld}",
+               "\"atime\":%ld",
 
                (long long)files[i].size,
                mode,
@@ -163,6 +165,13 @@ void scan_file_metadata(const char *start_dir)
                (long)files[i].ctime,
                (long)files[i].atime);
 
+        if (names) {
+            names_print(",\"user\":", names_user(names, files[i].uid));
+            names_print(",\"group\":", names_group(names, files[i].gid));
+        }
+
+        printf("}");
+
 
         if (i<count-1)
             printf(",");
@@ -180,9 +189,38 @@ void scan_file_metadata(const char *start_dir)
 
 int main(int argc,char **argv)
 {
-    const char *dir = (argc>1) ? argv[1] : ".";
+    const char *dir = ".";
+    bool resolve = false;
+    const char *names_cache = NULL;
+
+    for (int i=1;i<argc;i++) {
+
+        if (!strcmp(argv[i],"--names"))
+            resolve = true;
+        else if (!strcmp(argv[i],"--names-cache") && i+1<argc) {
+            resolve = true;
+            names_cache = argv[++i];
+        }
+        else
+            dir = argv[i];
+    }
+
+    NameCache names;
+
+    names_init(&names);
+
+    if (resolve)
+        names_refresh(&names);
+
+    if (names_cache)
+        names_cache_load(&names, names_cache);
+
+    scan_file_metadata(dir, resolve ? &names : NULL);
+
+    if (names_cache)
+        names_cache_save(&names, names_cache);
 
-    scan_file_metadata(dir);
+    names_free(&names);
 
     return 0;
 }
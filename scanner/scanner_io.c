@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>       /* for clock_gettime, nanosleep */
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+
+typedef struct {
+    int   pid;
+    unsigned long long starttime;  /* with pid: identity across samples */
+    char  comm[17];                /* short name */
+    unsigned long long rchar;      /* bytes passed to read()-like syscalls (incl. page cache) */
+    unsigned long long wchar;
+    unsigned long long syscr;      /* read syscalls */
+    unsigned long long syscw;      /* write syscalls */
+    unsigned long long read_bytes; /* bytes fetched from the storage layer */
+    unsigned long long write_bytes;
+    unsigned long long cancelled_write_bytes; /* dirty pages truncated before writeback */
+    bool   has_rate;               /* rates below are filled (second sample) */
+    double rchar_bps;
+    double wchar_bps;
+    double read_iops;              /* syscr per second */
+    double write_iops;             /* syscw per second */
+    double read_bps;               /* read_bytes per second */
+    double write_bps;
+    double cancelled_write_bps;
+    ProcAttr attr;                 /* --ns / --group-by */
+} ProcIo;
+
+/* Sort key for --top */
+typedef enum {
+    IO_BY_TOTAL_BPS = 0,  /* read_bps + write_bps (cumulative: read_bytes + write_bytes) */
+    IO_BY_READ_BPS,
+    IO_BY_WRITE_BPS,
+    IO_BY_IOPS,           /* read_iops + write_iops (cumulative: syscr + syscw) */
+    IO_BY_READ_IOPS,
+    IO_BY_WRITE_IOPS,
+    IO_BY_CHAR_BPS        /* rchar_bps + wchar_bps (cumulative: rchar + wchar) */
+} IoSortKey;
+
+static const char *io_sort_names[] = {
+    "total_bps", "read_bps", "write_bps", "iops", "read_iops", "write_iops", "char_bps"
+};
+
+typedef struct {
+    unsigned interval_ms;   /* > 0: second sample, compute rates */
+    bool     resident;      /* keep sampling every interval, one JSON document per interval */
+    unsigned count;         /* resident: documents before exit, 0 = forever */
+    size_t   top;           /* > 0: only the top N processes by 'by' */
+    IoSortKey by;
+    ProcScope scope;        /* --cgroup / --filter: only these processes */
+} IoScanOptions;
+
+/* Comparator for qsort/bsearch by PID */
+static int pid_cmp(const void *a, const void *b) {
+    const ProcIo *pa = a;
+    const ProcIo *pb = b;
+    return (pa->pid > pb->pid) - (pa->pid < pb->pid);
+}
+
+static double io_sort_value(const ProcIo *p, IoSortKey by) {
+    if (p->has_rate) {
+        switch (by) {
+        case IO_BY_READ_BPS:   return p->read_bps;
+        case IO_BY_WRITE_BPS:  return p->write_bps;
+        case IO_BY_IOPS:       return p->read_iops + p->write_iops;
+        case IO_BY_READ_IOPS:  return p->read_iops;
+        case IO_BY_WRITE_IOPS: return p->write_iops;
+        case IO_BY_CHAR_BPS:   return p->rchar_bps + p->wchar_bps;
+        default:               return p->read_bps + p->write_bps;
+        }
+    }
+    switch (by) {
+    case IO_BY_READ_BPS:   return (double)p->read_bytes;
+    case IO_BY_WRITE_BPS:  return (double)p->write_bytes;
+    case IO_BY_IOPS:       return (double)(p->syscr + p->syscw);
+    case IO_BY_READ_IOPS:  return (double)p->syscr;
+    case IO_BY_WRITE_IOPS: return (double)p->syscw;
+    case IO_BY_CHAR_BPS:   return (double)(p->rchar + p->wchar);
+    default:               return (double)(p->read_bytes + p->write_bytes);
+    }
+}
+
+static IoSortKey sort_key;   /* qsort has no context argument */
+
+/* Descending by sort_key, ties by PID */
+static int io_value_cmp(const void *a, const void *b) {
+    double va = io_sort_value(a, sort_key);
+    double vb = io_sort_value(b, sort_key);
+    if (va != vb) return va < vb ? 1 : -1;
+    return pid_cmp(a, b);
+}
+
+static unsigned long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+/* Parse the io file of one process; false if gone or not permitted (needs ptrace access) */
+static bool read_proc_io(const ProcHandle *h, ProcIo *p) {
+    FILE *fp = proc_handle_fopen(h, "io");
+    if (!fp) return false;
+
+    char line[128];
+    int seen = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "rchar:", 6) == 0) {
+            seen += sscanf(line + 6, "%llu", &p->rchar);
+        } else if (strncmp(line, "wchar:", 6) == 0) {
+            seen += sscanf(line + 6, "%llu", &p->wchar);
+        } else if (strncmp(line, "syscr:", 6) == 0) {
+            seen += sscanf(line + 6, "%llu", &p->syscr);
+        } else if (strncmp(line, "syscw:", 6) == 0) {
+            seen += sscanf(line + 6, "%llu", &p->syscw);
+        } else if (strncmp(line, "read_bytes:", 11) == 0) {
+            seen += sscanf(line + 11, "%llu", &p->read_bytes);
+        } else if (strncmp(line, "write_bytes:", 12) == 0) {
+            seen += sscanf(line + 12, "%llu", &p->write_bytes);
+        } else if (strncmp(line, "cancelled_write_bytes:", 22) == 0) {
+            seen += sscanf(line + 22, "%llu", &p->cancelled_write_bytes);
+        }
+    }
+    fclose(fp);
+    return seen == 7;
+}
+
+/* One pass over /proc (or the scope's members); returns a pid-sorted array (caller frees) */
+static ProcIo *take_io_sample(const ProcScope *scope, size_t *out_count) {
+    ProcIo *procs = NULL;
+    size_t capacity = 0;
+    size_t count = 0;
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, scope)) {
+        *out_count = 0;
+        return NULL;
+    }
+
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        /* Grow array */
+        if (count >= capacity) {
+            size_t newcap = capacity ? capacity * 2 : 8192;
+            ProcIo *new_procs = realloc(procs, newcap * sizeof(ProcIo));
+            if (!new_procs) {
+                proc_handle_close(&h);
+                break;
+            }
+            procs = new_procs;
+            capacity = newcap;
+        }
+
+        ProcIo *p = &procs[count];
+        memset(p, 0, sizeof(*p));
+        if (read_proc_io(&h, p)) {
+            p->pid = h.pid;
+            p->starttime = h.starttime;
+            snprintf(p->comm, sizeof(p->comm), "%s", proc_handle_comm(&h));
+            count++;
+        }
+        proc_handle_close(&h);
+    }
+    proc_iter_close(&it);
+
+    qsort(procs, count, sizeof(ProcIo), pid_cmp);
+    *out_count = count;
+    return procs;
+}
+
+/* Counter delta per second; counters never go backwards for the same process */
+static double rate(unsigned long long now, unsigned long long before, double secs) {
+    return now >= before ? (double)(now - before) / secs : 0.0;
+}
+
+/* Fill rates of cur[] from prev[]; processes without a previous sample (new, PID reused) keep has_rate = false */
+static void compute_io_rates(ProcIo *cur, size_t cur_count, const ProcIo *prev, size_t prev_count, double secs) {
+    for (size_t i = 0; i < cur_count; i++) {
+        ProcIo *c = &cur[i];
+        const ProcIo *p = bsearch(c, prev, prev_count, sizeof(ProcIo), pid_cmp);
+        if (!p || p->starttime != c->starttime) continue;
+
+        c->has_rate = true;
+        c->rchar_bps = rate(c->rchar, p->rchar, secs);
+        c->wchar_bps = rate(c->wchar, p->wchar, secs);
+        c->read_iops = rate(c->syscr, p->syscr, secs);
+        c->write_iops = rate(c->syscw, p->syscw, secs);
+        c->read_bps = rate(c->read_bytes, p->read_bytes, secs);
+        c->write_bps = rate(c->write_bytes, p->write_bytes, secs);
+        c->cancelled_write_bps = rate(c->cancelled_write_bytes, p->cancelled_write_bytes, secs);
+    }
+}
+
+/* Attributes for one row that will be printed; cleared if the PID now belongs to another process */
+static void read_row_attrs(ProcAttrs *attrs, ProcIo *p) {
+    ProcHandle h;
+    unsigned long long starttime;
+    if (proc_handle_open_dir(&h, p->pid) && proc_handle_read_starttime(h.dirfd, &starttime) &&
+        starttime == p->starttime) {
+        proc_attrs_read_at(attrs, h.dirfd, p->pid, &p->attr);
+    } else {
+        proc_attrs_clear(&p->attr, p->pid);
+    }
+    proc_handle_close(&h);
+}
+
+static void print_io(const ProcIo *rows, size_t n, const ProcAttrs *attrs) {
+    /* === OUTPUT – replace this block with your DB insert === */
+    printf("[\n");
+    for (size_t i = 0; i < n; i++) {
+        const ProcIo *p = &rows[i];
+        proc_attrs_row_sep(attrs, i ? &rows[i-1].attr : NULL, &p->attr);
+        printf("{\"pid\":%d,\"comm\":\"%s\",\"rchar\":%llu,\"wchar\":%llu,\"syscr\":%llu,\"syscw\":%llu,"
+               "\"read_bytes\":%llu,\"write_bytes\":%llu,\"cancelled_write_bytes\":%llu",
+               p->pid, p->comm, p->rchar, p->wchar, p->syscr, p->syscw,
+               p->read_bytes, p->write_bytes, p->cancelled_write_bytes);
+        if (p->has_rate) {
+            printf(",\"rchar_bps\":%.1f,\"wchar_bps\":%.1f,\"read_iops\":%.1f,\"write_iops\":%.1f,"
+                   "\"read_bps\":%.1f,\"write_bps\":%.1f,\"cancelled_write_bps\":%.1f",
+                   p->rchar_bps, p->wchar_bps, p->read_iops, p->write_iops,
+                   p->read_bps, p->write_bps, p->cancelled_write_bps);
+        }
+        proc_attrs_print(attrs, &p->attr);
+        printf("}");
+    }
+    proc_attrs_end(attrs, n > 0);
+    printf("]\n");
+    fflush(stdout);
+}
+
+/*
+   Order for output: by PID, or top N by opts->by; with --group-by the printed rows are then grouped.
+   Attributes are read here, only for the rows that survive the rate filter and the --top cut.
+*/
+static void emit(const ProcIo *procs, size_t count, const IoScanOptions *opts, ProcAttrs *attrs) {
+    /* Work on a copy so procs[] stays pid-sorted as the next round's baseline; rate mode drops processes seen only once */
+    ProcIo *rows = malloc((count ? count : 1) * sizeof(ProcIo));
+    if (!rows) {
+        printf("[]\n");
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (opts->interval_ms > 0 && !procs[i].has_rate) continue;
+        rows[n++] = procs[i];
+    }
+    if (opts->top > 0) {
+        sort_key = opts->by;
+        qsort(rows, n, sizeof(ProcIo), io_value_cmp);
+        if (n > opts->top) n = opts->top;
+    }
+
+    if (proc_attrs_enabled(attrs)) {
+        for (size_t i = 0; i < n; i++) read_row_attrs(attrs, &rows[i]);
+    }
+    if (opts->top > 0) {
+        proc_attrs_sort_ranked(attrs, rows, n, sizeof(ProcIo), offsetof(ProcIo, attr));
+    } else {
+        proc_attrs_sort(attrs, rows, n, sizeof(ProcIo), offsetof(ProcIo, attr));
+    }
+    print_io(rows, n, attrs);
+    free(rows);
+}
+
+static void sleep_ms(unsigned ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/*
+   Scanner: Per-process I/O accounting from /proc/<pid>/io
+   rchar/wchar: bytes through read/write-like syscalls (includes page cache hits)
+   syscr/syscw: number of read/write syscalls
+   read_bytes/write_bytes: bytes that actually hit the storage layer
+   cancelled_write_bytes: dirty page-cache bytes truncated before writeback
+   One /proc enumeration per sample via ProcIter (scanner_proc_handle.h).
+   With opts->interval_ms a second sample is taken and per-second rates are added
+   (processes seen in both samples only; PID reuse is detected via starttime).
+   With opts->resident sampling continues, each interval compared with the previous one.
+   With opts->top only the top N processes by opts->by are printed, highest first.
+   opts->scope limits the walk to cgroup members and/or --filter matches.
+   attrs adds namespace/cgroup/container columns or grouping (scanner_proc_attrs.h); they
+   are read only for the rows that get printed (after --top), not for the rate baseline.
+   Note: reading another user's io file requires root (ptrace access).
+   Output: JSON array → replace with DB insert
+*/
+void scan_process_io(const IoScanOptions *opts, ProcAttrs *attrs)
+{
+    size_t prev_count = 0;
+    ProcIo *prev = take_io_sample(&opts->scope, &prev_count);
+    unsigned long long prev_ms = now_ms();
+
+    if (opts->interval_ms == 0) {
+        emit(prev, prev_count, opts, attrs);
+        free(prev);
+        return;
+    }
+
+    for (unsigned printed = 0; ; ) {
+        sleep_ms(opts->interval_ms);
+
+        size_t cur_count = 0;
+        ProcIo *cur = take_io_sample(&opts->scope, &cur_count);
+        unsigned long long cur_ms = now_ms();
+
+        double secs = (double)(cur_ms - prev_ms) / 1000.0;
+        if (secs <= 0) secs = opts->interval_ms / 1000.0;
+        compute_io_rates(cur, cur_count, prev, prev_count, secs);
+        emit(cur, cur_count, opts, attrs);
+
+        free(prev);
+        prev = cur;
+        prev_count = cur_count;
+        prev_ms = cur_ms;
+
+        if (!opts->resident) break;
+        if (opts->count && ++printed >= opts->count) break;
+    }
+    free(prev);
+}
+
+int main(int argc, char **argv)
+{
+    IoScanOptions opts = { .interval_ms = 0, .resident = false, .count = 0, .top = 0, .by = IO_BY_TOTAL_BPS,
+                           .scope = { 0 } };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    bool bad_args = false;
+
+    for (int i = 1; i < argc && !bad_args; i++) {
+        if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            opts.interval_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--resident") == 0) {
+            opts.resident = true;
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            opts.count = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            opts.top = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            bad_args = true;
+            for (size_t k = 0; k < sizeof(io_sort_names) / sizeof(io_sort_names[0]); k++) {
+                if (strcmp(name, io_sort_names[k]) == 0) {
+                    opts.by = (IoSortKey)k;
+                    bad_args = false;
+                }
+            }
+        } else {
+            bad_args = true;
+        }
+    }
+    if (opts.resident && opts.interval_ms == 0) opts.interval_ms = 10000;
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                      # Cumulative I/O counters per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --interval <ms>      # Two samples, add per-second byte and IOPS rates\n", argv[0]);
+        fprintf(stderr, "  %s --resident [--interval <ms>] [--count <n>]\n", argv[0]);
+        fprintf(stderr, "      # Keep sampling, one JSON array per interval (default 10000 ms, forever)\n");
+        fprintf(stderr, "  ... [--top <n>] [--by total_bps|read_bps|write_bps|iops|read_iops|write_iops|char_bps]\n");
+        fprintf(stderr, "      # Only the top N processes, highest first (default by total_bps)\n");
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    scan_process_io(&opts, &attrs);
+    proc_scope_free(&opts.scope);
+    proc_attrs_free(&attrs);
+    return 0;
+}
@@ -1,10 +1,7 @@
 #include <stdio.h>
-#include <dirent.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
-#include <unistd.h>     /* for readlink */
-#include <limits.h>     /* for PATH_MAX */
+#include "scanner_sockowner.h"
 
 /* Tagged struct so 'struct ListeningPort' is defined before use in pid_cmp */
 typedef struct ListeningPort {
@@ -23,15 +20,24 @@ static int pid_cmp(const void *a, const void *b) {
     return pa->port - pb->port;
 }
 
+/* Listening socket from /proc/net/tcp, before owner resolution */
+typedef struct {
+    unsigned short port;
+    char  local_ip[32];
+    unsigned long ino;
+} ListenSocket;
+
 /*
    Scanner: Listening TCP ports (with process PID/comm)
    Parses /proc/net/tcp for LISTEN (state 0A) entries, collects inode.
-   Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm.
-   Output: JSON array of {pid, comm, port, local_ip, inode} for each listening socket.
+   Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm
+   (scanner_sockowner.h; with owner_cache only changed fd tables are re-read).
+   Output: JSON array of {pid, comm, port, local_ip, inode} for each listening socket
+   (one row per owning process, e.g. every pre-fork worker sharing the socket).
    Note: Run as root to see all (some /proc/pid/fd restricted).
    Only IPv4 for simplicity; add IPv6 from /proc/net/tcp6 if needed.
 */
-void scan_listening_tcp_ports(void)
+void scan_listening_tcp_ports(const char *owner_cache)
 {
     /* Step 1: Parse /proc/net/tcp for listening sockets + inodes */
     FILE *tcp = fopen("/proc/net/tcp", "re");
@@ -42,9 +48,9 @@ void scan_listening_tcp_ports(void)
     }
 
     char line[1024];
-    char **listen_inodes = NULL;
-    size_t inode_capacity = 0;
-    size_t inode_count = 0;
+    ListenSocket *listen_socks = NULL;
+    size_t sock_capacity = 0;
+    size_t sock_count = 0;
 
     /* Skip header */
     fgets(line, sizeof(line), tcp);
@@ -52,152 +58,86 @@ void scan_listening_tcp_ports(void)
     while (fgets(line, sizeof(line), tcp)) {
         unsigned int local_ip_hex, state_hex;
         unsigned short local_port_hex;
-        char inode_str[32];
+        unsigned long inode;
 
-        if (sscanf(line, "%*d: %8X:%4hX %*8X:%*4X %2X %*s %*s %*s %*s %*s %31s",
-                   &local_ip_hex, &local_port_hex, &state_hex, inode_str) != 4) {
+        if (sscanf(line, "%*d: %8X:%4hX %*8X:%*4X %2X %*s %*s %*s %*s %*s %lu",
+                   &local_ip_hex, &local_port_hex, &state_hex, &inode) != 4) {
             continue;
         }
 
         if (state_hex != 0x0A) continue;  /* not LISTEN */
 
-        /* Grow inode array */
-        if (inode_count >= inode_capacity) {
-            inode_capacity = inode_capacity ? inode_capacity * 2 : 128;
-            char **new_inodes = realloc(listen_inodes, inode_capacity * sizeof(char *));
-            if (!new_inodes) break;
-            listen_inodes = new_inodes;
+        /* Grow socket array */
+        if (sock_count >= sock_capacity) {
+            sock_capacity = sock_capacity ? sock_capacity * 2 : 128;
+            ListenSocket *new_socks = realloc(listen_socks, sock_capacity * sizeof(ListenSocket));
+            if (!new_socks) break;
+            listen_socks = new_socks;
         }
 
-        listen_inodes[inode_count++] = strdup(inode_str);
+        /* Convert IP hex to dotted (IPv4) */
+        ListenSocket *ls = &listen_socks[sock_count++];
+        snprintf(ls->local_ip, sizeof(ls->local_ip), "%d.%d.%d.%d",
+                 local_ip_hex & 0xFF,
+                 (local_ip_hex >> 8) & 0xFF,
+                 (local_ip_hex >> 16) & 0xFF,
+                 (local_ip_hex >> 24) & 0xFF);
+        ls->port = local_port_hex;
+        ls->ino = inode;
     }
     fclose(tcp);
 
-    if (inode_count == 0) {
-        free(listen_inodes);
+    if (sock_count == 0) {
+        free(listen_socks);
         printf("[]\n");
         return;
     }
 
-    /* Step 2: Scan all processes to find who owns each inode */
+    /* Step 2: Find who owns each inode */
+    SockOwnerCache cache;
+    sockowner_cache_init(&cache);
+    if (owner_cache) sockowner_cache_load(&cache, owner_cache);
+
+    unsigned long *wanted = malloc(sock_count * sizeof(unsigned long));
+    if (wanted) {
+        for (size_t i = 0; i < sock_count; i++) wanted[i] = listen_socks[i].ino;
+        sockowner_refresh(&cache, wanted, sock_count);
+        free(wanted);
+    }
+
     ListeningPort *ports = NULL;
     size_t port_capacity = 0;
     size_t port_count = 0;
 
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
-        for (size_t i = 0; i < inode_count; i++) free(listen_inodes[i]);
-        free(listen_inodes);
-        printf("[]\n");
-        return;
-    }
-
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
+    for (size_t k = 0; k < sock_count; k++) {
+        SockOwner owner;
+        int last_pid = 0;
+        if (!sockowner_first(&cache, listen_socks[k].ino, &owner)) continue;
+        do {
+            if (owner.pid == last_pid) continue;  /* dup()'d fd in the same process */
+            last_pid = owner.pid;
+
+            /* Grow ports array */
+            if (port_count >= port_capacity) {
+                port_capacity = port_capacity ? port_capacity * 2 : 256;
+                ListeningPort *new_ports = realloc(ports, port_capacity * sizeof(ListeningPort));
+                if (!new_ports) break;
+                ports = new_ports;
             }
-            fclose(fc);
-        }
 
-        /* Scan /proc/pid/fd for socket:[inode] */
-        char fd_path[64];
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
-        DIR *fddir = opendir(fd_path);
-        if (!fddir) continue;
-
-        struct dirent *fdent;
-        while ((fdent = readdir(fddir)) != NULL) {
-            if (!isdigit((unsigned char)fdent->d_name[0])) continue;
-
-            char link_path[128];
-            /* --- FIX: bound the fdent->d_name write to avoid truncation warning --- */
-            size_t fd_path_len = strlen(fd_path);
-            int max_name_len = (int)sizeof(link_path) - (int)fd_path_len - 2;
-            if (max_name_len < 0) max_name_len = 0;
-            snprintf(link_path, sizeof(link_path), "%s/%.*s", fd_path, max_name_len, fdent->d_name);
-
-            char target[PATH_MAX + 1];
-            ssize_t tlen = readlink(link_path, target, PATH_MAX);
-            if (tlen < 0) continue;
-            target[tlen] = '\0';
-
-            /* Check if socket:[inode] */
-            char inode_str[32];
-            if (sscanf(target, "socket:[%31[^]]", inode_str) != 1) continue;
-
-            /* Match against listening inodes */
-            for (size_t k = 0; k < inode_count; k++) {
-                if (strcmp(inode_str, listen_inodes[k]) == 0) {
-                    /* Found match – now get IP/port from /proc/net/tcp (re-parse for this inode) */
-                    FILE *tcp2 = fopen("/proc/net/tcp", "re");
-                    if (!tcp2) continue;
-
-                    fgets(line, sizeof(line), tcp2);  /* skip header */
-
-                    while (fgets(line, sizeof(line), tcp2)) {
-                        unsigned int local_ip_hex, state_hex;
-                        unsigned short local_port_hex;
-                        char match_inode[32];
-
-                        if (sscanf(line, "%*d: %8X:%4hX %*8X:%*4X %2X %*s %*s %*s %*s %*s %31s",
-                                   &local_ip_hex, &local_port_hex, &state_hex, match_inode) != 4) continue;
-
-                        if (state_hex != 0x0A || strcmp(match_inode, inode_str) != 0) continue;
-
-                        /* Convert IP hex to dotted (IPv4) */
-                        char local_ip[32];
-                        snprintf(local_ip, sizeof(local_ip), "%d.%d.%d.%d",
-                                 local_ip_hex & 0xFF,
-                                 (local_ip_hex >> 8) & 0xFF,
-                                 (local_ip_hex >> 16) & 0xFF,
-                                 (local_ip_hex >> 24) & 0xFF);
-
-                        /* Grow ports array */
-                        if (port_count >= port_capacity) {
-                            port_capacity = port_capacity ? port_capacity * 2 : 256;
-                            ListeningPort *new_ports = realloc(ports, port_capacity * sizeof(ListeningPort));
-                            if (!new_ports) break;
-                            ports = new_ports;
-                        }
-
-                        ports[port_count].pid = pid;
-                        strncpy(ports[port_count].comm, comm, sizeof(ports[port_count].comm) - 1);
-                        ports[port_count].comm[sizeof(ports[port_count].comm) - 1] = '\0';
-                        ports[port_count].port = local_port_hex;
-                        strncpy(ports[port_count].local_ip, local_ip, sizeof(ports[port_count].local_ip) - 1);
-                        ports[port_count].local_ip[sizeof(ports[port_count].local_ip) - 1] = '\0';
-                        strncpy(ports[port_count].inode, inode_str, sizeof(ports[port_count].inode) - 1);
-                        ports[port_count].inode[sizeof(ports[port_count].inode) - 1] = '\0';
-
-                        port_count++;
-                        break;  /* found this inode */
-                    }
-                    fclose(tcp2);
-                    break;  /* move to next FD */
-                }
-            }
-        }
-        closedir(fddir);
-    }
+            ports[port_count].pid = owner.pid;
+            snprintf(ports[port_count].comm, sizeof(ports[port_count].comm), "%s", owner.comm);
+            ports[port_count].port = listen_socks[k].port;
+            snprintf(ports[port_count].local_ip, sizeof(ports[port_count].local_ip), "%s", listen_socks[k].local_ip);
+            snprintf(ports[port_count].inode, sizeof(ports[port_count].inode), "%lu", listen_socks[k].ino);
 
-    closedir(proc);
+            port_count++;
+        } while (sockowner_next(&cache, &owner));
+    }
 
-    for (size_t i = 0; i < inode_count; i++) free(listen_inodes[i]);
-    free(listen_inodes);
+    if (owner_cache) sockowner_cache_save(&cache, owner_cache);
+    sockowner_cache_free(&cache);
+    free(listen_socks);
 
     if (port_count == 0) {
         free(ports);
@@ -222,8 +162,19 @@ void scan_listening_tcp_ports(void)
     free(ports);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_listening_tcp_ports();
+    const char *owner_cache = NULL;
+
+    if (argc == 3 && strcmp(argv[1], "--owner-cache") == 0) {
+        owner_cache = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                       # Listening TCP ports → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --owner-cache <file>  # Reuse socket owners from previous run (incremental fd walk)\n", argv[0]);
+        return 1;
+    }
+
+    scan_listening_tcp_ports(owner_cache);
     return 0;
 }
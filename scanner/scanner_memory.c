@@ -3,6 +3,15 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "scanner_taskstats.h"
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_topn.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
@@ -11,6 +20,7 @@ static int pid_cmp(const void *a, const void *b) {
 
 typedef struct {
     int    pid;
+    unsigned long long starttime; /* stat field 22: smaps_rollup is only read from this instance */
     char   comm[17];          /* short name from /proc/pid/comm */
     unsigned long vmsize;     /* VmSize  - total virtual memory (kB) */
     unsigned long vmrss;      /* VmRSS   - resident set size (physical RAM used, kB) */
@@ -18,19 +28,223 @@ typedef struct {
     unsigned long vmswap;     /* VmSwap  - amount swapped out (kB) */
     unsigned long vmdata;     /* VmData  - size of data + stack (kB) */
     unsigned long vmstk;      /* VmStk   - stack size (kB) */
+    bool   has_delay;         /* delay columns below are filled (--taskstats) */
+    unsigned long long swapin_delay_count;    /* waits for swap-in */
+    unsigned long long swapin_delay_ns;
+    unsigned long long reclaim_delay_count;   /* direct memory reclaim */
+    unsigned long long reclaim_delay_ns;
+    unsigned long long thrashing_delay_count; /* waits on refaulting (thrashing) pages */
+    unsigned long long thrashing_delay_ns;
+    int    pss_state;         /* PSS_* below (--pss) */
+    unsigned long pss;        /* Pss           - proportional share of RSS (kB) */
+    unsigned long pss_anon;   /* Pss_Anon */
+    unsigned long pss_file;   /* Pss_File */
+    unsigned long pss_shmem;  /* Pss_Shmem */
+    unsigned long private_clean; /* Private_Clean */
+    unsigned long private_dirty; /* Private_Dirty (USS = clean + dirty) */
+    unsigned long swap_pss;   /* SwapPss       - proportional share of swap (kB) */
+    ProcAttr attr;            /* --ns / --group-by */
 } ProcMemory;
 
+#define PSS_NONE     0        /* mode off, or smaps_rollup not readable */
+#define PSS_OK       1
+#define PSS_SKIPPED  2        /* cycle budget ran out before this process was read */
+
+/* --by: status field ranked by --top */
+enum { MEM_BY_RSS, MEM_BY_VSZ, MEM_BY_HWM, MEM_BY_SWAP, MEM_BY_DATA };
+static const char *const mem_by_names[] = { "rss", "vsz", "hwm", "swap", "data" };
+
+typedef struct {
+    bool use_taskstats;
+    bool pss;                 /* read /proc/<pid>/smaps_rollup */
+    unsigned int threads;     /* smaps_rollup readers */
+    unsigned int budget_ms;   /* stop starting new reads after this; 0 = no limit */
+    ProcScope scope;          /* --cgroup: only these cgroups' members */
+    size_t top;               /* --top: keep only the N largest by top_by; 0 = all */
+    int top_by;               /* MEM_BY_* */
+} MemScanOptions;
+
+static unsigned long mem_key(const ProcMemory *m, int by) {
+    switch (by) {
+        case MEM_BY_VSZ:  return m->vmsize;
+        case MEM_BY_HWM:  return m->vmhwm;
+        case MEM_BY_SWAP: return m->vmswap;
+        case MEM_BY_DATA: return m->vmdata;
+        default:          return m->vmrss;
+    }
+}
+
+/* Work shared by the smaps_rollup readers */
+typedef struct {
+    ProcMemory *mems;
+    size_t *order;            /* indexes into mems, largest RSS first */
+    size_t count;
+    size_t next;              /* next order[] slot to hand out */
+    pthread_mutex_t lock;
+    struct timespec deadline;
+    bool has_deadline;
+} PssWork;
+
+/*
+   Parse one smaps_rollup into m; false if not readable (kernel thread, permissions,
+   exited). The pool runs after the walk, so the PID may have been reused since: the
+   file is opened under a fresh /proc/<pid> dirfd only if its starttime still matches.
+*/
+static bool read_smaps_rollup(ProcMemory *m) {
+    ProcHandle h;
+    if (!proc_handle_open_dir(&h, m->pid)) return false;
+
+    unsigned long long starttime;
+    int fd = -1;
+    if (proc_handle_read_starttime(h.dirfd, &starttime) && starttime == m->starttime)
+        fd = proc_handle_openat(&h, "smaps_rollup");
+    proc_handle_close(&h);
+    if (fd < 0) return false;
+
+    /* Whole file is ~1 KB: one read() (the page-table walk happens inside it) */
+    char buf[4096];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) return false;
+    buf[len] = '\0';
+
+    bool found = false;
+    for (char *line = buf; line && *line; ) {
+        char *nl = strchr(line, '\n');
+        if (strncmp(line, "Pss:", 4) == 0) {
+            sscanf(line + 4, "%lu", &m->pss);
+            found = true;
+        }
+        else if (strncmp(line, "Pss_Anon:", 9) == 0) {
+            sscanf(line + 9, "%lu", &m->pss_anon);
+        }
+        else if (strncmp(line, "Pss_File:", 9) == 0) {
+            sscanf(line + 9, "%lu", &m->pss_file);
+        }
+        else if (strncmp(line, "Pss_Shmem:", 10) == 0) {
+            sscanf(line + 10, "%lu", &m->pss_shmem);
+        }
+        else if (strncmp(line, "Private_Clean:", 14) == 0) {
+            sscanf(line + 14, "%lu", &m->private_clean);
+        }
+        else if (strncmp(line, "Private_Dirty:", 14) == 0) {
+            sscanf(line + 14, "%lu", &m->private_dirty);
+        }
+        else if (strncmp(line, "SwapPss:", 8) == 0) {
+            sscanf(line + 8, "%lu", &m->swap_pss);
+        }
+        line = nl ? nl + 1 : NULL;
+    }
+    return found;
+}
+
+static bool past_deadline(const PssWork *w) {
+    if (!w->has_deadline) return false;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > w->deadline.tv_sec ||
+           (now.tv_sec == w->deadline.tv_sec && now.tv_nsec >= w->deadline.tv_nsec);
+}
+
+/* Reader thread: take the next process until the list or the budget runs out */
+static void *pss_worker(void *arg) {
+    PssWork *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        size_t slot = w->next < w->count ? w->next++ : w->count;
+        pthread_mutex_unlock(&w->lock);
+        if (slot >= w->count) break;
+
+        ProcMemory *m = &w->mems[w->order[slot]];
+        if (past_deadline(w)) {
+            m->pss_state = PSS_SKIPPED;
+            continue;
+        }
+        m->pss_state = read_smaps_rollup(m) ? PSS_OK : PSS_NONE;
+    }
+    return NULL;
+}
+
+/* Sort work by RSS descending: within a budget the biggest consumers are read first */
+static const ProcMemory *rss_sort_base;
+static int rss_desc_cmp(const void *a, const void *b) {
+    unsigned long ra = rss_sort_base[*(const size_t *)a].vmrss;
+    unsigned long rb = rss_sort_base[*(const size_t *)b].vmrss;
+    return (ra < rb) - (ra > rb);
+}
+
+/* Fill PSS columns for all rows with a pool of reader threads */
+static void collect_pss(ProcMemory *mems, size_t count, const MemScanOptions *opts) {
+    PssWork w = { .mems = mems, .count = count, .next = 0, .has_deadline = opts->budget_ms > 0 };
+    w.order = malloc(count * sizeof(size_t));
+    if (!w.order) return;
+    for (size_t i = 0; i < count; i++) w.order[i] = i;
+    rss_sort_base = mems;
+    qsort(w.order, count, sizeof(size_t), rss_desc_cmp);
+
+    if (w.has_deadline) {
+        clock_gettime(CLOCK_MONOTONIC, &w.deadline);
+        w.deadline.tv_sec += opts->budget_ms / 1000;
+        w.deadline.tv_nsec += (long)(opts->budget_ms % 1000) * 1000000L;
+        if (w.deadline.tv_nsec >= 1000000000L) {
+            w.deadline.tv_sec++;
+            w.deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_init(&w.lock, NULL);
+
+    unsigned int nthreads = opts->threads ? opts->threads : 1;
+    pthread_t *tids = malloc(nthreads * sizeof(pthread_t));
+    unsigned int started = 0;
+    if (tids) {
+        for (; started < nthreads; started++) {
+            if (pthread_create(&tids[started], NULL, pss_worker, &w) != 0) break;
+        }
+    }
+    if (started == 0) pss_worker(&w);   /* no threads: read inline */
+    for (unsigned int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+
+    pthread_mutex_destroy(&w.lock);
+    free(tids);
+    free(w.order);
+}
+
 /*
    Scanner: Memory usage (RSS, VSZ, Swap, HWM, etc.) for all processes
    Reads selected fields from /proc/<pid>/status
    All values in kB (as reported by kernel)
+   With use_taskstats every row also carries the memory-pressure delays of the whole
+   thread group from TASKSTATS (swap-in, direct reclaim, thrashing; counts + ns). The
+   status parse stays: TASKSTATS has no current RSS/VSZ/swap/data/stack, so the query
+   only adds the delays, and it is skipped (columns left out, not 0) when delay
+   accounting is off (kernel.task_delayacct=0).
+   With opts->pss each row also gets Pss/Pss_Anon/Pss_File/Pss_Shmem, USS
+   (Private_Clean + Private_Dirty) and SwapPss from /proc/<pid>/smaps_rollup. Those
+   reads walk page tables, so they run on opts->threads threads, largest RSS first;
+   once opts->budget_ms has passed the remaining rows get "pss_skipped":true.
+   attrs adds namespace/cgroup/container columns or grouping (scanner_proc_attrs.h).
+   With opts->top only the N processes largest by opts->top_by are kept (bounded
+   heap, scanner_topn.h): the attribute, TASKSTATS and smaps_rollup reads are skipped
+   for processes that cannot make the cut, and rows come out largest first.
    Output: JSON array → replace with your DB insert code
 */
-void scan_process_memory(void)
+void scan_process_memory(const MemScanOptions *opts, ProcAttrs *attrs)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    /* With delay accounting off every delay reads 0: skip the per-process query, leave the columns out */
+    bool use_taskstats = opts->use_taskstats && taskstats_delayacct_enabled();
+    if (opts->use_taskstats && !use_taskstats) {
+        fprintf(stderr, "kernel.task_delayacct=0: delay columns omitted (sysctl -w kernel.task_delayacct=1)\n");
+    }
+    TaskstatsConn ts_conn = { .fd = -1 };
+    if (use_taskstats && taskstats_open(&ts_conn) < 0) {
+        printf("[]\n");
+        return;
+    }
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, &opts->scope)) {
+        taskstats_close(&ts_conn);
         return;
     }
 
@@ -38,22 +252,26 @@ void scan_process_memory(void)
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        char path[64];
-        snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    TopN top;
+    if (!topn_init(&top, opts->top, sizeof(ProcMemory))) {
+        proc_iter_close(&it);
+        taskstats_close(&ts_conn);
+        printf("[]\n");
+        return;
+    }
 
-        FILE *fp = fopen(path, "re");
-        if (!fp) continue;
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        int pid = h.pid;
+        FILE *fp = proc_handle_fopen(&h, "status");
+        if (!fp) {
+            proc_handle_close(&h);
+            continue;
+        }
 
-        ProcMemory info = { .pid = pid, .vmsize = 0, .vmrss = 0, .vmhwm = 0,
-                            .vmswap = 0, .vmdata = 0, .vmstk = 0 };
+        ProcMemory info = { .pid = pid, .starttime = h.starttime, .vmsize = 0, .vmrss = 0, .vmhwm = 0,
+                            .vmswap = 0, .vmdata = 0, .vmstk = 0, .has_delay = false,
+                            .pss_state = PSS_NONE };
 
         char line[256];
         int comm_read = 0;
@@ -85,7 +303,31 @@ void scan_process_memory(void)
         fclose(fp);
 
         /* Require at least the core ones to be present */
-        if (info.vmsize == 0 && info.vmrss == 0) continue;
+        unsigned long key = mem_key(&info, opts->top_by);
+        if ((info.vmsize == 0 && info.vmrss == 0) || !topn_would_enter(&top, (double)key)) {
+            proc_handle_close(&h);
+            continue;
+        }
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, pid, &info.attr);
+
+        /* TASKSTATS is keyed by PID: only trust the answer if h is still alive after it */
+        TaskstatsRecord rec;
+        if (use_taskstats && taskstats_query(&ts_conn, pid, true, &rec) == 0 &&
+            proc_handle_alive(&h)) {
+            info.has_delay = true;
+            info.swapin_delay_count = rec.swapin_delay_count;
+            info.swapin_delay_ns = rec.swapin_delay_ns;
+            info.reclaim_delay_count = rec.reclaim_delay_count;
+            info.reclaim_delay_ns = rec.reclaim_delay_ns;
+            info.thrashing_delay_count = rec.thrashing_delay_count;
+            info.thrashing_delay_ns = rec.thrashing_delay_ns;
+        }
+        proc_handle_close(&h);
+
+        if (topn_enabled(&top)) {
+            topn_push(&top, (double)key, &info, NULL);
+            continue;
+        }
 
         /* Grow array */
         if (count >= capacity) {
@@ -98,7 +340,9 @@ void scan_process_memory(void)
         mems[count++] = info;
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
+    taskstats_close(&ts_conn);
+    if (topn_enabled(&top)) mems = topn_finish(&top, &count);
 
     if (count == 0) {
         free(mems);
@@ -106,22 +350,47 @@ void scan_process_memory(void)
         return;
     }
 
-    /* Sort by PID for consistent output */
-    qsort(mems, count, sizeof(ProcMemory), pid_cmp);
+    if (opts->pss) collect_pss(mems, count, opts);
+
+    /* Sort by PID for consistent output (--top: already largest first) */
+    if (!opts->top) {
+        qsort(mems, count, sizeof(ProcMemory), pid_cmp);
+        proc_attrs_sort(attrs, mems, count, sizeof(ProcMemory), offsetof(ProcMemory, attr));
+    } else {
+        proc_attrs_sort_ranked(attrs, mems, count, sizeof(ProcMemory), offsetof(ProcMemory, attr));
+    }
 
     /* === OUTPUT – replace this block with your database insert === */
     printf("[\n");
     for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\","
+        proc_attrs_row_sep(attrs, i ? &mems[i-1].attr : NULL, &mems[i].attr);
+        printf("{\"pid\":%d,\"comm\":\"%s\","
                "\"vmsize_kb\":%lu,\"vmrss_kb\":%lu,\"vmhwm_kb\":%lu,"
-               "\"vmswap_kb\":%lu,\"vmdata_kb\":%lu,\"vmstk_kb\":%lu}",
+               "\"vmswap_kb\":%lu,\"vmdata_kb\":%lu,\"vmstk_kb\":%lu",
                mems[i].pid, mems[i].comm,
                mems[i].vmsize, mems[i].vmrss, mems[i].vmhwm,
                mems[i].vmswap, mems[i].vmdata, mems[i].vmstk);
-
-        if (i < count - 1) printf(",");
-        printf("\n");
+        if (mems[i].has_delay) {
+            printf(",\"swapin_delay_count\":%llu,\"swapin_delay_ns\":%llu,"
+                   "\"reclaim_delay_count\":%llu,\"reclaim_delay_ns\":%llu,"
+                   "\"thrashing_delay_count\":%llu,\"thrashing_delay_ns\":%llu",
+                   mems[i].swapin_delay_count, mems[i].swapin_delay_ns,
+                   mems[i].reclaim_delay_count, mems[i].reclaim_delay_ns,
+                   mems[i].thrashing_delay_count, mems[i].thrashing_delay_ns);
+        }
+        if (mems[i].pss_state == PSS_OK) {
+            printf(",\"pss_kb\":%lu,\"pss_anon_kb\":%lu,\"pss_file_kb\":%lu,\"pss_shmem_kb\":%lu,"
+                   "\"private_clean_kb\":%lu,\"private_dirty_kb\":%lu,\"uss_kb\":%lu,\"swap_pss_kb\":%lu",
+                   mems[i].pss, mems[i].pss_anon, mems[i].pss_file, mems[i].pss_shmem,
+                   mems[i].private_clean, mems[i].private_dirty,
+                   mems[i].private_clean + mems[i].private_dirty, mems[i].swap_pss);
+        } else if (mems[i].pss_state == PSS_SKIPPED) {
+            printf(",\"pss_skipped\":true");
+        }
+        proc_attrs_print(attrs, &mems[i].attr);
+        printf("}");
     }
+    proc_attrs_end(attrs, count > 0);
     printf("]\n");
 
     /* Example DB-style replacement:
@@ -135,8 +404,58 @@ void scan_process_memory(void)
     free(mems);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_process_memory();
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    MemScanOptions opts = { .use_taskstats = false, .pss = false,
+                            .threads = ncpu > 0 ? (unsigned int)(ncpu < 8 ? ncpu : 8) : 1,
+                            .budget_ms = 5000, .scope = { 0 }, .top = 0, .top_by = MEM_BY_RSS };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--taskstats") == 0) {
+            opts.use_taskstats = true;
+        } else if (strcmp(argv[i], "--pss") == 0) {
+            opts.pss = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts.threads = (unsigned int)strtoul(argv[++i], NULL, 10);
+            if (opts.threads == 0) bad_args = true;
+        } else if (strcmp(argv[i], "--budget-ms") == 0 && i + 1 < argc) {
+            opts.budget_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            opts.top = strtoul(argv[++i], NULL, 10);
+            if (opts.top == 0) bad_args = true;
+        } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+            opts.top_by = topn_field(argv[++i], mem_by_names, sizeof(mem_by_names) / sizeof(mem_by_names[0]));
+            if (opts.top_by < 0) bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s              # Memory usage per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --taskstats  # + swap-in/reclaim/thrashing delays (TASKSTATS, root, kernel.task_delayacct=1)\n", argv[0]);
+        fprintf(stderr, "  %s --pss [--threads <n>] [--budget-ms <ms>]\n", argv[0]);
+        fprintf(stderr, "      # + PSS/USS/SwapPss from smaps_rollup (default: min(cpus,8) threads, 5000 ms, 0 = no limit)\n");
+        fprintf(stderr, "  ... --top <n> [--by rss|vsz|hwm|swap|data]\n");
+        fprintf(stderr, "      # Only the n largest processes (default by rss), largest first; other reads skipped for the rest\n");
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    scan_process_memory(&opts, &attrs);
+    proc_scope_free(&opts.scope);
+    proc_attrs_free(&attrs);
     return 0;
 }
@@ -8,8 +8,8 @@
 #include <limits.h>
 #include <time.h>
 #include <stdbool.h>
-#include <openssl/evp.h>   /* use EVP API */
-#include <openssl/sha.h>   /* for digest length constant */
+#include "scanner_names.h"
+#include "scanner_sha256.h"
 
 /* Tagged struct so 'struct SnapshotEntry' exists for path_cmp */
 typedef struct SnapshotEntry {
@@ -31,47 +31,9 @@ static int path_cmp(const void *a, const void *b) {
                   ((const SnapshotEntry *)b)->path);
 }
 
-/* Compute SHA-256 only for regular files using EVP (non-deprecated) */
+/* SHA-256 of a regular file (scanner_sha256.h); empty string if unreadable */
 static void compute_sha256(const char *path, char *digest) {
-    digest[0] = '\0';
-    FILE *fp = fopen(path, "rb");
-    if (!fp) return;
-
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx) { fclose(fp); return; }
-
-    if (EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        fclose(fp);
-        return;
-    }
-
-    unsigned char buf[8192];
-    size_t len;
-    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
-        if (EVP_DigestUpdate(mdctx, buf, len) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            fclose(fp);
-            return;
-        }
-    }
-
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashlen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashlen) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        fclose(fp);
-        return;
-    }
-
-    EVP_MD_CTX_free(mdctx);
-    fclose(fp);
-
-    /* Convert to hex (only first SHA256_DIGEST_LENGTH bytes) */
-    for (unsigned int i = 0; i < hashlen && i < SHA256_DIGEST_LENGTH; ++i) {
-        sprintf(digest + i * 2, "%02x", hash[i]);
-    }
-    digest[64] = '\0';
+    if (sha256_file(path, digest) != 0) digest[0] = '\0';
 }
 
 /* Human-readable type */
@@ -205,8 +167,8 @@ static bool is_modified(const SnapshotEntry *old, const SnapshotEntry *cur) {
     return false;
 }
 
-/* Print one JSON object (same format as newfiles_scanner) */
-static void print_json_object(const SnapshotEntry *e) {
+/* Print one JSON object (same format as newfiles_scanner); names may be NULL */
+static void print_json_object(const SnapshotEntry *e, NameCache *names) {
     char mode_str[6];
     snprintf(mode_str, sizeof(mode_str), "%04o", e->mode);
 
@@ -216,24 +178,43 @@ static void print_json_object(const SnapshotEntry *e) {
         putchar(*p);
     }
     printf("\",\"size\":%lld,\"mode\":\"%s\",\"uid\":%u,\"gid\":%u,"
-           "\"mtime\":%ld,\"ctime\":%ld,\"atime\":%ld,\"type\":\"%s\",\"sha256\":\"%s\"}",
+           "\"mtime\":%ld,\"ctime\":%ld,\"atime\":%ld,\"type\":\"%s\",\"sha256\":\"%s\"",
            e->size, mode_str, (unsigned)e->uid, (unsigned)e->gid,
            (long)e->mtime, (long)e->ctime, (long)e->atime, e->type, e->sha256);
+    if (names) {
+        names_print(",\"user\":", names_user(names, e->uid));
+        names_print(",\"group\":", names_group(names, e->gid));
+    }
+    printf("}");
 }
 
 int main(int argc, char **argv)
 {
     bool generate_snapshot = false;
     const char *prev_file = NULL;
+    bool resolve = false;
+    const char *names_cache = NULL;
+    int args = argc;
+
+    if (args == 3 && strcmp(argv[2], "--names") == 0) {
+        resolve = true;
+        args = 2;
+    } else if (args == 4 && strcmp(argv[2], "--names-cache") == 0) {
+        resolve = true;
+        names_cache = argv[3];
+        args = 2;
+    }
 
-    if (argc == 2 && strcmp(argv[1], "--snapshot") == 0) {
+    if (args == 2 && strcmp(argv[1], "--snapshot") == 0 && !resolve) {
         generate_snapshot = true;
-    } else if (argc == 2) {
+    } else if (args == 2 && argv[1][0] != '-') {
         prev_file = argv[1];
     } else {
         fprintf(stderr, "Usage:\n");
         fprintf(stderr, "  %s --snapshot                  # Generate baseline snapshot (one line per file)\n", argv[0]);
         fprintf(stderr, "  %s <previous_snapshot.txt>     # Detect modified files → JSON\n", argv[0]);
+        fprintf(stderr, "  %s <previous_snapshot.txt> --names  # + user/group names (/etc/passwd, /etc/group, then NSS)\n", argv[0]);
+        fprintf(stderr, "  %s <previous_snapshot.txt> --names-cache <file>  # --names, reusing NSS answers from previous runs\n", argv[0]);
         fprintf(stderr, "\nWorkflow:\n");
         fprintf(stderr, "  sudo %s --snapshot > snapshot.txt\n", argv[0]);
         fprintf(stderr, "  ... time passes ...\n");
@@ -279,6 +260,11 @@ int main(int argc, char **argv)
     }
     qsort(prev, prev_count, sizeof(SnapshotEntry), path_cmp);
 
+    NameCache names;
+    names_init(&names);
+    if (resolve) names_refresh(&names);
+    if (names_cache) names_cache_load(&names, names_cache);
+
     printf("[\n");
     size_t modified_count = 0;
     size_t i = 0, j = 0;
@@ -293,7 +279,7 @@ int main(int argc, char **argv)
             /* same path - check for modification */
             if (is_modified(&prev[i], &current[j])) {
                 if (modified_count > 0) printf(",\n");
-                print_json_object(&current[j]);
+                print_json_object(&current[j], resolve ? &names : NULL);
                 modified_count++;
             }
             i++;
@@ -307,6 +293,8 @@ int main(int argc, char **argv)
     printf("#   sudo %s --snapshot > new_snapshot.txt\n", argv[0]);
     printf("#   mv new_snapshot.txt %s\n", prev_file);
 
+    if (names_cache) names_cache_save(&names, names_cache);
+    names_free(&names);
     free(prev);
     free(current);
     return 0;
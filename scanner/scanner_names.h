@@ -0,0 +1,345 @@
+/*
+   scanner_names.h - cached uid/gid → user/group name resolution
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_creds.c -o scanner_creds
+
+   /etc/passwd and /etc/group are mmap'd and parsed once into an id → name hash
+   table (names copied into one arena, the mapping is dropped right away).
+   Ids not in the files (sssd, LDAP, ...) go through getpwuid_r/getgrgid_r once;
+   the answer is cached, including "no such id", so a row costs a hash lookup
+   instead of an NSS round trip.
+
+   Every scanner run is a new process, so the NSS answers are carried from one run
+   to the next in a cache file (--names-cache <file>): names_cache_load() takes them
+   back only if passwd/group still have the mtime, size and inode recorded with them,
+   and for at most NAMES_NSS_TTL seconds, so a user added in LDAP shows up within the
+   TTL. An unknown id then costs one NSS round trip per TTL instead of one per cycle.
+
+       NameCache names;
+       names_init(&names);
+       names_refresh(&names);                 stat + parse passwd/group
+       names_cache_load(&names, file);        optional: previous runs' NSS answers
+       names_user(&names, uid)                "root", or NULL if unknown
+       names_group(&names, gid)
+       names_print(",\"user\":", name)        JSON string or null
+       names_cache_save(&names, file);        temp file + rename
+       names_free(&names);
+
+   Cache file (text), per table:
+       T <user|group> <loaded> <mtime sec> <mtime nsec> <size> <inode> <nss since>
+       A <id> <name>                          NSS answer
+       A <id> -                               NSS: no such id
+*/
+#ifndef SCANNER_NAMES_H
+#define SCANNER_NAMES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NAMES_NSS_TTL 3600    /* seconds a cached NSS answer (or "no such id") is reused */
+
+typedef struct {
+    unsigned id;
+    int      name;            /* arena offset, -1 = id does not exist */
+    bool     used;
+    bool     nss;             /* from getpwuid_r/getgrgid_r, not the file (persisted) */
+} NameSlot;
+
+/* One file (passwd or group) plus the NSS answers for ids it lacks */
+typedef struct {
+    const char *file;
+    bool        group;
+    bool        loaded;
+    struct timespec mtime;    /* file identity at last load */
+    off_t       size;
+    ino_t       ino;
+    long long   nss_since;    /* unix time the oldest NSS answer was taken */
+    NameSlot   *slots;        /* open addressing, power-of-two size */
+    size_t      slot_mask;
+    size_t      count;
+    char       *arena;        /* NUL-terminated names */
+    size_t      arena_len;
+    size_t      arena_cap;
+} NameTable;
+
+typedef struct {
+    NameTable users;
+    NameTable groups;
+} NameCache;
+
+static inline void name_table_clear(NameTable *t) {
+    free(t->slots);
+    free(t->arena);
+    t->slots = NULL;
+    t->slot_mask = 0;
+    t->count = 0;
+    t->arena = NULL;
+    t->arena_len = t->arena_cap = 0;
+    t->nss_since = 0;
+}
+
+static inline NameSlot *name_table_slot(const NameTable *t, unsigned id) {
+    if (!t->slots) return NULL;
+    size_t i = (id * 2654435761u) & t->slot_mask;
+    while (t->slots[i].used && t->slots[i].id != id) i = (i + 1) & t->slot_mask;
+    return &t->slots[i];
+}
+
+static inline bool name_table_grow(NameTable *t) {
+    size_t cap = t->slots ? (t->slot_mask + 1) * 2 : 256;
+    NameSlot *old = t->slots;
+    size_t old_cap = old ? t->slot_mask + 1 : 0;
+
+    t->slots = calloc(cap, sizeof(NameSlot));
+    if (!t->slots) {
+        t->slots = old;
+        return false;
+    }
+    t->slot_mask = cap - 1;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].used) *name_table_slot(t, old[i].id) = old[i];
+    }
+    free(old);
+    return true;
+}
+
+/* Add id → name (len bytes; name NULL = negative entry). The first entry for an id wins, like getpwuid */
+static inline void name_table_add(NameTable *t, unsigned id, const char *name, size_t len, bool nss) {
+    if ((t->count + 1) * 2 > (t->slots ? t->slot_mask + 1 : 0) && !name_table_grow(t)) return;
+    NameSlot *s = name_table_slot(t, id);
+    if (s->used) return;
+
+    int off = -1;
+    if (name) {
+        if (t->arena_len + len + 1 > t->arena_cap) {
+            size_t cap = t->arena_cap ? t->arena_cap * 2 : 4096;
+            while (cap < t->arena_len + len + 1) cap *= 2;
+            char *arena = realloc(t->arena, cap);
+            if (!arena) return;
+            t->arena = arena;
+            t->arena_cap = cap;
+        }
+        memcpy(t->arena + t->arena_len, name, len);
+        t->arena[t->arena_len + len] = '\0';
+        off = (int)t->arena_len;
+        t->arena_len += len + 1;
+    }
+    s->used = true;
+    s->nss = nss;
+    s->id = id;
+    s->name = off;
+    t->count++;
+}
+
+/* Parse "name:passwd:id:..." lines of a mapped passwd/group file */
+static inline void name_table_parse(NameTable *t, const char *data, size_t size) {
+    const char *end = data + size;
+    for (const char *line = data; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+
+        /* '#' comments, '+'/'-' NIS compat entries */
+        if (line < eol && *line != '#' && *line != '+' && *line != '-') {
+            const char *c1 = memchr(line, ':', (size_t)(eol - line));
+            const char *c2 = c1 ? memchr(c1 + 1, ':', (size_t)(eol - c1 - 1)) : NULL;
+            if (c1 && c2 && c2 + 1 < eol && c2[1] >= '0' && c2[1] <= '9') {
+                unsigned long id = 0;
+                const char *p = c2 + 1;
+                while (p < eol && *p >= '0' && *p <= '9') id = id * 10 + (unsigned long)(*p++ - '0');
+                if ((p == eol || *p == ':') && c1 > line) name_table_add(t, (unsigned)id, line, (size_t)(c1 - line), false);
+            }
+        }
+        line = eol + 1;
+    }
+}
+
+/* (Re)load the file if it changed since the last load */
+static inline void name_table_refresh(NameTable *t) {
+    struct stat st;
+    if (stat(t->file, &st) != 0) {
+        if (t->loaded) name_table_clear(t);   /* file gone: keep only NSS answers from now on */
+        t->loaded = false;
+        return;
+    }
+    if (t->loaded && st.st_mtim.tv_sec == t->mtime.tv_sec && st.st_mtim.tv_nsec == t->mtime.tv_nsec &&
+        st.st_size == t->size && st.st_ino == t->ino) {
+        return;
+    }
+
+    name_table_clear(t);
+    t->loaded = true;
+    t->mtime = st.st_mtim;
+    t->size = st.st_size;
+    t->ino = st.st_ino;
+    if (st.st_size == 0) return;
+
+    int fd = open(t->file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+    name_table_parse(t, map, (size_t)st.st_size);
+    munmap(map, (size_t)st.st_size);
+}
+
+/* Ask NSS for an id the file did not have; cache the answer either way */
+static inline const char *name_table_nss(NameTable *t, unsigned id) {
+    long hint = sysconf(t->group ? _SC_GETGR_R_SIZE_MAX : _SC_GETPW_R_SIZE_MAX);
+    size_t buflen = hint > 0 ? (size_t)hint : 16384;
+    char *buf = NULL;
+    const char *found = NULL;
+    struct passwd pw, *pwp = NULL;
+    struct group gr, *grp = NULL;
+
+    for (;;) {
+        char *nbuf = realloc(buf, buflen);
+        if (!nbuf) break;
+        buf = nbuf;
+        int rc = t->group ? getgrgid_r((gid_t)id, &gr, buf, buflen, &grp)
+                          : getpwuid_r((uid_t)id, &pw, buf, buflen, &pwp);
+        if (rc == ERANGE && buflen < (1u << 20)) {
+            buflen *= 2;
+            continue;
+        }
+        if (rc == 0) found = t->group ? (grp ? grp->gr_name : NULL) : (pwp ? pwp->pw_name : NULL);
+        break;
+    }
+    if (t->nss_since == 0) t->nss_since = (long long)time(NULL);
+    name_table_add(t, id, found, found ? strlen(found) : 0, true);
+    free(buf);
+
+    NameSlot *s = name_table_slot(t, id);
+    return s && s->used && s->name >= 0 ? t->arena + s->name : NULL;
+}
+
+static inline const char *name_table_lookup(NameTable *t, unsigned id) {
+    NameSlot *s = name_table_slot(t, id);
+    if (s && s->used) return s->name >= 0 ? t->arena + s->name : NULL;
+    return name_table_nss(t, id);
+}
+
+static inline void names_init(NameCache *c) {
+    memset(c, 0, sizeof(*c));
+    c->users.file = "/etc/passwd";
+    c->groups.file = "/etc/group";
+    c->groups.group = true;
+}
+
+static inline void names_free(NameCache *c) {
+    name_table_clear(&c->users);
+    name_table_clear(&c->groups);
+}
+
+/* Once per cycle: rebuild a table only if its file changed */
+static inline void names_refresh(NameCache *c) {
+    name_table_refresh(&c->users);
+    name_table_refresh(&c->groups);
+}
+
+/*
+   Take back the NSS answers a previous run saved, for each table whose file still
+   has the recorded identity and whose answers are younger than NAMES_NSS_TTL.
+   Call after names_refresh(). A missing or unreadable file just means a cold start.
+*/
+static inline void names_cache_load(NameCache *c, const char *filename) {
+    FILE *f = fopen(filename, "re");
+    if (!f) return;
+
+    long long now = (long long)time(NULL);
+    NameTable *cur = NULL;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char kind[8];
+        int loaded;
+        long long sec, nsec, size, since;
+        unsigned long long ino;
+        unsigned id;
+        int consumed = 0;
+
+        if (sscanf(line, "T %7s %d %lld %lld %lld %llu %lld", kind, &loaded, &sec, &nsec, &size, &ino, &since) == 7) {
+            NameTable *t = strcmp(kind, "group") == 0 ? &c->groups : &c->users;
+            bool same = loaded == (int)t->loaded &&
+                        (!t->loaded || (sec == (long long)t->mtime.tv_sec && nsec == (long long)t->mtime.tv_nsec &&
+                                        size == (long long)t->size && ino == (unsigned long long)t->ino));
+            cur = same && since > 0 && now - since < NAMES_NSS_TTL ? t : NULL;
+            if (cur && (cur->nss_since == 0 || since < cur->nss_since)) cur->nss_since = since;
+        } else if (cur && sscanf(line, "A %u %n", &id, &consumed) == 1 && consumed > 0) {
+            const char *name = line + consumed;
+            if (strcmp(name, "-") == 0) name_table_add(cur, id, NULL, 0, true);
+            else if (*name) name_table_add(cur, id, name, strlen(name), true);
+        }
+    }
+    fclose(f);
+}
+
+static inline void name_table_save(FILE *f, const NameTable *t, const char *kind) {
+    fprintf(f, "T %s %d %lld %lld %lld %llu %lld\n", kind, (int)t->loaded,
+            (long long)t->mtime.tv_sec, (long long)t->mtime.tv_nsec, (long long)t->size,
+            (unsigned long long)t->ino, t->nss_since);
+    if (!t->slots) return;
+    for (size_t i = 0; i <= t->slot_mask; i++) {
+        const NameSlot *s = &t->slots[i];
+        if (!s->used || !s->nss) continue;
+        if (s->name < 0) fprintf(f, "A %u -\n", s->id);
+        else if (!strpbrk(t->arena + s->name, "\n\r")) fprintf(f, "A %u %s\n", s->id, t->arena + s->name);
+    }
+}
+
+/* Write the NSS answers for the next run (via temp file + rename so a crash never leaves half a cache) */
+static inline int names_cache_save(const NameCache *c, const char *filename) {
+    char tmp[PATH_MAX];
+    int needed = snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (needed < 0 || needed >= (int)sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "we");
+    if (!f) {
+        fprintf(stderr, "Cannot write names cache '%s'\n", tmp);
+        return -1;
+    }
+    name_table_save(f, &c->users, "user");
+    name_table_save(f, &c->groups, "group");
+    if (fclose(f) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return rename(tmp, filename);
+}
+
+/* Name for an id, NULL if it does not resolve. Valid until the next names_refresh() */
+static inline const char *names_user(NameCache *c, uid_t uid) {
+    return name_table_lookup(&c->users, (unsigned)uid);
+}
+
+static inline const char *names_group(NameCache *c, gid_t gid) {
+    return name_table_lookup(&c->groups, (unsigned)gid);
+}
+
+/* prefix (e.g. ",\"user\":") followed by the JSON string, or null */
+static inline void names_print(const char *prefix, const char *name) {
+    fputs(prefix, stdout);
+    if (!name) {
+        fputs("null", stdout);
+        return;
+    }
+    putchar('"');
+    for (const char *p = name; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+#endif /* SCANNER_NAMES_H */
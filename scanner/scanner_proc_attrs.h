@@ -0,0 +1,373 @@
+/*
+   scanner_proc_attrs.h - namespace / cgroup / container attribution for per-process rows
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_comm.c -o scanner_comm
+
+   For each process, read once alongside the scanner's own files:
+     - pid/mnt/net/user namespace inodes (readlinkat on ns/<name>, "net:[4026531840]")
+     - cgroup path (the "0::" line of /proc/<pid>/cgroup; first line on v1-only hosts)
+     - container id, taken from the cgroup path (docker-<id>.scope, /docker/<id>,
+       cri-containerd-<id>.scope, crio-<id>.scope, libpod-<id>.scope, kubepods .../<id>)
+   Cgroup paths and container ids are interned: each distinct string is stored once
+   per run and rows carry small ids.
+
+   Scanner side:
+       --ns                 add pid_ns, mnt_ns, net_ns, user_ns, cgroup, container columns
+       --group-by <key>     container | cgroup | pid_ns | mnt_ns | net_ns | user_ns
+                            rows are emitted grouped: [{"<key>":..., "processes":[rows]}]
+
+       ProcAttrs attrs;  proc_attrs_init(&attrs);
+       ... if (proc_attrs_arg(&attrs, argc, argv, &i)) continue; ...
+       per process:  if (proc_attrs_enabled(&attrs)) proc_attrs_read_at(&attrs, h.dirfd, h.pid, &row.attr);
+       output:       proc_attrs_sort(&attrs, rows, n, sizeof(*rows), offsetof(Row, attr));
+                     (proc_attrs_sort_ranked() instead when rows are already ranked, e.g. --top)
+                     printf("[\n");
+                     for each row: proc_attrs_row_sep(&attrs, prev or NULL, &row.attr);
+                                   printf("{...row...");  proc_attrs_print(&attrs, &row.attr);  printf("}");
+                     proc_attrs_end(&attrs, n > 0);
+                     printf("]\n");
+*/
+#ifndef SCANNER_PROC_ATTRS_H
+#define SCANNER_PROC_ATTRS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>     /* offsetof, for proc_attrs_sort callers */
+#include <ctype.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef enum {
+    PROC_GROUP_NONE = 0,
+    PROC_GROUP_CONTAINER,
+    PROC_GROUP_CGROUP,
+    PROC_GROUP_PID_NS,
+    PROC_GROUP_MNT_NS,
+    PROC_GROUP_NET_NS,
+    PROC_GROUP_USER_NS
+} ProcGroupKey;
+
+static const char *proc_group_names[] = {
+    "", "container", "cgroup", "pid_ns", "mnt_ns", "net_ns", "user_ns"
+};
+
+typedef struct {
+    int   pid;                     /* tie-break inside a group */
+    size_t rank;                   /* incoming position, tie-break for proc_attrs_sort_ranked */
+    bool  read;
+    unsigned long long pid_ns;     /* namespace inodes, 0 = unknown */
+    unsigned long long mnt_ns;
+    unsigned long long net_ns;
+    unsigned long long user_ns;
+    int   cgroup;                  /* interned string id, -1 = unknown */
+    int   container;               /* interned string id, -1 = not in a container */
+} ProcAttr;
+
+typedef struct {
+    bool         columns;          /* --ns */
+    ProcGroupKey group_by;         /* --group-by */
+    char        *arena;            /* interned strings, NUL-terminated */
+    size_t       arena_len;
+    size_t       arena_cap;
+    size_t      *offsets;          /* id → arena offset */
+    size_t       count;
+    size_t       capacity;
+    int         *slots;            /* hash slot → id + 1 (0 = empty) */
+    size_t       slot_mask;
+} ProcAttrs;
+
+static inline void proc_attrs_init(ProcAttrs *a) {
+    memset(a, 0, sizeof(*a));
+}
+
+static inline void proc_attrs_free(ProcAttrs *a) {
+    free(a->arena);
+    free(a->offsets);
+    free(a->slots);
+    memset(a, 0, sizeof(*a));
+}
+
+static inline bool proc_attrs_enabled(const ProcAttrs *a) {
+    return a->columns || a->group_by != PROC_GROUP_NONE;
+}
+
+/* Consume "--ns" or "--group-by <key>" at argv[*i] */
+static inline bool proc_attrs_arg(ProcAttrs *a, int argc, char **argv, int *i) {
+    if (strcmp(argv[*i], "--ns") == 0) {
+        a->columns = true;
+        return true;
+    }
+    if (strcmp(argv[*i], "--group-by") != 0 || *i + 1 >= argc) return false;
+
+    const char *key = argv[*i + 1];
+    for (int k = PROC_GROUP_CONTAINER; k <= PROC_GROUP_USER_NS; k++) {
+        if (strcmp(key, proc_group_names[k]) == 0) {
+            a->group_by = (ProcGroupKey)k;
+            (*i)++;
+            return true;
+        }
+    }
+    return false;   /* unknown key: caller prints usage */
+}
+
+static inline const char *proc_attrs_str(const ProcAttrs *a, int id) {
+    return id >= 0 ? a->arena + a->offsets[id] : NULL;
+}
+
+static inline unsigned long proc_attrs_hash(const char *s, size_t len) {
+    unsigned long h = 1469598103934665603UL;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 1099511628211UL;
+    return h;
+}
+
+static inline bool proc_attrs_grow_slots(ProcAttrs *a) {
+    size_t size = a->slots ? (a->slot_mask + 1) * 2 : 256;
+    int *slots = calloc(size, sizeof(int));
+    if (!slots) return false;
+    for (size_t id = 0; id < a->count; id++) {
+        const char *s = a->arena + a->offsets[id];
+        size_t i = proc_attrs_hash(s, strlen(s)) & (size - 1);
+        while (slots[i]) i = (i + 1) & (size - 1);
+        slots[i] = (int)id + 1;
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->slot_mask = size - 1;
+    return true;
+}
+
+/* Id of s[0..len), stored on first sight; -1 on allocation failure */
+static inline int proc_attrs_intern(ProcAttrs *a, const char *s, size_t len) {
+    if ((a->count + 1) * 2 > (a->slots ? a->slot_mask + 1 : 0) && !proc_attrs_grow_slots(a)) return -1;
+
+    size_t i = proc_attrs_hash(s, len) & a->slot_mask;
+    for (; a->slots[i]; i = (i + 1) & a->slot_mask) {
+        const char *e = a->arena + a->offsets[a->slots[i] - 1];
+        if (strncmp(e, s, len) == 0 && e[len] == '\0') return a->slots[i] - 1;
+    }
+
+    if (a->arena_len + len + 1 > a->arena_cap) {
+        size_t newcap = a->arena_cap ? a->arena_cap * 2 : 16384;
+        while (newcap < a->arena_len + len + 1) newcap *= 2;
+        char *n = realloc(a->arena, newcap);
+        if (!n) return -1;
+        a->arena = n;
+        a->arena_cap = newcap;
+    }
+    if (a->count >= a->capacity) {
+        size_t newcap = a->capacity ? a->capacity * 2 : 256;
+        size_t *n = realloc(a->offsets, newcap * sizeof(size_t));
+        if (!n) return -1;
+        a->offsets = n;
+        a->capacity = newcap;
+    }
+
+    memcpy(a->arena + a->arena_len, s, len);
+    a->arena[a->arena_len + len] = '\0';
+    a->offsets[a->count] = a->arena_len;
+    a->arena_len += len + 1;
+    a->slots[i] = (int)a->count + 1;
+    return (int)a->count++;
+}
+
+/* "net:[4026531840]" → 4026531840; 0 if unreadable */
+static inline unsigned long long proc_attrs_ns(int dirfd, const char *name) {
+    char target[64];
+    ssize_t n = readlinkat(dirfd, name, target, sizeof(target) - 1);
+    if (n <= 0) return 0;
+    target[n] = '\0';
+    const char *p = strchr(target, '[');
+    return p ? strtoull(p + 1, NULL, 10) : 0;
+}
+
+/* Container id from a cgroup path: last segment (from the end) holding >= 12 hex chars */
+static inline bool proc_attrs_container_id(const char *path, size_t len, const char **id, size_t *id_len) {
+    static const char *prefixes[] = { "docker-", "cri-containerd-", "crio-", "libpod-", "containerd-" };
+    size_t end = len;
+
+    while (end > 0) {
+        size_t start = end;
+        while (start > 0 && path[start - 1] != '/') start--;
+
+        const char *seg = path + start;
+        size_t seg_len = end - start;
+        if (seg_len > 6 && memcmp(seg + seg_len - 6, ".scope", 6) == 0) seg_len -= 6;
+        for (size_t k = 0; k < sizeof(prefixes) / sizeof(prefixes[0]); k++) {
+            size_t plen = strlen(prefixes[k]);
+            if (seg_len > plen && memcmp(seg, prefixes[k], plen) == 0) {
+                seg += plen;
+                seg_len -= plen;
+                break;
+            }
+        }
+
+        size_t hex = 0;
+        while (hex < seg_len && isxdigit((unsigned char)seg[hex])) hex++;
+        if (hex == seg_len && hex >= 12) {
+            *id = seg;
+            *id_len = seg_len;
+            return true;
+        }
+
+        end = start > 0 ? start - 1 : 0;
+    }
+    return false;
+}
+
+/* Row whose attributes could not be read (process gone, exit records) */
+static inline void proc_attrs_clear(ProcAttr *out, int pid) {
+    memset(out, 0, sizeof(*out));
+    out->pid = pid;
+    out->cgroup = out->container = -1;
+}
+
+/* Read all attributes through an open /proc/<pid> directory fd */
+static inline void proc_attrs_read_at(ProcAttrs *a, int dirfd, int pid, ProcAttr *out) {
+    proc_attrs_clear(out, pid);
+    out->read = true;
+
+    out->pid_ns = proc_attrs_ns(dirfd, "ns/pid");
+    out->mnt_ns = proc_attrs_ns(dirfd, "ns/mnt");
+    out->net_ns = proc_attrs_ns(dirfd, "ns/net");
+    out->user_ns = proc_attrs_ns(dirfd, "ns/user");
+
+    int fd = openat(dirfd, "cgroup", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    char buf[4096];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return;
+    buf[n] = '\0';
+
+    /* "hierarchy:controllers:path" lines; the v2 line is "0::/path" */
+    const char *path = NULL;
+    size_t path_len = 0;
+    for (char *line = buf; line && *line; ) {
+        char *next = strchr(line, '\n');
+        size_t line_len = next ? (size_t)(next - line) : strlen(line);
+        char *c1 = memchr(line, ':', line_len);
+        char *c2 = c1 ? memchr(c1 + 1, ':', line_len - (size_t)(c1 + 1 - line)) : NULL;
+        if (c2) {
+            bool v2 = line[0] == '0' && c1 == line + 1 && c2 == c1 + 1;
+            if (v2 || !path) {
+                path = c2 + 1;
+                path_len = line_len - (size_t)(c2 + 1 - line);
+            }
+            if (v2) break;
+        }
+        line = next ? next + 1 : NULL;
+    }
+    if (!path) return;
+
+    out->cgroup = proc_attrs_intern(a, path, path_len);
+    const char *id;
+    size_t id_len;
+    if (proc_attrs_container_id(path, path_len, &id, &id_len)) out->container = proc_attrs_intern(a, id, id_len);
+}
+
+static inline void proc_attrs_print_str(const char *s) {
+    if (!s) {
+        printf("null");
+        return;
+    }
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') putchar('\\');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+/* Extra columns for one row (no-op without --ns) */
+static inline void proc_attrs_print(const ProcAttrs *a, const ProcAttr *r) {
+    if (!a->columns) return;
+    printf(",\"pid_ns\":%llu,\"mnt_ns\":%llu,\"net_ns\":%llu,\"user_ns\":%llu,\"cgroup\":",
+           r->pid_ns, r->mnt_ns, r->net_ns, r->user_ns);
+    proc_attrs_print_str(proc_attrs_str(a, r->cgroup));
+    printf(",\"container\":");
+    proc_attrs_print_str(proc_attrs_str(a, r->container));
+}
+
+/* Group key of a row as a number (string ids for cgroup/container; -1 sorts first) */
+static inline long long proc_attrs_key(const ProcAttrs *a, const ProcAttr *r) {
+    switch (a->group_by) {
+    case PROC_GROUP_CONTAINER: return r->container;
+    case PROC_GROUP_CGROUP:    return r->cgroup;
+    case PROC_GROUP_PID_NS:    return (long long)r->pid_ns;
+    case PROC_GROUP_MNT_NS:    return (long long)r->mnt_ns;
+    case PROC_GROUP_NET_NS:    return (long long)r->net_ns;
+    case PROC_GROUP_USER_NS:   return (long long)r->user_ns;
+    default:                   return 0;
+    }
+}
+
+/* qsort has no context argument */
+static const ProcAttrs *proc_attrs_sort_ctx;
+static size_t proc_attrs_sort_offset;
+static bool proc_attrs_sort_by_rank;
+
+static inline int proc_attrs_row_cmp(const void *x, const void *y) {
+    const ProcAttr *a = (const ProcAttr *)((const char *)x + proc_attrs_sort_offset);
+    const ProcAttr *b = (const ProcAttr *)((const char *)y + proc_attrs_sort_offset);
+    long long ka = proc_attrs_key(proc_attrs_sort_ctx, a);
+    long long kb = proc_attrs_key(proc_attrs_sort_ctx, b);
+    if (ka != kb) return ka < kb ? -1 : 1;
+    if (proc_attrs_sort_by_rank) return (a->rank > b->rank) - (a->rank < b->rank);
+    return (a->pid > b->pid) - (a->pid < b->pid);
+}
+
+/* Order rows by group (then pid); no-op without --group-by */
+static inline void proc_attrs_sort(const ProcAttrs *a, void *rows, size_t n, size_t size, size_t attr_offset) {
+    if (a->group_by == PROC_GROUP_NONE || n == 0) return;
+    proc_attrs_sort_ctx = a;
+    proc_attrs_sort_offset = attr_offset;
+    proc_attrs_sort_by_rank = false;
+    qsort(rows, n, size, proc_attrs_row_cmp);
+}
+
+/* Order rows by group, keeping their incoming order inside a group (--top rank); no-op without --group-by */
+static inline void proc_attrs_sort_ranked(const ProcAttrs *a, void *rows, size_t n, size_t size, size_t attr_offset) {
+    if (a->group_by == PROC_GROUP_NONE || n == 0) return;
+    for (size_t i = 0; i < n; i++) ((ProcAttr *)((char *)rows + i * size + attr_offset))->rank = i;
+    proc_attrs_sort_ctx = a;
+    proc_attrs_sort_offset = attr_offset;
+    proc_attrs_sort_by_rank = true;
+    qsort(rows, n, size, proc_attrs_row_cmp);
+}
+
+static inline void proc_attrs_group_header(const ProcAttrs *a, const ProcAttr *r) {
+    printf("  {\"%s\":", proc_group_names[a->group_by]);
+    switch (a->group_by) {
+    case PROC_GROUP_CONTAINER: proc_attrs_print_str(proc_attrs_str(a, r->container)); break;
+    case PROC_GROUP_CGROUP:    proc_attrs_print_str(proc_attrs_str(a, r->cgroup)); break;
+    default:                   printf("%lld", proc_attrs_key(a, r)); break;
+    }
+    printf(",\"processes\":[\n    ");
+}
+
+/* Separator before a row: ",\n  " between rows, plus group open/close when grouping */
+static inline void proc_attrs_row_sep(const ProcAttrs *a, const ProcAttr *prev, const ProcAttr *cur) {
+    if (a->group_by == PROC_GROUP_NONE) {
+        printf(prev ? ",\n  " : "  ");
+        return;
+    }
+    if (!prev) {
+        proc_attrs_group_header(a, cur);
+    } else if (proc_attrs_key(a, prev) == proc_attrs_key(a, cur)) {
+        printf(",\n    ");
+    } else {
+        printf("\n  ]},\n");
+        proc_attrs_group_header(a, cur);
+    }
+}
+
+/* After the last row */
+static inline void proc_attrs_end(const ProcAttrs *a, bool had_rows) {
+    if (!had_rows) return;
+    printf(a->group_by == PROC_GROUP_NONE ? "\n" : "\n  ]}\n");
+}
+
+#endif /* SCANNER_PROC_ATTRS_H */
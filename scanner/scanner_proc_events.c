@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include "scanner_proc_handle.h"
+
+#define EXITED_MAX 65536   /* exited processes kept between two snapshots */
+
+/* One live process; pid == 0 marks an empty hash slot */
+typedef struct {
+    int pid;
+    int ppid;
+    unsigned int uid;
+    char name[17];                  /* TASK_COMM_LEN = 16 + '\0' */
+    unsigned long long fork_ns;     /* event timestamp of the fork, 0 if seen by /proc walk */
+    unsigned int gen;               /* last /proc walk that saw it (resync) */
+} ProcEntry;
+
+/* Process that exited since the last snapshot */
+typedef struct {
+    ProcEntry proc;
+    int exit_code;
+    int exit_signal;
+    long long lifetime_ms;          /* -1 if the fork was not observed */
+} ExitedProc;
+
+/* Open-addressing pid → ProcEntry table (linear probing, backward-shift delete) */
+typedef struct {
+    ProcEntry *slots;
+    size_t mask;                    /* slot count - 1 (power of two) */
+    size_t count;
+} ProcTable;
+
+typedef enum { FORMAT_FULL, FORMAT_PIDS, FORMAT_COMM } OutputFormat;
+
+typedef struct {
+    unsigned int interval_ms;       /* snapshot period */
+    unsigned int count;             /* snapshots before exit, 0 = run forever */
+    OutputFormat format;
+} ProcEventOptions;
+
+static ProcTable table;
+static ExitedProc *exited;
+static size_t exited_count;
+static unsigned long exited_dropped;
+static unsigned long resyncs;
+static unsigned int walk_gen;
+static volatile sig_atomic_t dump_requested;
+static volatile sig_atomic_t stop_requested;
+
+/* Comparator for qsort by PID */
+static int entry_pid_cmp(const void *a, const void *b) {
+    return ((const ProcEntry *)a)->pid - ((const ProcEntry *)b)->pid;
+}
+
+static size_t pid_slot(const ProcTable *t, int pid) {
+    return ((size_t)(unsigned int)pid * 2654435761u) & t->mask;
+}
+
+static ProcEntry *proc_table_find(ProcTable *t, int pid) {
+    for (size_t i = pid_slot(t, pid); t->slots[i].pid != 0; i = (i + 1) & t->mask) {
+        if (t->slots[i].pid == pid) return &t->slots[i];
+    }
+    return NULL;
+}
+
+static bool proc_table_grow(ProcTable *t) {
+    size_t new_size = (t->mask + 1) * 2;
+    ProcEntry *new_slots = calloc(new_size, sizeof(ProcEntry));
+    if (!new_slots) return false;
+
+    ProcEntry *old = t->slots;
+    size_t old_size = t->mask + 1;
+    t->slots = new_slots;
+    t->mask = new_size - 1;
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i].pid == 0) continue;
+        size_t j = pid_slot(t, old[i].pid);
+        while (t->slots[j].pid != 0) j = (j + 1) & t->mask;
+        t->slots[j] = old[i];
+    }
+    free(old);
+    return true;
+}
+
+/* Existing entry for pid, or a new zeroed one; NULL on allocation failure */
+static ProcEntry *proc_table_insert(ProcTable *t, int pid) {
+    ProcEntry *e = proc_table_find(t, pid);
+    if (e) return e;
+    if ((t->count + 1) * 2 > t->mask + 1 && !proc_table_grow(t)) return NULL;
+
+    size_t i = pid_slot(t, pid);
+    while (t->slots[i].pid != 0) i = (i + 1) & t->mask;
+    memset(&t->slots[i], 0, sizeof(ProcEntry));
+    t->slots[i].pid = pid;
+    t->count++;
+    return &t->slots[i];
+}
+
+static void proc_table_remove(ProcTable *t, ProcEntry *e) {
+    size_t i = (size_t)(e - t->slots);
+    t->slots[i].pid = 0;
+    t->count--;
+
+    /* Backward-shift the rest of the probe run so lookups never hit a hole */
+    for (size_t j = (i + 1) & t->mask; t->slots[j].pid != 0; j = (j + 1) & t->mask) {
+        size_t home = pid_slot(t, t->slots[j].pid);
+        bool movable = (j > i) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            t->slots[i] = t->slots[j];
+            t->slots[j].pid = 0;
+            i = j;
+        }
+    }
+}
+
+/* Read name (/proc/<pid>/comm) into e->name; false if the process is gone */
+static bool read_comm(int pid, ProcEntry *e) {
+    ProcHandle h;
+    if (!proc_handle_open_dir(&h, pid)) return false;
+
+    int fd = proc_handle_openat(&h, "comm");
+    proc_handle_close(&h);
+    if (fd < 0) return false;
+
+    char comm[17] = {0};
+    ssize_t n = read(fd, comm, sizeof(comm) - 1);
+    close(fd);
+    if (n <= 0) return false;
+
+    comm[n] = '\0';
+    if (comm[n - 1] == '\n') comm[n - 1] = '\0';
+    snprintf(e->name, sizeof(e->name), "%s", comm);
+    return true;
+}
+
+/* PPID and real UID from the handle's status */
+static bool read_ppid_uid(const ProcHandle *h, ProcEntry *e) {
+    FILE *fp = proc_handle_fopen(h, "status");
+    if (!fp) return false;
+
+    char line[512];
+    int found = 0;
+    while (found < 2 && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "PPid:", 5) == 0) {
+            found += sscanf(line + 5, "%d", &e->ppid) == 1;
+        }
+        else if (strncmp(line, "Uid:", 4) == 0) {
+            found += sscanf(line + 4, "%u", &e->uid) == 1;
+        }
+    }
+    fclose(fp);
+    return found == 2;
+}
+
+/*
+   Full /proc walk: initial sync and recovery after the event socket overflowed
+   (ENOBUFS). Entries not seen by this walk died while events were lost and are dropped.
+*/
+static void sync_from_proc(void) {
+    ProcIter it;
+    if (!proc_iter_open(&it)) return;
+
+    walk_gen++;
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        /* name came with the iterator's stat read */
+        ProcEntry tmp = { .pid = h.pid };
+        bool ok = read_ppid_uid(&h, &tmp);
+        snprintf(tmp.name, sizeof(tmp.name), "%s", proc_handle_comm(&h));
+        proc_handle_close(&h);
+        if (!ok) continue;  /* died meanwhile */
+
+        ProcEntry *e = proc_table_insert(&table, tmp.pid);
+        if (!e) break;
+        e->ppid = tmp.ppid;
+        e->uid = tmp.uid;
+        memcpy(e->name, tmp.name, sizeof(e->name));
+        e->gen = walk_gen;
+    }
+    proc_iter_close(&it);
+
+    for (size_t i = 0; i <= table.mask; ) {
+        /* remove() shifts a later entry into slot i, so only advance when nothing moved */
+        if (table.slots[i].pid != 0 && table.slots[i].gen != walk_gen) {
+            proc_table_remove(&table, &table.slots[i]);
+        } else {
+            i++;
+        }
+    }
+}
+
+static void record_exit(ProcEntry *e, const struct proc_event *ev) {
+    if (exited_count >= EXITED_MAX) {
+        exited_dropped++;
+        return;
+    }
+    ExitedProc *x = &exited[exited_count++];
+    x->proc = *e;
+    x->exit_code = (int)(ev->event_data.exit.exit_code >> 8) & 0xff;
+    x->exit_signal = (int)(ev->event_data.exit.exit_code & 0x7f);
+    x->lifetime_ms = e->fork_ns ? (long long)((ev->timestamp_ns - e->fork_ns) / 1000000ULL) : -1;
+}
+
+/* Apply one cn_proc event to the table; thread events (pid != tgid) are ignored */
+static void handle_event(const struct proc_event *ev) {
+    ProcEntry *e;
+
+    switch (ev->what) {
+    case PROC_EVENT_FORK: {
+        if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) break;  /* new thread */
+        ProcEntry *parent = proc_table_find(&table, ev->event_data.fork.parent_tgid);
+        ProcEntry inherit = parent ? *parent : (ProcEntry){0};
+        e = proc_table_insert(&table, ev->event_data.fork.child_tgid);
+        if (!e) break;
+        e->ppid = ev->event_data.fork.parent_tgid;
+        e->uid = inherit.uid;                          /* child inherits creds and comm */
+        memcpy(e->name, inherit.name, sizeof(e->name));
+        e->fork_ns = ev->timestamp_ns;
+        e->gen = walk_gen;
+        break;
+    }
+    case PROC_EVENT_EXEC:
+        e = proc_table_find(&table, ev->event_data.exec.process_tgid);
+        if (e) read_comm(e->pid, e);   /* exec does not send COMM; may race with exit */
+        break;
+    case PROC_EVENT_COMM:
+        if (ev->event_data.comm.process_pid != ev->event_data.comm.process_tgid) break;
+        e = proc_table_find(&table, ev->event_data.comm.process_tgid);
+        if (e) snprintf(e->name, sizeof(e->name), "%.16s", ev->event_data.comm.comm);
+        break;
+    case PROC_EVENT_UID:
+        e = proc_table_find(&table, ev->event_data.id.process_tgid);
+        if (e) e->uid = ev->event_data.id.r.ruid;
+        break;
+    case PROC_EVENT_EXIT:
+        if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) break;  /* thread */
+        e = proc_table_find(&table, ev->event_data.exit.process_tgid);
+        if (!e) break;
+        record_exit(e, ev);
+        proc_table_remove(&table, e);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Connector socket subscribed to process events; -1 on failure (needs CAP_NET_ADMIN) */
+static int proc_events_open(void) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        perror("socket NETLINK_CONNECTOR");
+        return -1;
+    }
+
+    /* Bigger buffer = fewer overflows during fork storms */
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC, .nl_pid = 0 };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind NETLINK_CONNECTOR");
+        close(fd);
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct cn_msg cn;
+        enum proc_cn_mcast_op op;
+    } __attribute__((packed)) msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = NLMSG_DONE;
+    msg.cn.id.idx = CN_IDX_PROC;
+    msg.cn.id.val = CN_VAL_PROC;
+    msg.cn.len = sizeof(enum proc_cn_mcast_op);
+    msg.op = PROC_CN_MCAST_LISTEN;
+
+    if (send(fd, &msg, sizeof(msg), 0) < 0) {
+        perror("send PROC_CN_MCAST_LISTEN");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Drain everything queued on the connector socket without blocking */
+static void drain_events(int fd) {
+    static char buf[65536] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+        ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                /* Kernel dropped events: table may be stale, rebuild from /proc */
+                resyncs++;
+                sync_from_proc();
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("recv NETLINK_CONNECTOR");
+            return;
+        }
+        if (len == 0) return;
+
+        struct nlmsghdr *h = (struct nlmsghdr *)buf;
+        for (; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_type == NLMSG_ERROR || h->nlmsg_type == NLMSG_NOOP) continue;
+            const struct cn_msg *cn = NLMSG_DATA(h);
+            if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+            if (cn->len < sizeof(struct proc_event)) continue;
+            handle_event((const struct proc_event *)cn->data);
+        }
+    }
+}
+
+/* Print the current table (and processes exited since the last snapshot), then reset the exit list */
+static void print_snapshot(OutputFormat format) {
+    ProcEntry *live = malloc((table.count ? table.count : 1) * sizeof(ProcEntry));
+    size_t n = 0;
+    if (live) {
+        for (size_t i = 0; i <= table.mask; i++) {
+            if (table.slots[i].pid != 0) live[n++] = table.slots[i];
+        }
+        qsort(live, n, sizeof(ProcEntry), entry_pid_cmp);
+    }
+
+    /* === OUTPUT – replace this block with your database insert === */
+    if (format == FORMAT_PIDS) {
+        printf("[");
+        for (size_t i = 0; i < n; i++) printf("%d%s", live[i].pid, i < n - 1 ? "," : "");
+        printf("]\n");
+    } else if (format == FORMAT_COMM) {
+        printf("[\n");
+        for (size_t i = 0; i < n; i++) {
+            printf("  {\"pid\":%d,\"name\":\"%s\"}%s\n", live[i].pid, live[i].name, i < n - 1 ? "," : "");
+        }
+        printf("]\n");
+    } else {
+        printf("{\"processes\":[\n");
+        for (size_t i = 0; i < n; i++) {
+            printf("  {\"pid\":%d,\"ppid\":%d,\"uid\":%u,\"name\":\"%s\"}%s\n",
+                   live[i].pid, live[i].ppid, live[i].uid, live[i].name, i < n - 1 ? "," : "");
+        }
+        printf("],\"exited\":[\n");
+        for (size_t i = 0; i < exited_count; i++) {
+            const ExitedProc *x = &exited[i];
+            printf("  {\"pid\":%d,\"ppid\":%d,\"uid\":%u,\"name\":\"%s\",\"exit_code\":%d,\"exit_signal\":%d,\"lifetime_ms\":%lld}%s\n",
+                   x->proc.pid, x->proc.ppid, x->proc.uid, x->proc.name,
+                   x->exit_code, x->exit_signal, x->lifetime_ms, i < exited_count - 1 ? "," : "");
+        }
+        printf("],\"exited_dropped\":%lu,\"resyncs\":%lu}\n", exited_dropped, resyncs);
+    }
+    fflush(stdout);
+
+    free(live);
+    exited_count = 0;
+    exited_dropped = 0;
+}
+
+static void on_sigusr1(int sig) { (void)sig; dump_requested = 1; }
+static void on_sigterm(int sig) { (void)sig; stop_requested = 1; }
+
+static unsigned long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+/*
+   Scanner: Live process table from the cn_proc connector (resident)
+   Subscribes to PROC_EVENT_FORK/EXEC/EXIT/COMM/UID before one initial /proc walk,
+   then keeps an in-memory pid → {ppid, uid, name} table up to date from events only.
+   /proc is walked again only when the kernel reports an event overflow (ENOBUFS).
+   Every opts->interval_ms (and on SIGUSR1) prints a snapshot:
+     full: {"processes":[{pid, ppid, uid, name}], "exited":[{pid, ppid, uid, name,
+           exit_code, exit_signal, lifetime_ms}], "exited_dropped", "resyncs"}
+           where "exited" lists processes that ended since the previous snapshot,
+           including short-lived ones a /proc poll never sees;
+     pids / comm: same arrays as scanner_pids / scanner_comm.
+   Note: Needs root (CAP_NET_ADMIN) to subscribe. Threads are not tracked.
+*/
+int scan_proc_events(const ProcEventOptions *opts)
+{
+    table.mask = 4095;
+    table.slots = calloc(table.mask + 1, sizeof(ProcEntry));
+    exited = malloc(EXITED_MAX * sizeof(ExitedProc));
+    if (!table.slots || !exited) {
+        fprintf(stderr, "out of memory\n");
+        free(table.slots);
+        free(exited);
+        return 1;
+    }
+
+    /* Subscribe first so nothing is lost between the walk and the first event */
+    int fd = proc_events_open();
+    if (fd < 0) {
+        free(table.slots);
+        free(exited);
+        return 1;
+    }
+    sync_from_proc();
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigusr1;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = on_sigterm;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    unsigned int printed = 0;
+    unsigned long long next_dump = now_ms() + opts->interval_ms;
+
+    while (!stop_requested) {
+        unsigned long long now = now_ms();
+        int timeout = next_dump > now ? (int)(next_dump - now) : 0;
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+        int rc = poll(&pfd, 1, timeout);
+        if (rc < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (rc > 0) drain_events(fd);
+
+        if (dump_requested || now_ms() >= next_dump) {
+            drain_events(fd);   /* apply everything queued up to this point */
+            print_snapshot(opts->format);
+            if (!dump_requested) next_dump += opts->interval_ms;
+            dump_requested = 0;
+            if (opts->count && ++printed >= opts->count) break;
+        }
+    }
+
+    close(fd);
+    free(table.slots);
+    free(exited);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    ProcEventOptions opts = { .interval_ms = 10000, .count = 0, .format = FORMAT_FULL };
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            opts.interval_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+            if (opts.interval_ms == 0) bad_args = true;
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            opts.count = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "full") == 0) opts.format = FORMAT_FULL;
+            else if (strcmp(f, "pids") == 0) opts.format = FORMAT_PIDS;
+            else if (strcmp(f, "comm") == 0) opts.format = FORMAT_COMM;
+            else bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s [--interval <ms>] [--count <n>] [--format full|pids|comm]\n", argv[0]);
+        fprintf(stderr, "      # Resident: live process table from cn_proc events, one JSON snapshot per interval\n");
+        fprintf(stderr, "      # (default 10000 ms, forever; SIGUSR1 prints one immediately)\n");
+        return 1;
+    }
+
+    return scan_proc_events(&opts);
+}
@@ -0,0 +1,370 @@
+/*
+   scanner_proc_filter.h - cheap per-process predicates evaluated before expensive reads
+
+   Header-only (static inline); included by scanner_proc_handle.h, so every scanner
+   that takes --cgroup also takes --filter and still builds as a single file.
+
+   --filter <expr> (repeatable) is a comma-separated list of terms that must all hold;
+   a term is key=value or key!=value, and value may list alternatives with '|':
+       comm=GLOB        comm (fnmatch glob)              comm=sshd|nginx*
+       uid=N|NAME       owner of /proc/<pid> (effective uid; root for non-dumpable)
+       ppid=N           direct parent
+       tree=N           N and all its descendants
+       kthread=0|1      PF_KTHREAD in stat field 9
+       cgroup=PATH      cgroup v2 path is PATH or below it
+   e.g.  --filter kthread=0,uid!=0      --filter 'tree=1234,comm!=sh|bash'
+
+   Terms are evaluated on the /proc/<pid> directory fd the ProcHandle is built from,
+   so the decision and every later read apply to the same process. They are checked
+   cheapest first: uid (fstat of the directory), then comm/ppid/kthread (one read of
+   stat, shared with the handle's starttime), then tree (ancestor ppids, cached
+   across the walk), then cgroup (read of cgroup). ProcIter applies the filter before
+   pidfd_open, so a scanner never opens environ, maps or fd/ of a process that does
+   not pass.
+*/
+#ifndef SCANNER_PROC_FILTER_H
+#define SCANNER_PROC_FILTER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define PROC_FILTER_PF_KTHREAD 0x00200000UL   /* include/linux/sched.h */
+
+/* In cost order: proc_filter_match() evaluates terms sorted by key */
+enum { PF_KEY_UID, PF_KEY_COMM, PF_KEY_PPID, PF_KEY_KTHREAD, PF_KEY_TREE, PF_KEY_CGROUP };
+
+typedef struct {
+    int          key;              /* PF_KEY_* */
+    bool         negate;           /* key!=value */
+    const char **values;           /* alternatives (argv storage) */
+    long        *nums;             /* parsed numeric alternatives (uid, ppid, tree, kthread) */
+    size_t       count;
+} ProcFilterTerm;
+
+typedef struct {
+    ProcFilterTerm *terms;
+    size_t          count;
+    bool            bad;           /* a --filter term did not parse (already reported) */
+} ProcFilter;
+
+/* Per-walk state: pid → ppid cache for tree= terms */
+typedef struct {
+    const ProcFilter *filter;
+    int    *pids;                  /* open addressing, 0 = empty */
+    int    *ppids;
+    size_t  mask;
+    size_t  used;
+} ProcFilterEval;
+
+typedef struct {
+    bool          read;            /* stat parsed (or failed: ok = false) */
+    bool          ok;
+    char          comm[17];
+    int           ppid;
+    unsigned long flags;
+    unsigned long long starttime;  /* field 22, for the ProcHandle */
+} ProcFilterStat;
+
+static inline int proc_filter_key(const char *name, size_t len) {
+    static const char *const names[] = { "uid", "comm", "ppid", "kthread", "tree", "cgroup" };
+    for (int k = 0; k < (int)(sizeof(names) / sizeof(names[0])); k++) {
+        if (strlen(names[k]) == len && strncmp(name, names[k], len) == 0) return k;
+    }
+    return -1;
+}
+
+static inline bool proc_filter_number(const char *s, long *out) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end) return false;
+    *out = v;
+    return true;
+}
+
+static inline int proc_filter_term_cmp(const void *a, const void *b) {
+    int x = ((const ProcFilterTerm *)a)->key;
+    int y = ((const ProcFilterTerm *)b)->key;
+    return (x > y) - (x < y);
+}
+
+/* One "key=v1|v2" / "key!=v" term, parsed in place */
+static inline bool proc_filter_add_term(ProcFilter *f, char *term) {
+    char *eq = strchr(term, '=');
+    if (!eq || eq == term) return false;
+    bool negate = eq[-1] == '!';
+    int key = proc_filter_key(term, (size_t)(eq - term) - (negate ? 1 : 0));
+    if (key < 0 || !eq[1]) return false;
+
+    size_t listed = 1;
+    for (const char *p = eq + 1; *p; p++) listed += *p == '|';
+
+    ProcFilterTerm t = { .key = key, .negate = negate };
+    t.values = malloc(listed * sizeof(char *));
+    t.nums = malloc(listed * sizeof(long));
+    bool ok = t.values && t.nums;
+    for (char *save = NULL, *v = strtok_r(eq + 1, "|", &save); ok && v; v = strtok_r(NULL, "|", &save)) {
+        long num = 0;
+        bool numeric = proc_filter_number(v, &num);
+        if (key == PF_KEY_UID && !numeric) {
+            /* user name: resolved once here, not per process */
+            struct passwd pw, *res = NULL;
+            char buf[4096];
+            numeric = getpwnam_r(v, &pw, buf, sizeof(buf), &res) == 0 && res;
+            if (numeric) num = (long)res->pw_uid;
+        }
+        if (key == PF_KEY_KTHREAD && num != 0 && num != 1) numeric = false;
+        ok = numeric || key == PF_KEY_COMM || key == PF_KEY_CGROUP;
+
+        t.values[t.count] = v;
+        t.nums[t.count++] = num;
+    }
+    /* "a||b" or a trailing '|' leaves an empty alternative strtok_r skips: reject it too */
+    if (!ok || t.count != listed) {
+        free(t.values);
+        free(t.nums);
+        return false;
+    }
+
+    ProcFilterTerm *n = realloc(f->terms, (f->count + 1) * sizeof(ProcFilterTerm));
+    if (!n) {
+        free(t.values);
+        free(t.nums);
+        return false;
+    }
+    f->terms = n;
+    f->terms[f->count++] = t;
+    qsort(f->terms, f->count, sizeof(ProcFilterTerm), proc_filter_term_cmp);
+    return true;
+}
+
+/* Consume "--filter <expr>" (repeatable) at argv[*i]; bad terms are reported and set f->bad */
+static inline bool proc_filter_arg(ProcFilter *f, int argc, char **argv, int *i) {
+    if (strcmp(argv[*i], "--filter") != 0 || *i + 1 >= argc) return false;
+
+    char *list = argv[++*i];
+    for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char shown[256];
+        snprintf(shown, sizeof(shown), "%s", tok);   /* before '|' splitting edits it */
+        if (!proc_filter_add_term(f, tok)) {
+            fprintf(stderr, "Bad --filter term '%s'\n", shown);
+            f->bad = true;
+        }
+    }
+    return true;
+}
+
+static inline void proc_filter_free(ProcFilter *f) {
+    for (size_t i = 0; i < f->count; i++) {
+        free(f->terms[i].values);
+        free(f->terms[i].nums);
+    }
+    free(f->terms);
+    memset(f, 0, sizeof(*f));
+}
+
+static inline void proc_filter_eval_init(ProcFilterEval *ev, const ProcFilter *f) {
+    memset(ev, 0, sizeof(*ev));
+    ev->filter = f;
+}
+
+static inline void proc_filter_eval_free(ProcFilterEval *ev) {
+    free(ev->pids);
+    free(ev->ppids);
+    memset(ev, 0, sizeof(*ev));
+}
+
+/* comm, ppid, flags and starttime from one read of the stat file in a /proc/<pid> directory */
+static inline bool proc_filter_read_stat_at(int dirfd, ProcFilterStat *st) {
+    st->read = true;
+    st->ok = false;
+
+    int fd = openat(dirfd, "stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[1024];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) return false;
+    buf[len] = '\0';
+
+    /* comm may contain spaces and ')': it ends at the last ')' */
+    char *open_paren = strchr(buf, '(');
+    char *close_paren = strrchr(buf, ')');
+    if (!open_paren || !close_paren || close_paren < open_paren) return false;
+    size_t clen = (size_t)(close_paren - open_paren - 1);
+    if (clen >= sizeof(st->comm)) clen = sizeof(st->comm) - 1;
+    memcpy(st->comm, open_paren + 1, clen);
+    st->comm[clen] = '\0';
+
+    /* fields 3..9: state ppid pgrp session tty_nr tpgid flags, then 22: starttime */
+    char state;
+    if (sscanf(close_paren + 1, " %c %d %*d %*d %*d %*d %lu %*u %*u %*u %*u "
+                                "%*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &state, &st->ppid, &st->flags, &st->starttime) != 4) return false;
+    st->ok = true;
+    return true;
+}
+
+/* Same for another process (tree= ancestors), by path */
+static inline bool proc_filter_read_stat(int pid, ProcFilterStat *st) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d", pid);
+    int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        st->read = true;
+        st->ok = false;
+        return false;
+    }
+    bool ok = proc_filter_read_stat_at(dirfd, st);
+    close(dirfd);
+    return ok;
+}
+
+/* Parent of pid, cached for the rest of the walk; -1 if unknown */
+static inline int proc_filter_ppid(ProcFilterEval *ev, int pid) {
+    if (ev->pids) {
+        for (size_t i = ((size_t)pid * 2654435761u) & ev->mask; ev->pids[i]; i = (i + 1) & ev->mask) {
+            if (ev->pids[i] == pid) return ev->ppids[i];
+        }
+    }
+
+    ProcFilterStat st;
+    int ppid = proc_filter_read_stat(pid, &st) ? st.ppid : -1;
+
+    if ((ev->used + 1) * 2 > (ev->pids ? ev->mask + 1 : 0)) {
+        size_t old_cap = ev->pids ? ev->mask + 1 : 0;
+        size_t cap = old_cap ? old_cap * 2 : 1024;
+        int *np = calloc(cap, sizeof(int));
+        int *npp = np ? calloc(cap, sizeof(int)) : NULL;
+        if (!npp) {
+            free(np);
+            return ppid;
+        }
+        for (size_t i = 0; i < old_cap; i++) {
+            if (!ev->pids[i]) continue;
+            size_t j = ((size_t)ev->pids[i] * 2654435761u) & (cap - 1);
+            while (np[j]) j = (j + 1) & (cap - 1);
+            np[j] = ev->pids[i];
+            npp[j] = ev->ppids[i];
+        }
+        free(ev->pids);
+        free(ev->ppids);
+        ev->pids = np;
+        ev->ppids = npp;
+        ev->mask = cap - 1;
+    }
+    size_t i = ((size_t)pid * 2654435761u) & ev->mask;
+    while (ev->pids[i]) i = (i + 1) & ev->mask;
+    ev->pids[i] = pid;
+    ev->ppids[i] = ppid;
+    ev->used++;
+    return ppid;
+}
+
+/* Is pid (whose own parent is ppid) root or below it? */
+static inline bool proc_filter_in_tree(ProcFilterEval *ev, int pid, int ppid, long root) {
+    if (pid == root) return true;
+    pid = ppid;
+    for (int depth = 0; pid > 0 && depth < 4096; depth++) {
+        if (pid == root) return true;
+        pid = proc_filter_ppid(ev, pid);
+    }
+    return false;
+}
+
+/* cgroup v2 path of the process is prefix or below it */
+static inline bool proc_filter_in_cgroup(int dirfd, const char *const *prefixes, size_t count) {
+    int fd = openat(dirfd, "cgroup", O_RDONLY | O_CLOEXEC);
+    FILE *f = fd >= 0 ? fdopen(fd, "re") : NULL;
+    if (!f) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    char line[4096];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "0::", 3) != 0) continue;
+        char *cg = line + 3;
+        cg[strcspn(cg, "\n")] = '\0';
+        for (size_t i = 0; i < count && !found; i++) {
+            const char *p = prefixes[i];
+            size_t len = strlen(p);
+            while (len > 1 && p[len - 1] == '/') len--;
+            found = strncmp(cg, p, len) == 0 && (cg[len] == '\0' || cg[len] == '/' || len == 1);
+        }
+        break;
+    }
+    fclose(f);
+    return found;
+}
+
+static inline bool proc_filter_term_holds(ProcFilterEval *ev, const ProcFilterTerm *t, int pid, int dirfd,
+                                          ProcFilterStat *st, bool *gone) {
+    switch (t->key) {
+    case PF_KEY_UID: {
+        struct stat sb;
+        if (fstat(dirfd, &sb) != 0) {
+            *gone = true;
+            return false;
+        }
+        for (size_t i = 0; i < t->count; i++) {
+            if ((long)sb.st_uid == t->nums[i]) return true;
+        }
+        return false;
+    }
+    case PF_KEY_COMM:
+    case PF_KEY_PPID:
+    case PF_KEY_KTHREAD:
+        if (!st->read) proc_filter_read_stat_at(dirfd, st);
+        if (!st->ok) {
+            *gone = true;
+            return false;
+        }
+        for (size_t i = 0; i < t->count; i++) {
+            if (t->key == PF_KEY_COMM && fnmatch(t->values[i], st->comm, 0) == 0) return true;
+            if (t->key == PF_KEY_PPID && st->ppid == t->nums[i]) return true;
+            if (t->key == PF_KEY_KTHREAD && ((st->flags & PROC_FILTER_PF_KTHREAD) != 0) == (t->nums[i] != 0)) return true;
+        }
+        return false;
+    case PF_KEY_TREE:
+        if (!st->read) proc_filter_read_stat_at(dirfd, st);
+        if (!st->ok) {
+            *gone = true;
+            return false;
+        }
+        for (size_t i = 0; i < t->count; i++) {
+            if (proc_filter_in_tree(ev, pid, st->ppid, t->nums[i])) return true;
+        }
+        return false;
+    case PF_KEY_CGROUP:
+        return proc_filter_in_cgroup(dirfd, t->values, t->count);
+    }
+    return false;
+}
+
+/*
+   Does the process in dirfd (/proc/<pid>) pass every term? A process that vanished
+   mid-check never passes. st is the caller's (st->read = false on entry): if a term
+   needed stat it is left parsed, so the caller does not read it again.
+*/
+static inline bool proc_filter_match(ProcFilterEval *ev, int pid, int dirfd, ProcFilterStat *st) {
+    const ProcFilter *f = ev->filter;
+    if (!f || f->count == 0) return true;
+
+    for (size_t i = 0; i < f->count; i++) {
+        bool gone = false;
+        bool holds = proc_filter_term_holds(ev, &f->terms[i], pid, dirfd, st, &gone);
+        if (gone) return false;
+        if (holds == f->terms[i].negate) return false;
+    }
+    return true;
+}
+
+#endif /* SCANNER_PROC_FILTER_H */
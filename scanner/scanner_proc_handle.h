@@ -0,0 +1,406 @@
+/*
+   scanner_proc_handle.h - stable process identity for multi-file per-process reads
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_env.c -o scanner_env
+
+   A ProcHandle pins one process instance:
+     - pidfd      pidfd_open(2) (Linux >= 5.3), -1 where unsupported
+     - dirfd      /proc/<pid> opened once; every per-process file (comm, environ,
+                  fd/, stat, ...) is opened relative to it with openat(), so a
+                  recycled PID can never be read through it. Lookups under a dead
+                  process's directory fail (ENOENT/ESRCH) instead of returning
+                  another process's data.
+     - starttime  field 22 of stat, read through dirfd. (pid, starttime) is the
+                  identity cross-run caches key on.
+
+   Opening order is dirfd + stat, then pidfd, then a lookup under dirfd and a
+   liveness check on the pidfd: lookups under a reaped process's directory fail,
+   so if one still succeeds after pidfd_open the PID was never released in
+   between and the pidfd refers to the directory's process. ProcIter evaluates
+   --filter on the dirfd between the two steps (the stat read is shared), so
+   pidfd_open is only spent on processes that pass.
+
+   proc_handle_alive() is the cheap stale-PID check: poll() on the pidfd (no
+   procfs read). Without pidfd it falls back to re-reading starttime.
+
+   ProcIter walks /proc and yields an open handle per process:
+       ProcIter it;
+       ProcHandle h;
+       if (proc_iter_open(&it)) {
+           while (proc_iter_next(&it, &h)) {
+               ... proc_handle_openat(&h, "environ") ...
+               proc_handle_close(&h);
+           }
+           proc_iter_close(&it);
+       }
+
+   A ProcScope limits the walk to the members of cgroups (--cgroup <path>, the
+   cgroup and everything below it): PIDs come from their cgroup.procs files, or
+   TIDs from cgroup.threads with --cgroup-threads, so scanning one service costs
+   O(its processes) instead of O(host processes). Paths are relative to the
+   cgroup2 mount ("/system.slice/nginx.service") or absolute under /sys/fs/cgroup.
+       ProcScope scope = { 0 };
+       ... if (proc_scope_arg(&scope, argc, argv, &i)) continue; ...
+       proc_iter_open_scope(&it, &scope);
+
+   proc_scope_arg() also takes --filter (scanner_proc_filter.h): cheap predicates on
+   comm, uid, parent/subtree, cgroup and the kernel-thread flag. The iterator only
+   yields processes that pass, so per-process reads are never spent on the rest.
+*/
+#ifndef SCANNER_PROC_HANDLE_H
+#define SCANNER_PROC_HANDLE_H
+
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "scanner_proc_filter.h"
+
+typedef struct {
+    int    pid;
+    int    pidfd;                  /* -1 if pidfd_open is unavailable */
+    int    dirfd;                  /* /proc/<pid> */
+    unsigned long long starttime;  /* /proc/<pid>/stat field 22 */
+    bool   comm_read;
+    char   comm[17];               /* read lazily by proc_handle_comm */
+} ProcHandle;
+
+typedef struct {
+    const char **cgroups;          /* NULL = whole host */
+    size_t       count;
+    bool         threads;          /* cgroup.threads (TIDs) instead of cgroup.procs */
+    ProcFilter   filter;           /* --filter */
+} ProcScope;
+
+typedef struct {
+    DIR   *proc;                   /* whole-host walk */
+    int   *pids;                   /* scoped walk: sorted, unique */
+    size_t pid_count;
+    size_t next;
+    bool   scoped;
+    int    resume_after;           /* skip PIDs <= this (budget cursor), 0 = none */
+    ProcFilterEval filter;         /* empty filter: everything passes */
+} ProcIter;
+
+static inline int proc_handle_pidfd_open(int pid) {
+#ifdef SYS_pidfd_open
+    static bool unsupported = false;
+    if (unsupported) return -1;
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0 && errno == ENOSYS) unsupported = true;
+    return fd;
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+/* starttime (field 22) from the stat file under dirfd; false if the process is gone */
+static inline bool proc_handle_read_starttime(int dirfd, unsigned long long *starttime) {
+    int fd = openat(dirfd, "stat", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return false;
+    buf[n] = '\0';
+
+    /* comm may contain spaces and ')' – fields restart after the last ')' */
+    char *p = strrchr(buf, ')');
+    if (!p) return false;
+
+    return sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                         "%*u %*u %*d %*d %*d %*d %*d %*d %llu", starttime) == 1;
+}
+
+/* pidfd becomes readable once the process has exited */
+static inline bool proc_handle_pidfd_exited(int pidfd) {
+    struct pollfd pfd = { .fd = pidfd, .events = POLLIN, .revents = 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+static inline void proc_handle_close(ProcHandle *h) {
+    if (h->pidfd >= 0) close(h->pidfd);
+    if (h->dirfd >= 0) close(h->dirfd);
+    h->pidfd = h->dirfd = -1;
+}
+
+/* First step: /proc/<pid> only (pidfd still -1); false if it is gone or not accessible */
+static inline bool proc_handle_open_dir(ProcHandle *h, int pid) {
+    memset(h, 0, sizeof(*h));
+    h->pid = pid;
+    h->pidfd = -1;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d", pid);
+    h->dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return h->dirfd >= 0;
+}
+
+/* Second step, once dirfd and starttime are set: take the pidfd of that same process */
+static inline bool proc_handle_pin(ProcHandle *h) {
+    h->pidfd = proc_handle_pidfd_open(h->pid);
+
+    struct stat st;
+    if (fstatat(h->dirfd, "stat", &st, 0) != 0 ||
+        (h->pidfd >= 0 && proc_handle_pidfd_exited(h->pidfd))) {
+        proc_handle_close(h);
+        return false;
+    }
+    return true;
+}
+
+/* Pin process <pid>; false if it is gone or /proc/<pid> is not accessible */
+static inline bool proc_handle_open(ProcHandle *h, int pid) {
+    if (!proc_handle_open_dir(h, pid)) return false;
+    if (!proc_handle_read_starttime(h->dirfd, &h->starttime)) {
+        proc_handle_close(h);
+        return false;
+    }
+    return proc_handle_pin(h);
+}
+
+/* Still the same, living process? */
+static inline bool proc_handle_alive(const ProcHandle *h) {
+    if (h->pidfd >= 0) return !proc_handle_pidfd_exited(h->pidfd);
+
+    unsigned long long st;
+    return proc_handle_read_starttime(h->dirfd, &st) && st == h->starttime;
+}
+
+/* open() a file of this process ("environ", "fd/3", "status", ...) */
+static inline int proc_handle_openat(const ProcHandle *h, const char *name) {
+    return openat(h->dirfd, name, O_RDONLY | O_CLOEXEC);
+}
+
+static inline FILE *proc_handle_fopen(const ProcHandle *h, const char *name) {
+    int fd = proc_handle_openat(h, name);
+    if (fd < 0) return NULL;
+    FILE *f = fdopen(fd, "re");
+    if (!f) close(fd);
+    return f;
+}
+
+/* opendir() a directory of this process ("fd", "task", "fdinfo") */
+static inline DIR *proc_handle_opendir(const ProcHandle *h, const char *name) {
+    int fd = openat(h->dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    DIR *d = fdopendir(fd);
+    if (!d) close(fd);
+    return d;
+}
+
+/* comm without trailing newline, "[unknown]" if unreadable */
+static inline const char *proc_handle_comm(ProcHandle *h) {
+    if (!h->comm_read) {
+        snprintf(h->comm, sizeof(h->comm), "%s", "[unknown]");
+        int fd = proc_handle_openat(h, "comm");
+        if (fd >= 0) {
+            ssize_t n = read(fd, h->comm, sizeof(h->comm) - 1);
+            close(fd);
+            if (n > 0) {
+                h->comm[n] = '\0';
+                if (h->comm[n-1] == '\n') h->comm[n-1] = '\0';
+            }
+        }
+        h->comm_read = true;
+    }
+    return h->comm;
+}
+
+static inline int proc_scope_int_cmp(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+   Consume "--cgroup <path>" (repeatable, comma lists allowed), "--cgroup-threads" or
+   "--filter <expr>" at argv[*i]. A --filter that does not parse is reported and
+   returns false, so the caller's usage path runs.
+*/
+static inline bool proc_scope_arg(ProcScope *scope, int argc, char **argv, int *i) {
+    if (proc_filter_arg(&scope->filter, argc, argv, i)) return !scope->filter.bad;
+    if (strcmp(argv[*i], "--cgroup-threads") == 0) {
+        scope->threads = true;
+        return true;
+    }
+    if (strcmp(argv[*i], "--cgroup") != 0 || *i + 1 >= argc) return false;
+
+    char *list = argv[++*i];
+    for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        const char **n = realloc(scope->cgroups, (scope->count + 1) * sizeof(char *));
+        if (!n) break;
+        scope->cgroups = n;
+        scope->cgroups[scope->count++] = tok;
+    }
+    return true;
+}
+
+static inline void proc_scope_free(ProcScope *scope) {
+    free(scope->cgroups);
+    scope->cgroups = NULL;
+    scope->count = 0;
+    proc_filter_free(&scope->filter);
+}
+
+/* Append the IDs listed in <dir>/<file> and recurse into child cgroups */
+static inline void proc_scope_collect(int cg_fd, const char *file, int **pids, size_t *count, size_t *capacity) {
+    int fd = openat(cg_fd, file, O_RDONLY | O_CLOEXEC);
+    FILE *f = fd >= 0 ? fdopen(fd, "re") : NULL;
+    if (f) {
+        int pid;
+        while (fscanf(f, "%d", &pid) == 1) {
+            if (*count >= *capacity) {
+                size_t newcap = *capacity ? *capacity * 2 : 1024;
+                int *n = realloc(*pids, newcap * sizeof(int));
+                if (!n) break;
+                *pids = n;
+                *capacity = newcap;
+            }
+            (*pids)[(*count)++] = pid;
+        }
+        fclose(f);
+    } else if (fd >= 0) {
+        close(fd);
+    }
+
+    int dup_fd = dup(cg_fd);
+    DIR *dir = dup_fd >= 0 ? fdopendir(dup_fd) : NULL;
+    if (!dir) {
+        if (dup_fd >= 0) close(dup_fd);
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_type != DT_DIR || ent->d_name[0] == '.') continue;
+        int child = openat(dirfd(dir), ent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (child < 0) continue;
+        proc_scope_collect(child, file, pids, count, capacity);
+        close(child);
+    }
+    closedir(dir);
+}
+
+/* cgroup path → directory fd; relative paths resolve against the cgroup2 mount */
+static inline int proc_scope_open_cgroup(const char *path) {
+    if (strncmp(path, "/sys/", 5) == 0) return open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    const char *root = access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0
+                       ? "/sys/fs/cgroup" : "/sys/fs/cgroup/unified";
+    char full[4096];
+    int needed = snprintf(full, sizeof(full), "%s/%s", root, path[0] == '/' ? path + 1 : path);
+    if (needed < 0 || needed >= (int)sizeof(full)) return -1;
+    return open(full, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/* Whole host when scope is NULL or empty, else only members of scope's cgroups; false on a bad --filter */
+static inline bool proc_iter_open_scope(ProcIter *it, const ProcScope *scope) {
+    memset(it, 0, sizeof(*it));
+    if (scope && scope->filter.bad) return false;   /* reported while parsing */
+    proc_filter_eval_init(&it->filter, scope ? &scope->filter : NULL);
+    if (!scope || scope->count == 0) {
+        it->proc = opendir("/proc");
+        if (!it->proc) {
+            perror("opendir /proc");
+            return false;
+        }
+        return true;
+    }
+
+    it->scoped = true;
+    size_t capacity = 0;
+    for (size_t i = 0; i < scope->count; i++) {
+        int fd = proc_scope_open_cgroup(scope->cgroups[i]);
+        if (fd < 0) {
+            fprintf(stderr, "cgroup '%s' not found\n", scope->cgroups[i]);
+            continue;
+        }
+        proc_scope_collect(fd, scope->threads ? "cgroup.threads" : "cgroup.procs",
+                           &it->pids, &it->pid_count, &capacity);
+        close(fd);
+    }
+
+    /* Overlapping paths list the same members twice */
+    qsort(it->pids, it->pid_count, sizeof(int), proc_scope_int_cmp);
+    size_t n = 0;
+    for (size_t i = 0; i < it->pid_count; i++) {
+        if (n == 0 || it->pids[i] != it->pids[n - 1]) it->pids[n++] = it->pids[i];
+    }
+    it->pid_count = n;
+    return true;
+}
+
+/* Continue a budgeted walk: only PIDs above pid (both walks yield PIDs in ascending order) */
+static inline void proc_iter_resume_after(ProcIter *it, int pid) {
+    it->resume_after = pid;
+}
+
+static inline bool proc_iter_open(ProcIter *it) {
+    return proc_iter_open_scope(it, NULL);
+}
+
+/* Next PID from the /proc walk or the cgroup member list, before filtering */
+static inline bool proc_iter_next_listed(ProcIter *it, int *pid) {
+    if (it->scoped) {
+        while (it->next < it->pid_count && it->pids[it->next] <= it->resume_after) it->next++;
+        if (it->next >= it->pid_count) return false;
+        *pid = it->pids[it->next++];
+        return true;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(it->proc)) != NULL) {
+        if (ent->d_type != DT_DIR) continue;
+        if (!isdigit((unsigned char)ent->d_name[0])) continue;
+
+        int p = atoi(ent->d_name);
+        if (p <= 0 || p <= it->resume_after) continue;
+        *pid = p;
+        return true;
+    }
+    return false;
+}
+
+/*
+   Next process with an open handle (caller closes it); false at end of /proc.
+   The filter runs on the dirfd before pidfd_open, and its stat read (if any)
+   also supplies starttime and comm.
+*/
+static inline bool proc_iter_next(ProcIter *it, ProcHandle *h) {
+    int pid;
+    while (proc_iter_next_listed(it, &pid)) {
+        if (!proc_handle_open_dir(h, pid)) continue;   /* vanished */
+
+        ProcFilterStat st = { .read = false };
+        if (!proc_filter_match(&it->filter, pid, h->dirfd, &st) ||
+            (!st.read && !proc_filter_read_stat_at(h->dirfd, &st)) || !st.ok) {
+            proc_handle_close(h);
+            continue;
+        }
+        h->starttime = st.starttime;
+        memcpy(h->comm, st.comm, sizeof(h->comm));
+        h->comm_read = true;
+        if (proc_handle_pin(h)) return true;   /* else vanished */
+    }
+    return false;
+}
+
+static inline void proc_iter_close(ProcIter *it) {
+    if (it->proc) closedir(it->proc);
+    free(it->pids);
+    proc_filter_eval_free(&it->filter);
+    memset(it, 0, sizeof(*it));
+}
+
+#endif /* SCANNER_PROC_HANDLE_H */
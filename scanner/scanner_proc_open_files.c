@@ -1,21 +1,71 @@
-/* scanner_proc_open_files.c - safer string handling + correct qsort comparator */
+/* scanner_proc_open_files.c - arena-backed targets + fd classification */
 #include <stdio.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
-#include <unistd.h>     /* for readlink */
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>     /* for readlinkat */
 #include <limits.h>     /* for PATH_MAX */
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_budget.h"
+
+/* What an fd points at, decided from the readlink target */
+typedef enum {
+    FD_FILE = 0,        /* path on a filesystem (regular file, dir, device...) */
+    FD_SOCKET,          /* socket:[ino] */
+    FD_PIPE,            /* pipe:[ino] */
+    FD_ANON_INODE,      /* anon_inode:[eventfd] etc. */
+    FD_MEMFD,           /* /memfd:name (deleted) */
+    FD_DELETED,         /* path with " (deleted)" suffix */
+    FD_OTHER,
+    FD_KIND_COUNT
+} FdKind;
+
+static const char *fd_kind_names[FD_KIND_COUNT] = {
+    "file", "socket", "pipe", "anon_inode", "memfd", "deleted", "other"
+};
+
+/* One descriptor; target lives in the scan arena */
+typedef struct {
+    int           fd;
+    unsigned char kind;       /* FdKind */
+    unsigned char has_fdinfo;
+    size_t        target_off; /* offset into arena */
+    unsigned long long pos;   /* fdinfo */
+    unsigned int  flags;      /* fdinfo, octal in procfs */
+    int           mnt_id;     /* fdinfo */
+} FdEntry;
 
 /* struct must be visible to comparator */
 typedef struct {
-    int   pid;
-    char  comm[17];           /* short process name */
-    char **files;             /* array of "fd:target_path" strings */
+    int    pid;
+    char   comm[17];           /* short process name */
+    size_t first;              /* index of first FdEntry of this process */
     size_t file_count;
-    size_t file_capacity;
+    size_t kind_count[FD_KIND_COUNT];
+    ProcAttr attr;             /* --ns / --group-by */
 } ProcOpenFiles;
 
+/* Everything allocated for one scan: a few large buffers instead of one malloc per fd */
+typedef struct {
+    char    *arena;            /* NUL-terminated targets back to back */
+    size_t   arena_len;
+    size_t   arena_cap;
+    FdEntry *fds;
+    size_t   fd_count;
+    size_t   fd_capacity;
+} ScanArena;
+
+typedef struct {
+    bool summary;              /* per-process counts only, no targets kept */
+    bool fdinfo;               /* attach pos/flags/mnt_id */
+    bool detail;               /* objects with type instead of "fd:target" strings */
+    ProcScope scope;           /* --cgroup: only these cgroups' members */
+} OpenFilesOptions;
+
 /* Comparator for qsort by PID (compare struct entries, safe) */
 static int pid_cmp(const void *a, const void *b) {
     const ProcOpenFiles *pa = (const ProcOpenFiles *)a;
@@ -23,129 +73,190 @@ static int pid_cmp(const void *a, const void *b) {
     return (pa->pid > pb->pid) - (pa->pid < pb->pid);
 }
 
-/* Helper: add fd:target string to ProcOpenFiles (allocates copy) */
-static void add_open_file(ProcOpenFiles *p, const char *fd_str, const char *target) {
-    if (!p || !fd_str || !target) return;
+/* Classify by first byte and fixed-length prefix/suffix checks, no strcmp over the target */
+static FdKind classify_target(const char *t, size_t len) {
+    static const char deleted_suffix[] = " (deleted)";
+    const size_t suffix_len = sizeof(deleted_suffix) - 1;
+
+    switch (t[0]) {
+    case '/':
+        if (len > 7 && memcmp(t, "/memfd:", 7) == 0) return FD_MEMFD;
+        if (len > suffix_len && memcmp(t + len - suffix_len, deleted_suffix, suffix_len) == 0) return FD_DELETED;
+        return FD_FILE;
+    case 's':
+        return (len > 7 && memcmp(t, "socket:", 7) == 0) ? FD_SOCKET : FD_OTHER;
+    case 'p':
+        return (len > 5 && memcmp(t, "pipe:", 5) == 0) ? FD_PIPE : FD_OTHER;
+    case 'a':
+        return (len > 11 && memcmp(t, "anon_inode:", 11) == 0) ? FD_ANON_INODE : FD_OTHER;
+    default:
+        return FD_OTHER;
+    }
+}
+
+/* Make room for one more fd and a PATH_MAX target at the arena tail */
+static bool arena_reserve(ScanArena *a) {
+    if (a->arena_len + PATH_MAX + 1 > a->arena_cap) {
+        size_t newcap = a->arena_cap ? a->arena_cap * 2 : (1 << 20);
+        while (newcap < a->arena_len + PATH_MAX + 1) newcap *= 2;
+        char *new_arena = realloc(a->arena, newcap);
+        if (!new_arena) return false;
+        a->arena = new_arena;
+        a->arena_cap = newcap;
+    }
+    if (a->fd_count >= a->fd_capacity) {
+        size_t newcap = a->fd_capacity ? a->fd_capacity * 2 : 65536;
+        FdEntry *new_fds = realloc(a->fds, newcap * sizeof(FdEntry));
+        if (!new_fds) return false;
+        a->fds = new_fds;
+        a->fd_capacity = newcap;
+    }
+    return true;
+}
+
+/* Parse pos/flags/mnt_id from /proc/<pid>/fdinfo/<fd> */
+static bool read_fdinfo(int fdinfo_dir, const char *fd_name, FdEntry *e) {
+    int fd = openat(fdinfo_dir, fd_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
 
-    size_t need = strlen(fd_str) + 1 + strlen(target) + 1; /* fd:target + NUL */
-    char *entry = malloc(need);
-    if (!entry) return;
+    char buf[512];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return false;
+    buf[n] = '\0';
 
-    /* snprintf won't overflow because entry is sized precisely */
-    snprintf(entry, need, "%s:%s", fd_str, target);
+    /* Only the first lines matter; eventfd/inotify extras follow */
+    for (char *line = buf; line && *line; ) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
 
-    if (p->file_count >= p->file_capacity) {
-        size_t newcap = p->file_capacity ? p->file_capacity * 2 : 128;
-        char **new_files = realloc(p->files, newcap * sizeof(char *));
-        if (!new_files) {
-            free(entry);
-            return;
+        if (strncmp(line, "pos:", 4) == 0) {
+            sscanf(line + 4, "%llu", &e->pos);
+        } else if (strncmp(line, "flags:", 6) == 0) {
+            sscanf(line + 6, "%o", &e->flags);
+        } else if (strncmp(line, "mnt_id:", 7) == 0) {
+            sscanf(line + 7, "%d", &e->mnt_id);
         }
-        p->files = new_files;
-        p->file_capacity = newcap;
+        line = next;
     }
-
-    p->files[p->file_count++] = entry;
+    return true;
 }
 
-static void free_procopenfiles(ProcOpenFiles *p) {
-    if (!p) return;
-    for (size_t i = 0; i < p->file_count; i++) {
-        free(p->files[i]);
+static void print_json_target(const char *target) {
+    for (const char *p = target; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
     }
-    free(p->files);
-    p->files = NULL;
-    p->file_count = p->file_capacity = 0;
 }
 
 /*
    Scanner: Open files per process (which process has which file open)
    For each process: list FD numbers and their target paths (via readlink /proc/pid/fd/N)
    Includes sockets/pipes/anon_inodes (e.g., "socket:[12345]") if no path.
+   Targets are read straight into one arena per scan; each fd is classified as
+   file/socket/pipe/anon_inode/memfd/deleted/other.
    Output: JSON array of {pid, comm, open_files: ["fd1:/path/to/file", "fd2:socket:[inode]", ...]}
+   With detail/fdinfo: open_files: [{fd, type, target[, pos, flags, mnt_id]}, ...]
+   With summary: {pid, comm, total, file, socket, pipe, anon_inode, memfd, deleted, other}
+   attrs adds namespace/cgroup/container columns or grouping (scanner_proc_attrs.h)
+   budget (scanner_budget.h) stops the walk at its limit, resuming after its cursor PID
+   fd/, fdinfo/, comm and attributes are all read through the process's ProcHandle
+   (scanner_proc_handle.h), so a recycled PID is never mixed in
    Note: requires root for other users' processes; skips inaccessible.
 */
-void scan_open_files_per_process(void)
+void scan_open_files_per_process(const OpenFilesOptions *opts, ProcAttrs *attrs, ScanBudget *budget)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, &opts->scope)) {
         return;
     }
+    proc_iter_resume_after(&it, budget_resume_pid(budget));
 
     ProcOpenFiles *procs = NULL;
     size_t capacity = 0;
     size_t count = 0;
+    ScanArena arena = { 0 };
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        if (budget_stop(budget)) {
+            proc_handle_close(&h);
+            break;
         }
+        budget_done_pid(budget, h.pid);   /* once started, a process is always finished */
 
         /* Open /proc/<pid>/fd */
-        char fd_path[64];
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
+        DIR *fddir = proc_handle_opendir(&h, "fd");
+        if (!fddir) {  /* no access or gone */
+            proc_handle_close(&h);
+            continue;
+        }
+        int fddir_fd = dirfd(fddir);
 
-        DIR *fddir = opendir(fd_path);
-        if (!fddir) continue;  /* no access or gone */
+        int fdinfo_dir = -1;
+        if (opts->fdinfo && !opts->summary) {
+            fdinfo_dir = openat(h.dirfd, "fdinfo", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
 
-        ProcOpenFiles info = { .pid = pid, .file_count = 0, .file_capacity = 0, .files = NULL };
-        /* use snprintf to copy comm safely and avoid strncpy truncation warning */
-        (void)snprintf(info.comm, sizeof(info.comm), "%s", comm);
-        info.comm[sizeof(info.comm)-1] = '\0';
+        ProcOpenFiles info;
+        memset(&info, 0, sizeof(info));
+        info.pid = h.pid;
+        info.first = arena.fd_count;
 
         struct dirent *fdent;
         while ((fdent = readdir(fddir)) != NULL) {
-            if (fdent->d_name[0] == '.' &&
-                (fdent->d_name[1] == '\0' || (fdent->d_name[1] == '.' && fdent->d_name[2] == '\0'))) continue;
-
-            /* Get target via readlink */
-            char link_path[128];
-            int needed = snprintf(link_path, sizeof(link_path), "/proc/%d/fd/%s", pid, fdent->d_name);
-            if (needed < 0 || needed >= (int)sizeof(link_path)) {
-                /* path unexpectedly long — skip this fd */
+            if (fdent->d_name[0] == '.') continue;   /* "." and ".." */
+            budget_throttle(budget);                 /* --max-core-pct inside processes with many fds */
+
+            if (opts->summary) {
+                /* Counts only: classify from a stack buffer, keep nothing */
+                char target[PATH_MAX + 1];
+                ssize_t tlen = readlinkat(fddir_fd, fdent->d_name, target, sizeof(target) - 1);
+                if (tlen <= 0) continue;
+                info.kind_count[classify_target(target, (size_t)tlen)]++;
+                info.file_count++;
                 continue;
             }
 
-            char target[PATH_MAX + 1];
-            ssize_t tlen = readlink(link_path, target, (sizeof(target) - 1));
-            if (tlen < 0) continue;
-            if (tlen >= (ssize_t)sizeof(target)) continue; /* too long — defensive */
+            if (!arena_reserve(&arena)) break;
+
+            /* Target goes straight into the arena tail */
+            char *target = arena.arena + arena.arena_len;
+            ssize_t tlen = readlinkat(fddir_fd, fdent->d_name, target, PATH_MAX);
+            if (tlen <= 0) continue;
             target[tlen] = '\0';
 
-            add_open_file(&info, fdent->d_name, target);
+            FdEntry *e = &arena.fds[arena.fd_count];
+            memset(e, 0, sizeof(*e));
+            e->fd = atoi(fdent->d_name);
+            e->kind = (unsigned char)classify_target(target, (size_t)tlen);
+            e->target_off = arena.arena_len;
+            e->mnt_id = -1;
+            if (fdinfo_dir >= 0) e->has_fdinfo = read_fdinfo(fdinfo_dir, fdent->d_name, e);
+
+            arena.arena_len += (size_t)tlen + 1;
+            arena.fd_count++;
+            info.kind_count[e->kind]++;
+            info.file_count++;
         }
+        if (fdinfo_dir >= 0) close(fdinfo_dir);
         closedir(fddir);
 
         if (info.file_count == 0) {
-            free_procopenfiles(&info);
+            proc_handle_close(&h);
             continue;
         }
 
+        /* use snprintf to copy comm safely and avoid strncpy truncation warning */
+        (void)snprintf(info.comm, sizeof(info.comm), "%s", proc_handle_comm(&h));
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, h.pid, &info.attr);
+        proc_handle_close(&h);
+
         /* Grow main array */
         if (count >= capacity) {
             size_t newcap = capacity ? capacity * 2 : 8192;
             ProcOpenFiles *new_procs = realloc(procs, newcap * sizeof(ProcOpenFiles));
-            if (!new_procs) {
-                free_procopenfiles(&info);
-                continue;
-            }
+            if (!new_procs) continue;
             procs = new_procs;
             capacity = newcap;
         }
@@ -153,48 +264,117 @@ void scan_open_files_per_process(void)
         procs[count++] = info;
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
 
     if (count == 0) {
         free(procs);
+        free(arena.arena);
+        free(arena.fds);
         printf("[]\n");
         return;
     }
 
-    /* Sort by PID using the safe comparator above */
+    /* Sort by PID using the safe comparator above (fd ranges stay valid) */
     qsort(procs, count, sizeof(ProcOpenFiles), pid_cmp);
+    proc_attrs_sort(attrs, procs, count, sizeof(ProcOpenFiles), offsetof(ProcOpenFiles, attr));
 
     /* === OUTPUT – replace this block with your DB insert === */
     printf("[\n");
     for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\",\"open_files\":[",
-               procs[i].pid, procs[i].comm);
-
-        for (size_t j = 0; j < procs[i].file_count; j++) {
-            printf("\"");
-            for (char *p = procs[i].files[j]; *p; p++) {
-                if (*p == '"' || *p == '\\') putchar('\\');
-                putchar(*p);
+        const ProcOpenFiles *p = &procs[i];
+        proc_attrs_row_sep(attrs, i ? &procs[i-1].attr : NULL, &p->attr);
+
+        if (opts->summary) {
+            printf("{\"pid\":%d,\"comm\":\"%s\",\"total\":%zu", p->pid, p->comm, p->file_count);
+            for (int k = 0; k < FD_KIND_COUNT; k++) {
+                printf(",\"%s\":%zu", fd_kind_names[k], p->kind_count[k]);
             }
-            printf("\"");
-            if (j < procs[i].file_count - 1) printf(",");
+            proc_attrs_print(attrs, &p->attr);
+            printf("}");
+            continue;
         }
 
-        printf("]}");
-        if (i < count - 1) printf(",");
-        printf("\n");
+        printf("{\"pid\":%d,\"comm\":\"%s\",\"open_files\":[", p->pid, p->comm);
+
+        for (size_t j = 0; j < p->file_count; j++) {
+            const FdEntry *e = &arena.fds[p->first + j];
+            const char *target = arena.arena + e->target_off;
+
+            if (opts->detail) {
+                printf("{\"fd\":%d,\"type\":\"%s\",\"target\":\"", e->fd, fd_kind_names[e->kind]);
+                print_json_target(target);
+                printf("\"");
+                if (e->has_fdinfo) {
+                    printf(",\"pos\":%llu,\"flags\":\"0%o\",\"mnt_id\":%d", e->pos, e->flags, e->mnt_id);
+                }
+                printf("}");
+            } else {
+                printf("\"%d:", e->fd);
+                print_json_target(target);
+                printf("\"");
+            }
+            if (j < p->file_count - 1) printf(",");
+        }
+
+        printf("]");
+        proc_attrs_print(attrs, &p->attr);
+        printf("}");
     }
+    proc_attrs_end(attrs, true);
     printf("]\n");
 
     /* Cleanup */
-    for (size_t i = 0; i < count; i++) {
-        free_procopenfiles(&procs[i]);
-    }
     free(procs);
+    free(arena.arena);
+    free(arena.fds);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_open_files_per_process();
+    OpenFilesOptions opts = { .summary = false, .fdinfo = false, .detail = false, .scope = { 0 } };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    ScanBudget budget;
+    budget_init(&budget);
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&opts.scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (budget_arg(&budget, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--summary") == 0) {
+            opts.summary = true;
+        } else if (strcmp(argv[i], "--fdinfo") == 0) {
+            opts.fdinfo = true;
+            opts.detail = true;
+        } else if (strcmp(argv[i], "--detail") == 0) {
+            opts.detail = true;
+        } else {
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s             # [\"fd:target\", ...] per process → JSON\n", argv[0]);
+            fprintf(stderr, "  %s --detail    # {fd, type, target} objects\n", argv[0]);
+            fprintf(stderr, "  %s --fdinfo    # detail + pos/flags/mnt_id from fdinfo\n", argv[0]);
+            fprintf(stderr, "  %s --summary   # per-process counts by type only\n", argv[0]);
+            fprintf(stderr, "  ... --budget-cpu-ms <ms> | --budget-wall-ms <ms> | --budget-io-kb <kb> | --max-core-pct <pct> --cursor <file>\n");
+            fprintf(stderr, "      # Stop at the budget and resume from the cursor next cycle; output gains coverage metadata\n");
+            fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+            fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+            fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+            fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+            fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+            fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+            return 1;
+        }
+    }
+
+    bool budgeted = budget_active(&budget);
+    budget_begin(&budget);
+    if (budgeted) printf("{\"rows\":");
+    scan_open_files_per_process(&opts, &attrs, &budget);
+    if (budgeted) {
+        budget_finish(&budget);
+        budget_print_coverage(&budget);
+    }
+    proc_scope_free(&opts.scope);
+    proc_attrs_free(&attrs);
     return 0;
 }
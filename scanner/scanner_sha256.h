@@ -0,0 +1,238 @@
+/*
+   scanner_sha256.h - SHA-256 of files plus a persistent (dev, inode) hash cache
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_file_hashes.c -o scanner_file_hashes -lcrypto
+
+   sha256_fd() / sha256_file() hash with the OpenSSL EVP API (not deprecated).
+   sha256_fd_progress() also calls back after every 64 KiB chunk (e.g. to throttle).
+
+   HashCache remembers digests across runs keyed by (dev, inode) and validated by
+   size, mtime and ctime: an unchanged file is never read again, and a file seen
+   through many paths or processes in one run is hashed once.
+       HashCache cache;
+       hash_cache_init(&cache);
+       hash_cache_load(&cache, file);             missing file = cold run
+       sha256_cached(&cache, fd, &st, hex)        st from fstat(fd) (or the same inode)
+       hash_cache_save(&cache, file);             entries used this run (all with keep_unseen); temp + rename
+       hash_cache_free(&cache);
+   Format (text, one entry per line):
+       H <dev> <inode> <size> <mtime_sec> <mtime_nsec> <ctime_sec> <ctime_nsec> <sha256>
+*/
+#ifndef SCANNER_SHA256_H
+#define SCANNER_SHA256_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+
+#define SHA256_HEX_LEN 64
+
+/* Hex SHA-256 of everything readable from fd (from its current offset); 0 or -1. progress (may be NULL) runs after each chunk */
+static inline int sha256_fd_progress(int fd, char hex[SHA256_HEX_LEN + 1], void (*progress)(void *), void *arg) {
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    if (!mdctx) return -1;
+    if (EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) != 1) {
+        EVP_MD_CTX_free(mdctx);
+        return -1;
+    }
+
+    unsigned char buffer[65536];
+    ssize_t len;
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (EVP_DigestUpdate(mdctx, buffer, (size_t)len) != 1) {
+            EVP_MD_CTX_free(mdctx);
+            return -1;
+        }
+        if (progress) progress(arg);
+    }
+    if (len < 0) {
+        EVP_MD_CTX_free(mdctx);
+        return -1;
+    }
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hash_len = 0;
+    if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1 || hash_len * 2 != SHA256_HEX_LEN) {
+        EVP_MD_CTX_free(mdctx);
+        return -1;
+    }
+    EVP_MD_CTX_free(mdctx);
+
+    static const char digits[] = "0123456789abcdef";
+    for (unsigned int i = 0; i < hash_len; i++) {
+        hex[i * 2] = digits[hash[i] >> 4];
+        hex[i * 2 + 1] = digits[hash[i] & 0xf];
+    }
+    hex[SHA256_HEX_LEN] = '\0';
+    return 0;
+}
+
+static inline int sha256_fd(int fd, char hex[SHA256_HEX_LEN + 1]) {
+    return sha256_fd_progress(fd, hex, NULL, NULL);
+}
+
+static inline int sha256_file(const char *path, char hex[SHA256_HEX_LEN + 1]) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = sha256_fd(fd, hex);
+    close(fd);
+    return rc;
+}
+
+typedef struct {
+    unsigned long long dev;
+    unsigned long long ino;
+    long long size;
+    struct timespec mtime;
+    struct timespec ctime;
+    char hex[SHA256_HEX_LEN + 1];
+    bool used;                /* slot taken */
+    bool seen;                /* looked up or stored this run: saved */
+} HashCacheEntry;
+
+typedef struct {
+    HashCacheEntry *slots;    /* open addressing on (dev, ino), power-of-two size */
+    size_t slot_mask;
+    size_t count;
+    size_t hits;              /* digests served without reading the file */
+    size_t misses;
+    bool keep_unseen;         /* save entries not looked up this run too (partial, budgeted walks) */
+    void (*progress)(void *); /* passed to sha256_fd_progress() on misses; NULL = none */
+    void *progress_arg;
+} HashCache;
+
+static inline void hash_cache_init(HashCache *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+static inline void hash_cache_free(HashCache *c) {
+    free(c->slots);
+    memset(c, 0, sizeof(*c));
+}
+
+static inline HashCacheEntry *hash_cache_slot(const HashCache *c, unsigned long long dev, unsigned long long ino) {
+    unsigned long long h = (ino * 0x9e3779b97f4a7c15ULL) ^ (dev * 0xc2b2ae3d27d4eb4fULL);
+    size_t i = (size_t)(h >> 17) & c->slot_mask;
+    while (c->slots[i].used && (c->slots[i].dev != dev || c->slots[i].ino != ino)) i = (i + 1) & c->slot_mask;
+    return &c->slots[i];
+}
+
+static inline bool hash_cache_grow(HashCache *c) {
+    size_t old_cap = c->slots ? c->slot_mask + 1 : 0;
+    size_t cap = old_cap ? old_cap * 2 : 1024;
+    HashCacheEntry *old = c->slots;
+
+    c->slots = calloc(cap, sizeof(HashCacheEntry));
+    if (!c->slots) {
+        c->slots = old;
+        return false;
+    }
+    c->slot_mask = cap - 1;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].used) *hash_cache_slot(c, old[i].dev, old[i].ino) = old[i];
+    }
+    free(old);
+    return true;
+}
+
+/* Slot for (dev, ino), inserted empty if absent; NULL on allocation failure */
+static inline HashCacheEntry *hash_cache_entry(HashCache *c, unsigned long long dev, unsigned long long ino) {
+    if ((c->count + 1) * 2 > (c->slots ? c->slot_mask + 1 : 0) && !hash_cache_grow(c)) return NULL;
+    HashCacheEntry *e = hash_cache_slot(c, dev, ino);
+    if (!e->used) {
+        memset(e, 0, sizeof(*e));
+        e->used = true;
+        e->dev = dev;
+        e->ino = ino;
+        c->count++;
+    }
+    return e;
+}
+
+static inline bool hash_cache_valid(const HashCacheEntry *e, const struct stat *st) {
+    return e->hex[0] && e->size == (long long)st->st_size &&
+           e->mtime.tv_sec == st->st_mtim.tv_sec && e->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           e->ctime.tv_sec == st->st_ctim.tv_sec && e->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+/* Digest of the file open as fd (st describes it): cached if unchanged, else read and remembered */
+static inline int sha256_cached(HashCache *c, int fd, const struct stat *st, char hex[SHA256_HEX_LEN + 1]) {
+    HashCacheEntry *e = hash_cache_entry(c, (unsigned long long)st->st_dev, (unsigned long long)st->st_ino);
+    if (e && hash_cache_valid(e, st)) {
+        e->seen = true;
+        c->hits++;
+        memcpy(hex, e->hex, sizeof(e->hex));
+        return 0;
+    }
+
+    c->misses++;
+    if (sha256_fd_progress(fd, hex, c->progress, c->progress_arg) != 0) return -1;
+    if (e) {
+        e->seen = true;
+        e->size = (long long)st->st_size;
+        e->mtime = st->st_mtim;
+        e->ctime = st->st_ctim;
+        memcpy(e->hex, hex, sizeof(e->hex));
+    }
+    return 0;
+}
+
+static inline void hash_cache_load(HashCache *c, const char *filename) {
+    FILE *f = fopen(filename, "re");
+    if (!f) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long dev, ino;
+        long long size;
+        long long ms, mn, cs, cn;
+        char hex[SHA256_HEX_LEN + 1];
+        if (sscanf(line, "H %llu %llu %lld %lld %lld %lld %lld %64s",
+                   &dev, &ino, &size, &ms, &mn, &cs, &cn, hex) != 8 || strlen(hex) != SHA256_HEX_LEN) {
+            continue;
+        }
+        HashCacheEntry *e = hash_cache_entry(c, dev, ino);
+        if (!e) break;
+        e->size = size;
+        e->mtime.tv_sec = (time_t)ms;
+        e->mtime.tv_nsec = (long)mn;
+        e->ctime.tv_sec = (time_t)cs;
+        e->ctime.tv_nsec = (long)cn;
+        memcpy(e->hex, hex, sizeof(e->hex));
+    }
+    fclose(f);
+}
+
+/* Keep only entries used this run, so files that went away age out (unless keep_unseen) */
+static inline int hash_cache_save(const HashCache *c, const char *filename) {
+    char tmp[PATH_MAX];
+    int needed = snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (needed < 0 || needed >= (int)sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "we");
+    if (!f) {
+        fprintf(stderr, "Cannot write hash cache '%s'\n", tmp);
+        return -1;
+    }
+    for (size_t i = 0; c->slots && i <= c->slot_mask; i++) {
+        const HashCacheEntry *e = &c->slots[i];
+        if (!e->used || (!e->seen && !c->keep_unseen) || !e->hex[0]) continue;
+        fprintf(f, "H %llu %llu %lld %lld %ld %lld %ld %s\n", e->dev, e->ino, e->size,
+                (long long)e->mtime.tv_sec, e->mtime.tv_nsec,
+                (long long)e->ctime.tv_sec, e->ctime.tv_nsec, e->hex);
+    }
+    if (fclose(f) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return rename(tmp, filename);
+}
+
+#endif /* SCANNER_SHA256_H */
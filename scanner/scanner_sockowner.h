@@ -0,0 +1,500 @@
+/*
+   scanner_sockowner.h - socket inode → owning PID resolution for the socket scanners
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_tcp_sources.c -o scanner_tcp_sources
+
+   One walk of /proc/<pid>/fd builds an inode → (pid, fd) hash table.
+   With a cache file (sockowner_cache_load / sockowner_cache_save) the walk becomes
+   incremental across runs:
+     - each process is keyed by (pid, starttime) so PID reuse is detected
+     - its fd table is only re-read when the process is new or its fd count changed
+       (st_size of /proc/<pid>/fd, O(1) on Linux >= 6.2; older kernels always re-read)
+     - inodes still unknown after that are resolved on demand by re-reading the
+       cached processes, stopping as soon as all are found
+     - inodes that no process holds are remembered so they do not trigger that
+       fallback again on the next run
+   A cached mapping is trusted while (pid, starttime, fd count) is unchanged.
+   All per-process reads go through a ProcHandle (scanner_proc_handle.h), so a
+   PID recycled mid-scan is never mixed into another process's entry.
+
+   Cache file format (text, one record per line):
+       P <pid> <starttime> <fd_count>
+       S <inode> <fd>          (sockets of the preceding P line)
+       N <inode>               (inode with no owner)
+*/
+#ifndef SCANNER_SOCKOWNER_H
+#define SCANNER_SOCKOWNER_H
+
+#include <stdio.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>     /* for readlinkat */
+#include <limits.h>     /* for PATH_MAX */
+#include <sys/stat.h>
+#include "scanner_proc_handle.h"
+
+typedef struct {
+    unsigned long ino;
+    int           fd;
+} SockOwnerSocket;
+
+typedef struct {
+    int    pid;
+    unsigned long long starttime;  /* /proc/<pid>/stat field 22 */
+    long   fd_count;               /* st_size of /proc/<pid>/fd, -1 if not reported */
+    bool   scanned;                /* fd table re-read during this run */
+    bool   comm_read;
+    char   comm[17];               /* read lazily, only for processes that own a wanted socket */
+    SockOwnerSocket *socks;
+    size_t sock_count;
+    size_t sock_capacity;
+} SockOwnerProc;
+
+/* Hash slot: inode → owner; further owners of the same inode chain through 'next' */
+typedef struct {
+    unsigned long ino;      /* 0 = empty slot */
+    unsigned int  proc;     /* index into procs[] */
+    int           fd;
+    int           next;     /* index into extra[] or -1 */
+} SockOwnerSlot;
+
+typedef struct {
+    unsigned int proc;
+    int          fd;
+    int          next;
+} SockOwnerExtra;
+
+typedef struct {
+    SockOwnerProc  *procs;          /* sorted by pid */
+    size_t          proc_count;
+    SockOwnerSlot  *slots;          /* open addressing, power-of-two size */
+    size_t          slot_mask;
+    SockOwnerExtra *extra;
+    size_t          extra_count;
+    size_t          extra_capacity;
+    unsigned long  *no_owner;       /* sorted inodes nobody holds */
+    size_t          no_owner_count;
+    bool            fd_size_ok;     /* kernel reports fd count in st_size */
+} SockOwnerCache;
+
+/* Iterator over all owners of one inode */
+typedef struct {
+    int          pid;
+    int          fd;
+    const char  *comm;
+    int          next;   /* internal */
+} SockOwner;
+
+static inline int sockowner_pid_cmp(const void *a, const void *b) {
+    const SockOwnerProc *pa = a;
+    const SockOwnerProc *pb = b;
+    return (pa->pid > pb->pid) - (pa->pid < pb->pid);
+}
+
+static inline int sockowner_ulong_cmp(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+    return (x > y) - (x < y);
+}
+
+static inline size_t sockowner_hash(unsigned long ino) {
+    /* 64-bit mix (splitmix64 finaliser) – inodes are sequential, spread them */
+    unsigned long long x = ino;
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (size_t)x;
+}
+
+static inline void sockowner_add_socket(SockOwnerProc *p, unsigned long ino, int fd) {
+    if (p->sock_count >= p->sock_capacity) {
+        size_t newcap = p->sock_capacity ? p->sock_capacity * 2 : 16;
+        SockOwnerSocket *s = realloc(p->socks, newcap * sizeof(SockOwnerSocket));
+        if (!s) return;
+        p->socks = s;
+        p->sock_capacity = newcap;
+    }
+    p->socks[p->sock_count].ino = ino;
+    p->socks[p->sock_count].fd = fd;
+    p->sock_count++;
+}
+
+static inline void sockowner_free_proc(SockOwnerProc *p) {
+    free(p->socks);
+    p->socks = NULL;
+    p->sock_count = p->sock_capacity = 0;
+}
+
+/* Number of open fds from st_size of /proc/<pid>/fd; -1 if unavailable */
+static inline long sockowner_fd_count(const SockOwnerCache *c, const ProcHandle *h) {
+    if (!c->fd_size_ok) return -1;
+    struct stat st;
+    if (fstatat(h->dirfd, "fd", &st, 0) < 0) return -1;
+    return (long)st.st_size;
+}
+
+/* Re-read the fd table of h and keep only socket:[inode] targets */
+static inline void sockowner_scan_fds(SockOwnerProc *p, const ProcHandle *h) {
+    p->sock_count = 0;
+    p->scanned = true;
+
+    DIR *fddir = proc_handle_opendir(h, "fd");
+    if (!fddir) return;
+
+    struct dirent *fdent;
+    while ((fdent = readdir(fddir)) != NULL) {
+        if (!isdigit((unsigned char)fdent->d_name[0])) continue;
+
+        char target[64];
+        ssize_t tlen = readlinkat(dirfd(fddir), fdent->d_name, target, sizeof(target) - 1);
+        if (tlen < 0) continue;
+        target[tlen] = '\0';
+
+        /* Check if socket:[inode] */
+        unsigned long ino;
+        if (sscanf(target, "socket:[%lu]", &ino) != 1 || ino == 0) continue;
+
+        sockowner_add_socket(p, ino, atoi(fdent->d_name));
+    }
+    closedir(fddir);
+}
+
+/* Re-pin a cached process; false (and no sockets) if its PID now belongs to someone else */
+static inline bool sockowner_rescan(SockOwnerProc *p) {
+    ProcHandle h;
+    if (!proc_handle_open(&h, p->pid)) {
+        p->sock_count = 0;
+        p->scanned = true;
+        return false;
+    }
+    bool same = h.starttime == p->starttime;
+    if (same) {
+        sockowner_scan_fds(p, &h);
+    } else {
+        p->sock_count = 0;
+        p->scanned = true;
+    }
+    proc_handle_close(&h);
+    return same;
+}
+
+static inline void sockowner_index_insert(SockOwnerCache *c, unsigned long ino, unsigned int proc, int fd) {
+    size_t i = sockowner_hash(ino) & c->slot_mask;
+    while (c->slots[i].ino != 0 && c->slots[i].ino != ino) i = (i + 1) & c->slot_mask;
+
+    if (c->slots[i].ino == 0) {
+        c->slots[i].ino = ino;
+        c->slots[i].proc = proc;
+        c->slots[i].fd = fd;
+        c->slots[i].next = -1;
+        return;
+    }
+
+    /* Shared socket (fork, SCM_RIGHTS): chain additional owner */
+    if (c->extra_count >= c->extra_capacity) {
+        size_t newcap = c->extra_capacity ? c->extra_capacity * 2 : 256;
+        SockOwnerExtra *e = realloc(c->extra, newcap * sizeof(SockOwnerExtra));
+        if (!e) return;
+        c->extra = e;
+        c->extra_capacity = newcap;
+    }
+    SockOwnerExtra *e = &c->extra[c->extra_count];
+    e->proc = proc;
+    e->fd = fd;
+    e->next = -1;
+
+    /* Append at the tail so owners stay in ascending pid order */
+    int *link = &c->slots[i].next;
+    while (*link >= 0) link = &c->extra[*link].next;
+    *link = (int)c->extra_count++;
+}
+
+static inline const SockOwnerSlot *sockowner_find_slot(const SockOwnerCache *c, unsigned long ino) {
+    if (!c->slots || ino == 0) return NULL;
+    size_t i = sockowner_hash(ino) & c->slot_mask;
+    while (c->slots[i].ino != 0) {
+        if (c->slots[i].ino == ino) return &c->slots[i];
+        i = (i + 1) & c->slot_mask;
+    }
+    return NULL;
+}
+
+/* Rebuild the inode index from procs[] */
+static inline void sockowner_reindex(SockOwnerCache *c) {
+    size_t total = 0;
+    for (size_t i = 0; i < c->proc_count; i++) total += c->procs[i].sock_count;
+
+    size_t size = 1024;
+    while (size < total * 2) size *= 2;
+
+    free(c->slots);
+    c->slots = calloc(size, sizeof(SockOwnerSlot));
+    c->slot_mask = c->slots ? size - 1 : 0;
+    c->extra_count = 0;
+    if (!c->slots) return;
+
+    for (size_t i = 0; i < c->proc_count; i++) {
+        for (size_t j = 0; j < c->procs[i].sock_count; j++) {
+            sockowner_index_insert(c, c->procs[i].socks[j].ino, (unsigned int)i, c->procs[i].socks[j].fd);
+        }
+    }
+}
+
+static inline void sockowner_cache_init(SockOwnerCache *c) {
+    memset(c, 0, sizeof(*c));
+    struct stat st;
+    c->fd_size_ok = (stat("/proc/self/fd", &st) == 0 && st.st_size > 0);
+}
+
+static inline void sockowner_cache_free(SockOwnerCache *c) {
+    for (size_t i = 0; i < c->proc_count; i++) sockowner_free_proc(&c->procs[i]);
+    free(c->procs);
+    free(c->slots);
+    free(c->extra);
+    free(c->no_owner);
+    memset(c, 0, sizeof(*c));
+}
+
+/* Load previous run's cache; a missing or unreadable file just means a cold start */
+static inline void sockowner_cache_load(SockOwnerCache *c, const char *filename) {
+    FILE *f = fopen(filename, "re");
+    if (!f) return;
+
+    size_t capacity = 0;
+    size_t no_owner_capacity = 0;
+    char line[128];
+    SockOwnerProc *cur = NULL;
+
+    while (fgets(line, sizeof(line), f)) {
+        int pid, fd;
+        unsigned long long starttime;
+        long fd_count;
+        unsigned long ino;
+
+        if (sscanf(line, "P %d %llu %ld", &pid, &starttime, &fd_count) == 3) {
+            if (c->proc_count >= capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                SockOwnerProc *np = realloc(c->procs, capacity * sizeof(SockOwnerProc));
+                if (!np) break;
+                c->procs = np;
+            }
+            cur = &c->procs[c->proc_count++];
+            memset(cur, 0, sizeof(*cur));
+            cur->pid = pid;
+            cur->starttime = starttime;
+            cur->fd_count = fd_count;
+        } else if (sscanf(line, "S %lu %d", &ino, &fd) == 2 && cur) {
+            sockowner_add_socket(cur, ino, fd);
+        } else if (sscanf(line, "N %lu", &ino) == 1) {
+            if (c->no_owner_count >= no_owner_capacity) {
+                no_owner_capacity = no_owner_capacity ? no_owner_capacity * 2 : 256;
+                unsigned long *nn = realloc(c->no_owner, no_owner_capacity * sizeof(unsigned long));
+                if (!nn) break;
+                c->no_owner = nn;
+            }
+            c->no_owner[c->no_owner_count++] = ino;
+        }
+    }
+    fclose(f);
+
+    qsort(c->procs, c->proc_count, sizeof(SockOwnerProc), sockowner_pid_cmp);
+    qsort(c->no_owner, c->no_owner_count, sizeof(unsigned long), sockowner_ulong_cmp);
+}
+
+/* Write cache for the next run (via temp file + rename so a crash never leaves half a cache) */
+static inline int sockowner_cache_save(const SockOwnerCache *c, const char *filename) {
+    char tmp[PATH_MAX];
+    int needed = snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (needed < 0 || needed >= (int)sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "we");
+    if (!f) {
+        fprintf(stderr, "Cannot write owner cache '%s'\n", tmp);
+        return -1;
+    }
+
+    for (size_t i = 0; i < c->proc_count; i++) {
+        const SockOwnerProc *p = &c->procs[i];
+        fprintf(f, "P %d %llu %ld\n", p->pid, p->starttime, p->fd_count);
+        for (size_t j = 0; j < p->sock_count; j++) {
+            fprintf(f, "S %lu %d\n", p->socks[j].ino, p->socks[j].fd);
+        }
+    }
+    for (size_t i = 0; i < c->no_owner_count; i++) {
+        fprintf(f, "N %lu\n", c->no_owner[i]);
+    }
+
+    if (fclose(f) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return rename(tmp, filename);
+}
+
+/*
+   Bring the cache up to date for this run and make sure every inode in
+   wanted[] is resolved if any process holds it.
+   wanted[] may contain duplicates and inode 0 (ignored).
+*/
+static inline void sockowner_refresh(SockOwnerCache *c, const unsigned long *wanted, size_t wanted_count) {
+    SockOwnerProc *procs = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    ProcIter it;
+    if (!proc_iter_open(&it)) return;
+
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        int pid = h.pid;
+        unsigned long long starttime = h.starttime;
+        long fd_count = sockowner_fd_count(c, &h);
+
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 8192;
+            SockOwnerProc *np = realloc(procs, capacity * sizeof(SockOwnerProc));
+            if (!np) {
+                proc_handle_close(&h);
+                break;
+            }
+            procs = np;
+        }
+
+        SockOwnerProc *p = &procs[count];
+        SockOwnerProc key = { .pid = pid };
+        SockOwnerProc *old = bsearch(&key, c->procs, c->proc_count, sizeof(SockOwnerProc), sockowner_pid_cmp);
+
+        if (old && old->starttime == starttime) {
+            /* Same process as last run: take over its socket list */
+            *p = *old;
+            old->socks = NULL;
+            old->sock_count = old->sock_capacity = 0;
+            p->scanned = false;
+            p->comm_read = false;
+            if (fd_count < 0 || fd_count != p->fd_count) {
+                p->fd_count = fd_count;
+                sockowner_scan_fds(p, &h);
+            }
+        } else {
+            memset(p, 0, sizeof(*p));
+            p->pid = pid;
+            p->starttime = starttime;
+            p->fd_count = fd_count;
+            sockowner_scan_fds(p, &h);
+        }
+        proc_handle_close(&h);
+        count++;
+    }
+    proc_iter_close(&it);
+
+    /* Processes gone since last run */
+    for (size_t i = 0; i < c->proc_count; i++) sockowner_free_proc(&c->procs[i]);
+    free(c->procs);
+
+    qsort(procs, count, sizeof(SockOwnerProc), sockowner_pid_cmp);
+    c->procs = procs;
+    c->proc_count = count;
+    sockowner_reindex(c);
+
+    /* Wanted inodes nobody claimed (sorted, unique) */
+    unsigned long *missing = NULL;
+    size_t missing_count = 0;
+    size_t missing_capacity = 0;
+    for (size_t i = 0; i < wanted_count; i++) {
+        if (wanted[i] == 0 || sockowner_find_slot(c, wanted[i])) continue;
+        if (missing_count >= missing_capacity) {
+            missing_capacity = missing_capacity ? missing_capacity * 2 : 256;
+            unsigned long *nm = realloc(missing, missing_capacity * sizeof(unsigned long));
+            if (!nm) break;
+            missing = nm;
+        }
+        missing[missing_count++] = wanted[i];
+    }
+    qsort(missing, missing_count, sizeof(unsigned long), sockowner_ulong_cmp);
+    size_t n = 0;
+    for (size_t i = 0; i < missing_count; i++) {
+        if (n == 0 || missing[i] != missing[n - 1]) missing[n++] = missing[i];
+    }
+    missing_count = n;
+
+    /* Known orphans are skipped, the rest trigger on-demand rescans */
+    bool *found = calloc(missing_count ? missing_count : 1, sizeof(bool));
+    size_t unknown = 0;
+    for (size_t i = 0; found && i < missing_count; i++) {
+        if (bsearch(&missing[i], c->no_owner, c->no_owner_count, sizeof(unsigned long), sockowner_ulong_cmp))
+            found[i] = true;
+        else
+            unknown++;
+    }
+
+    if (unknown > 0) {
+        /* Some cached fd table is stale (same fd count, different sockets): re-read until found */
+        for (size_t i = 0; i < c->proc_count && unknown > 0; i++) {
+            SockOwnerProc *p = &c->procs[i];
+            if (p->scanned) continue;
+            sockowner_rescan(p);
+            for (size_t j = 0; j < p->sock_count; j++) {
+                unsigned long *m = bsearch(&p->socks[j].ino, missing, missing_count,
+                                           sizeof(unsigned long), sockowner_ulong_cmp);
+                if (m && !found[m - missing]) {
+                    found[m - missing] = true;
+                    unknown--;
+                }
+            }
+        }
+        sockowner_reindex(c);
+    }
+    free(found);
+
+    /* Remember this run's orphans (only those still wanted, so the list cannot grow forever) */
+    n = 0;
+    for (size_t i = 0; i < missing_count; i++) {
+        if (!sockowner_find_slot(c, missing[i])) missing[n++] = missing[i];
+    }
+    free(c->no_owner);
+    c->no_owner = missing;
+    c->no_owner_count = n;
+}
+
+/* Comm of an owning process, read on first use ("[unknown]" if its PID was reused since the walk) */
+static inline const char *sockowner_comm(SockOwnerCache *c, unsigned int proc) {
+    SockOwnerProc *p = &c->procs[proc];
+    if (!p->comm_read) {
+        snprintf(p->comm, sizeof(p->comm), "%s", "[unknown]");
+        ProcHandle h;
+        if (proc_handle_open(&h, p->pid)) {
+            if (h.starttime == p->starttime) snprintf(p->comm, sizeof(p->comm), "%s", proc_handle_comm(&h));
+            proc_handle_close(&h);
+        }
+        p->comm_read = true;
+    }
+    return p->comm;
+}
+
+/* First owner of an inode (lowest pid); returns false if nobody holds it */
+static inline bool sockowner_first(SockOwnerCache *c, unsigned long ino, SockOwner *out) {
+    const SockOwnerSlot *s = sockowner_find_slot(c, ino);
+    if (!s) return false;
+    out->pid = c->procs[s->proc].pid;
+    out->fd = s->fd;
+    out->comm = sockowner_comm(c, s->proc);
+    out->next = s->next;
+    return true;
+}
+
+/* Next owner of the same inode (shared listen sockets, pre-fork servers) */
+static inline bool sockowner_next(SockOwnerCache *c, SockOwner *it) {
+    if (it->next < 0) return false;
+    const SockOwnerExtra *e = &c->extra[it->next];
+    it->pid = c->procs[e->proc].pid;
+    it->fd = e->fd;
+    it->comm = sockowner_comm(c, e->proc);
+    it->next = e->next;
+    return true;
+}
+
+#endif /* SCANNER_SOCKOWNER_H */
@@ -3,6 +3,11 @@
                         #include <stdlib.h>
                         #include <ctype.h>
                         #include <string.h>
+                        #include <stdbool.h>
+                        #include <fcntl.h>
+                        #include <unistd.h>     /* for pread */
+                        #include <time.h>       /* for clock_gettime, clock_nanosleep */
+                        #include <sys/resource.h> /* for RLIMIT_NOFILE */
 
                         /* Comparator for qsort by PID */
                         static int pid_cmp(const void *a, const void *b) {
@@ -134,8 +139,569 @@
                             free(states);
                         }
 
-                        int main(void)
+                        /* ---- D-state stall sampler (--dstate) ---- */
+
+                        #define STALL_BUCKETS   10
+                        #define MAX_WCHANS      8        /* distinct wait sites kept per thread */
+
+                        /* Upper bounds (ms) of the stall-time histogram; the last bucket is open-ended */
+                        static const unsigned stall_bounds_ms[STALL_BUCKETS - 1] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+                        typedef struct {
+                            bool        dstate;          /* sample mode on */
+                            unsigned    duration_ms;     /* how long to sample */
+                            unsigned    hz;              /* samples per second per candidate */
+                            unsigned    max_threads;     /* candidates with an open stat fd */
+                            unsigned    rescan_ms;       /* minimum full pass interval (new threads, candidate refresh) */
+                            double      budget_pct;      /* own CPU budget: full passes are spaced out, candidates halved */
+                            bool        stack;           /* also read /proc/<tid>/stack at stall start (root) */
+                        } StateSampleOptions;
+
+                        typedef struct {
+                            char     wchan[64];
+                            char    *stack;              /* folded "f1;f2;..." of the first stall here, or NULL */
+                            unsigned stalls;
+                            unsigned long long stall_us;
+                        } WaitSite;
+
+                        /* One sampled thread; kept after it stops being a candidate so its stalls are reported */
+                        typedef struct {
+                            int      pid;
+                            int      tid;
+                            unsigned long long starttime;  /* with tid: identity across passes */
+                            char     comm[17];
+                            int      fd;                 /* open /proc/<pid>/task/<tid>/stat, -1 when not sampled */
+                            bool     in_stall;
+                            unsigned long long stall_start_us;
+                            int      stall_site;         /* index in sites[] of the running stall, -1 unknown */
+                            unsigned long long samples;
+                            unsigned long long d_samples;
+                            unsigned stalls;
+                            unsigned long long stall_us;
+                            unsigned long long max_stall_us;
+                            unsigned hist[STALL_BUCKETS];
+                            WaitSite sites[MAX_WCHANS];
+                            unsigned site_count;
+                        } ThreadSampler;
+
+                        /* Full-pass result for one thread */
+                        typedef struct {
+                            int      pid;
+                            int      tid;
+                            unsigned long long starttime;
+                            char     comm[17];
+                            char     state;
+                            unsigned long long blkio_ticks;  /* stat field 42: aggregated block I/O delay (0 without delay accounting) */
+                            unsigned long long d_samples;    /* D samples of this thread so far in the run */
+                        } ThreadInfo;
+
+                        static unsigned long long mono_us(void) {
+                            struct timespec ts;
+                            clock_gettime(CLOCK_MONOTONIC, &ts);
+                            return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+                        }
+
+                        static unsigned long long cpu_us(void) {
+                            struct timespec ts;
+                            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+                            return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+                        }
+
+                        /* Parse state, starttime (22) and delayacct_blkio_ticks (42) from a stat line; comm may contain ')' */
+                        static bool parse_thread_stat(const char *buf, ThreadInfo *t) {
+                            const char *open = strchr(buf, '(');
+                            const char *close = strrchr(buf, ')');
+                            if (!open || !close || close < open || close[1] != ' ') return false;
+
+                            size_t comm_len = (size_t)(close - open - 1);
+                            if (comm_len >= sizeof(t->comm)) comm_len = sizeof(t->comm) - 1;
+                            memcpy(t->comm, open + 1, comm_len);
+                            t->comm[comm_len] = '\0';
+                            t->state = close[2];
+
+                            /* Fields after comm start at 3 (state) */
+                            const char *p = close + 2;
+                            for (int field = 3; *p; field++) {
+                                if (field == 22) t->starttime = strtoull(p, NULL, 10);
+                                if (field == 42) {
+                                    t->blkio_ticks = strtoull(p, NULL, 10);
+                                    break;
+                                }
+                                p = strchr(p, ' ');
+                                if (!p) break;
+                                p++;
+                            }
+                            return true;
+                        }
+
+                        /* State char of an open stat fd; 0 once the thread is gone */
+                        static char sample_state(int fd) {
+                            char buf[512];
+                            ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+                            if (n <= 0) return 0;
+                            buf[n] = '\0';
+                            const char *close = strrchr(buf, ')');
+                            return close && close[1] == ' ' ? close[2] : 0;
+                        }
+
+                        /* One pass over /proc/<pid>/task/<tid>/stat for every thread */
+                        static ThreadInfo *walk_threads(size_t *out_count) {
+                            ThreadInfo *threads = NULL;
+                            size_t capacity = 0, count = 0;
+                            *out_count = 0;
+
+                            DIR *proc = opendir("/proc");
+                            if (!proc) return NULL;
+
+                            struct dirent *ent;
+                            while ((ent = readdir(proc)) != NULL) {
+                                if (!isdigit((unsigned char)ent->d_name[0])) continue;
+                                int pid = atoi(ent->d_name);
+
+                                char path[64];
+                                snprintf(path, sizeof(path), "/proc/%d/task", pid);
+                                DIR *task = opendir(path);
+                                if (!task) continue;
+
+                                struct dirent *tent;
+                                while ((tent = readdir(task)) != NULL) {
+                                    if (!isdigit((unsigned char)tent->d_name[0])) continue;
+
+                                    int tid = atoi(tent->d_name);
+                                    char stat_path[96];
+                                    snprintf(stat_path, sizeof(stat_path), "/proc/%d/task/%d/stat", pid, tid);
+                                    int fd = open(stat_path, O_RDONLY | O_CLOEXEC);
+                                    if (fd < 0) continue;
+                                    char buf[1024];
+                                    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+                                    close(fd);
+                                    if (n <= 0) continue;
+                                    buf[n] = '\0';
+
+                                    if (count >= capacity) {
+                                        capacity = capacity ? capacity * 2 : 8192;
+                                        ThreadInfo *new_threads = realloc(threads, capacity * sizeof(ThreadInfo));
+                                        if (!new_threads) break;
+                                        threads = new_threads;
+                                    }
+                                    ThreadInfo *t = &threads[count];
+                                    memset(t, 0, sizeof(*t));
+                                    t->pid = pid;
+                                    t->tid = tid;
+                                    if (parse_thread_stat(buf, t)) count++;
+                                }
+                                closedir(task);
+                            }
+                            closedir(proc);
+
+                            *out_count = count;
+                            return threads;
+                        }
+
+                        /* Rotation cursor: among otherwise equal threads, TIDs after this one come first */
+                        static int rotate_after;
+
+                        /*
+                           Candidates first: in D now, then seen in D earlier in this run, then by block I/O delay
+                           (stat field 42, only non-zero with kernel.task_delayacct=1). The rest tie and are taken
+                           in TID order starting after rotate_after, so successive passes cycle through all threads.
+                        */
+                        static int candidate_cmp(const void *a, const void *b) {
+                            const ThreadInfo *x = a, *y = b;
+                            bool dx = x->state == 'D', dy = y->state == 'D';
+                            if (dx != dy) return dx ? -1 : 1;
+                            if (x->d_samples != y->d_samples) return x->d_samples > y->d_samples ? -1 : 1;
+                            if (x->blkio_ticks != y->blkio_ticks) return x->blkio_ticks > y->blkio_ticks ? -1 : 1;
+                            unsigned rx = (unsigned)x->tid - (unsigned)rotate_after - 1u;
+                            unsigned ry = (unsigned)y->tid - (unsigned)rotate_after - 1u;
+                            return (rx > ry) - (rx < ry);
+                        }
+
+                        static int sampler_cmp(const void *a, const void *b) {
+                            const ThreadSampler *x = a, *y = b;
+                            if (x->tid != y->tid) return x->tid < y->tid ? -1 : 1;
+                            return (x->starttime > y->starttime) - (x->starttime < y->starttime);
+                        }
+
+                        /* First line of a small /proc file, without the newline */
+                        static void read_task_file(const ThreadSampler *s, const char *name, char *buf, size_t size) {
+                            char path[96];
+                            snprintf(path, sizeof(path), "/proc/%d/task/%d/%s", s->pid, s->tid, name);
+                            buf[0] = '\0';
+                            int fd = open(path, O_RDONLY | O_CLOEXEC);
+                            if (fd < 0) return;
+                            ssize_t n = read(fd, buf, size - 1);
+                            close(fd);
+                            buf[n > 0 ? n : 0] = '\0';
+                        }
+
+                        /* "[<0>] io_schedule+0x12/0x40\n..." → "io_schedule;..." */
+                        static char *fold_stack(const char *raw) {
+                            size_t len = strlen(raw);
+                            char *out = malloc(len + 1);
+                            if (!out) return NULL;
+                            size_t o = 0;
+                            for (const char *line = raw; *line; ) {
+                                const char *eol = strchr(line, '\n');
+                                if (!eol) eol = line + strlen(line);
+                                const char *sym = memchr(line, ']', (size_t)(eol - line));
+                                sym = sym ? sym + 1 : line;
+                                while (sym < eol && *sym == ' ') sym++;
+                                const char *end = sym;
+                                while (end < eol && *end != '+' && *end != ' ') end++;
+                                if (end > sym) {
+                                    if (o) out[o++] = ';';
+                                    memcpy(out + o, sym, (size_t)(end - sym));
+                                    o += (size_t)(end - sym);
+                                }
+                                line = *eol ? eol + 1 : eol;
+                            }
+                            out[o] = '\0';
+                            return out;
+                        }
+
+                        /* Stall begins: look up where the thread is waiting (once per stall) */
+                        static void stall_begin(ThreadSampler *s, unsigned long long now, bool want_stack) {
+                            s->in_stall = true;
+                            s->stall_start_us = now;
+                            s->stall_site = -1;
+
+                            char wchan[64];
+                            read_task_file(s, "wchan", wchan, sizeof(wchan));
+
+                            /* wchan reads "0" on some kernels/configs: the innermost stack frame names the site instead */
+                            char *stack = NULL;
+                            bool have_wchan = wchan[0] && strcmp(wchan, "0") != 0;
+                            if (want_stack && !have_wchan) {
+                                char raw[4096];
+                                read_task_file(s, "stack", raw, sizeof(raw));
+                                stack = raw[0] ? fold_stack(raw) : NULL;
+                                if (stack && stack[0]) {
+                                    size_t len = strcspn(stack, ";");
+                                    snprintf(wchan, sizeof(wchan), "%.*s", (int)(len < sizeof(wchan) - 1 ? len : sizeof(wchan) - 1), stack);
+                                    have_wchan = true;
+                                }
+                            }
+                            if (!have_wchan) snprintf(wchan, sizeof(wchan), "?");
+
+                            for (unsigned i = 0; i < s->site_count; i++) {
+                                if (strcmp(s->sites[i].wchan, wchan) == 0) {
+                                    s->stall_site = (int)i;
+                                    free(stack);
+                                    return;
+                                }
+                            }
+                            if (s->site_count >= MAX_WCHANS) {
+                                free(stack);
+                                return;
+                            }
+
+                            WaitSite *w = &s->sites[s->site_count];
+                            memset(w, 0, sizeof(*w));
+                            snprintf(w->wchan, sizeof(w->wchan), "%s", wchan);
+                            if (want_stack && !stack) {
+                                char raw[4096];
+                                read_task_file(s, "stack", raw, sizeof(raw));
+                                if (raw[0]) stack = fold_stack(raw);
+                            }
+                            w->stack = stack;
+                            s->stall_site = (int)s->site_count++;
+                        }
+
+                        /* Stall ends (thread left D, or sampling stops): account its duration */
+                        static void stall_end(ThreadSampler *s, unsigned long long now) {
+                            if (!s->in_stall) return;
+                            s->in_stall = false;
+                            unsigned long long us = now - s->stall_start_us;
+
+                            s->stalls++;
+                            s->stall_us += us;
+                            if (us > s->max_stall_us) s->max_stall_us = us;
+                            unsigned b = 0;
+                            while (b < STALL_BUCKETS - 1 && us > (unsigned long long)stall_bounds_ms[b] * 1000ULL) b++;
+                            s->hist[b]++;
+                            if (s->stall_site >= 0) {
+                                s->sites[s->stall_site].stalls++;
+                                s->sites[s->stall_site].stall_us += us;
+                            }
+                        }
+
+                        static int stall_time_cmp(const void *a, const void *b) {
+                            const ThreadSampler *x = a, *y = b;
+                            if (x->stall_us != y->stall_us) return x->stall_us > y->stall_us ? -1 : 1;
+                            return x->tid - y->tid;
+                        }
+
+                        /*
+                           Refresh the candidate set from a full pass: the top max_threads threads (candidate_cmp)
+                           get an open stat fd; others lose theirs. When the set is cut, the rotation cursor moves
+                           past the last thread admitted by rotation. Samplers are kept sorted by (tid, starttime).
+                        */
+                        static void refresh_candidates(ThreadSampler **samplers, size_t *count, size_t *capacity,
+                                                       unsigned max_threads, unsigned long long now)
+                        {
+                            size_t n = 0;
+                            ThreadInfo *threads = walk_threads(&n);
+                            if (!threads) return;
+
+                            /* Idle kernel threads, zombies and dead tasks never enter D */
+                            size_t kept = 0;
+                            for (size_t i = 0; i < n; i++) {
+                                char st = threads[i].state;
+                                if (st == 'I' || st == 'Z' || st == 'X' || st == 'x') continue;
+                                ThreadSampler key = { .tid = threads[i].tid, .starttime = threads[i].starttime };
+                                const ThreadSampler *seen = *count ? bsearch(&key, *samplers, *count, sizeof(ThreadSampler), sampler_cmp) : NULL;
+                                threads[i].d_samples = seen ? seen->d_samples : 0;
+                                threads[kept++] = threads[i];
+                            }
+                            qsort(threads, kept, sizeof(ThreadInfo), candidate_cmp);
+                            if (kept > max_threads) {
+                                kept = max_threads;
+                                const ThreadInfo *last = &threads[kept - 1];
+                                if (last->state != 'D' && last->d_samples == 0 && last->blkio_ticks == 0) rotate_after = last->tid;
+                            }
+
+                            /* Drop fds of threads that are no longer candidates */
+                            for (size_t j = 0; j < *count; j++) {
+                                ThreadSampler *s = &(*samplers)[j];
+                                if (s->fd < 0) continue;
+                                bool still = false;
+                                for (size_t i = 0; i < kept && !still; i++) {
+                                    still = threads[i].tid == s->tid && threads[i].starttime == s->starttime;
+                                }
+                                if (!still) {
+                                    stall_end(s, now);
+                                    close(s->fd);
+                                    s->fd = -1;
+                                }
+                            }
+
+                            size_t old_count = *count;
+                            for (size_t i = 0; i < kept; i++) {
+                                ThreadSampler key = { .tid = threads[i].tid, .starttime = threads[i].starttime };
+                                ThreadSampler *s = bsearch(&key, *samplers, old_count, sizeof(ThreadSampler), sampler_cmp);
+                                if (s && s->fd >= 0) continue;
+
+                                char path[96];
+                                snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", threads[i].pid, threads[i].tid);
+                                int fd = open(path, O_RDONLY | O_CLOEXEC);
+                                if (fd < 0) continue;
+
+                                if (!s) {
+                                    if (*count >= *capacity) {
+                                        size_t cap = *capacity ? *capacity * 2 : 256;
+                                        ThreadSampler *grown = realloc(*samplers, cap * sizeof(ThreadSampler));
+                                        if (!grown) {
+                                            close(fd);
+                                            break;
+                                        }
+                                        *samplers = grown;
+                                        *capacity = cap;
+                                    }
+                                    s = &(*samplers)[(*count)++];
+                                    memset(s, 0, sizeof(*s));
+                                    s->pid = threads[i].pid;
+                                    s->tid = threads[i].tid;
+                                    s->starttime = threads[i].starttime;
+                                    snprintf(s->comm, sizeof(s->comm), "%s", threads[i].comm);
+                                    s->stall_site = -1;
+                                }
+                                s->fd = fd;
+                            }
+                            free(threads);
+                            qsort(*samplers, *count, sizeof(ThreadSampler), sampler_cmp);
+                        }
+
+                        /* Full pass interval: opts->rescan_ms, or longer so a pass costing pass_cpu_us uses at most half the budget */
+                        static unsigned long long rescan_interval(const StateSampleOptions *opts, unsigned long long pass_cpu_us) {
+                            unsigned long long min_us = (unsigned long long)opts->rescan_ms * 1000ULL;
+                            unsigned long long budget_us = (unsigned long long)((double)pass_cpu_us * 100.0 / (opts->budget_pct / 2.0));
+                            return budget_us > min_us ? budget_us : min_us;
+                        }
+
+                        /*
+                           Scanner: D-state (uninterruptible sleep) stall sampler
+                           One full pass over all threads picks candidates (in D now, seen in D earlier, block
+                           I/O delay when delay accounting is on, then a window rotating over all other threads);
+                           only those are then sampled at opts->hz through kept-open
+                           /proc/<pid>/task/<tid>/stat fds read with pread (no open/close per sample).
+                           A full pass repeats every opts->rescan_ms to pick up new threads and move the window.
+                           A stall is a run of consecutive D samples; its length is measured from the first
+                           D sample to the first non-D one, so resolution is one sample period. At stall
+                           start wchan (and with opts->stack the kernel stack, root only) is read once.
+                           Own CPU time, full passes included, is checked at every full pass; above
+                           opts->budget_pct of one core the candidate set is halved. A full pass reads every
+                           thread's stat, so passes are also spaced out (beyond opts->rescan_ms) until the
+                           pass alone costs at most half the budget; the interval used is reported as "rescan_ms".
+                           Output: {"hz", "duration_ms", "overhead_pct", "candidates", "rescan_ms", "hist_bounds_ms",
+                                    "threads":[{pid, tid, comm, samples, d_samples, stalls, stall_ms,
+                                                max_stall_ms, hist:[...], wchans:[{wchan, stalls, stall_ms[, stack]}]}]}
+                           only threads that stalled, most stall time first; hist[i] counts stalls up to
+                           hist_bounds_ms[i] (last bucket: longer).
+                        */
+                        void sample_dstate_stalls(const StateSampleOptions *opts)
+                        {
+                            /* One stat fd per candidate */
+                            struct rlimit rl;
+                            if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+                                rl.rlim_cur = rl.rlim_max;
+                                setrlimit(RLIMIT_NOFILE, &rl);
+                            }
+
+                            ThreadSampler *samplers = NULL;
+                            size_t count = 0, capacity = 0;
+                            unsigned max_threads = opts->max_threads;
+
+                            unsigned long long start = mono_us();
+                            unsigned long long start_cpu = cpu_us();
+                            unsigned long long end = start + (unsigned long long)opts->duration_ms * 1000ULL;
+                            unsigned long long period_us = 1000000ULL / opts->hz;
+
+                            /* Budget windows start before a full pass so its cost counts against the budget */
+                            unsigned long long pass_wall = start, pass_cpu = start_cpu;
+                            refresh_candidates(&samplers, &count, &capacity, max_threads, start);
+                            unsigned long long rescan_us = rescan_interval(opts, cpu_us() - start_cpu);
+                            unsigned long long next_rescan = start + rescan_us;
+
+                            struct timespec next;
+                            clock_gettime(CLOCK_MONOTONIC, &next);
+                            for (;;) {
+                                unsigned long long now = mono_us();
+                                if (now >= end) break;
+
+                                for (size_t i = 0; i < count; i++) {
+                                    ThreadSampler *s = &samplers[i];
+                                    if (s->fd < 0) continue;
+                                    char st = sample_state(s->fd);
+                                    if (!st) {   /* exited */
+                                        stall_end(s, now);
+                                        close(s->fd);
+                                        s->fd = -1;
+                                        continue;
+                                    }
+                                    s->samples++;
+                                    if (st == 'D') {
+                                        s->d_samples++;
+                                        if (!s->in_stall) stall_begin(s, now, opts->stack);
+                                    } else {
+                                        stall_end(s, now);
+                                    }
+                                }
+
+                                if (now >= next_rescan) {
+                                    unsigned long long cpu = cpu_us();
+                                    double pct = now > pass_wall ? 100.0 * (double)(cpu - pass_cpu) / (double)(now - pass_wall) : 0.0;
+                                    if (pct > opts->budget_pct && max_threads > 16) {
+                                        size_t open_now = 0;
+                                        for (size_t i = 0; i < count; i++) open_now += samplers[i].fd >= 0;
+                                        if (open_now < max_threads) max_threads = (unsigned)open_now;
+                                        max_threads = max_threads / 2 > 16 ? max_threads / 2 : 16;
+                                    }
+                                    pass_wall = now;
+                                    pass_cpu = cpu;
+                                    refresh_candidates(&samplers, &count, &capacity, max_threads, now);
+                                    rescan_us = rescan_interval(opts, cpu_us() - cpu);
+                                    next_rescan = now + rescan_us;
+                                }
+
+                                /* Fixed-rate schedule; skip missed ticks instead of bursting */
+                                next.tv_nsec += (long)(period_us * 1000ULL);
+                                while (next.tv_nsec >= 1000000000L) {
+                                    next.tv_nsec -= 1000000000L;
+                                    next.tv_sec++;
+                                }
+                                struct timespec cur;
+                                clock_gettime(CLOCK_MONOTONIC, &cur);
+                                if (cur.tv_sec > next.tv_sec || (cur.tv_sec == next.tv_sec && cur.tv_nsec > next.tv_nsec)) next = cur;
+                                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+                            }
+
+                            unsigned long long stop = mono_us();
+                            double overhead = stop > start ? 100.0 * (double)(cpu_us() - start_cpu) / (double)(stop - start) : 0.0;
+                            size_t open_fds = 0;
+                            for (size_t i = 0; i < count; i++) {
+                                stall_end(&samplers[i], stop);
+                                if (samplers[i].fd >= 0) {
+                                    open_fds++;
+                                    close(samplers[i].fd);
+                                }
+                            }
+
+                            qsort(samplers, count, sizeof(ThreadSampler), stall_time_cmp);
+
+                            /* === OUTPUT – replace with your DB insert code === */
+                            printf("{\"hz\":%u,\"duration_ms\":%llu,\"overhead_pct\":%.2f,\"candidates\":%zu,\"rescan_ms\":%llu,\"hist_bounds_ms\":[",
+                                   opts->hz, (stop - start) / 1000ULL, overhead, open_fds, rescan_us / 1000ULL);
+                            for (int b = 0; b < STALL_BUCKETS - 1; b++) printf("%s%u", b ? "," : "", stall_bounds_ms[b]);
+                            printf("],\"threads\":[\n");
+                            size_t shown = 0;
+                            for (size_t i = 0; i < count && samplers[i].stalls > 0; i++) {
+                                const ThreadSampler *s = &samplers[i];
+                                printf("%s  {\"pid\":%d,\"tid\":%d,\"comm\":\"", shown ? ",\n" : "", s->pid, s->tid);
+                                for (const char *p = s->comm; *p; p++) {
+                                    if (*p == '"' || *p == '\\') putchar('\\');
+                                    putchar(*p);
+                                }
+                                printf("\",\"samples\":%llu,\"d_samples\":%llu,\"stalls\":%u,\"stall_ms\":%.1f,\"max_stall_ms\":%.1f,\"hist\":[",
+                                       s->samples, s->d_samples, s->stalls, s->stall_us / 1000.0, s->max_stall_us / 1000.0);
+                                for (int b = 0; b < STALL_BUCKETS; b++) printf("%s%u", b ? "," : "", s->hist[b]);
+                                printf("],\"wchans\":[");
+                                for (unsigned w = 0; w < s->site_count; w++) {
+                                    printf("%s{\"wchan\":\"%s\",\"stalls\":%u,\"stall_ms\":%.1f", w ? "," : "",
+                                           s->sites[w].wchan, s->sites[w].stalls, s->sites[w].stall_us / 1000.0);
+                                    if (s->sites[w].stack) printf(",\"stack\":\"%s\"", s->sites[w].stack);
+                                    printf("}");
+                                }
+                                printf("]}");
+                                shown++;
+                            }
+                            printf("%s]}\n", shown ? "\n" : "");
+
+                            for (size_t i = 0; i < count; i++) {
+                                for (unsigned w = 0; w < samplers[i].site_count; w++) free(samplers[i].sites[w].stack);
+                            }
+                            free(samplers);
+                        }
+
+                        int main(int argc, char **argv)
                         {
-                            scan_process_states();
+                            StateSampleOptions opts = { .dstate = false, .duration_ms = 10000, .hz = 100, .max_threads = 256,
+                                                        .rescan_ms = 2000, .budget_pct = 3.0, .stack = false };
+                            bool bad_args = false;
+
+                            for (int i = 1; i < argc; i++) {
+                                if (strcmp(argv[i], "--dstate") == 0 && i + 1 < argc) {
+                                    opts.dstate = true;
+                                    opts.duration_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+                                } else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc) {
+                                    opts.hz = (unsigned)strtoul(argv[++i], NULL, 10);
+                                    if (opts.hz == 0 || opts.hz > 10000) bad_args = true;
+                                } else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+                                    opts.max_threads = (unsigned)strtoul(argv[++i], NULL, 10);
+                                    if (opts.max_threads == 0) bad_args = true;
+                                } else if (strcmp(argv[i], "--rescan") == 0 && i + 1 < argc) {
+                                    opts.rescan_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+                                    if (opts.rescan_ms == 0) bad_args = true;
+                                } else if (strcmp(argv[i], "--budget-pct") == 0 && i + 1 < argc) {
+                                    opts.budget_pct = strtod(argv[++i], NULL);
+                                    if (opts.budget_pct <= 0) bad_args = true;
+                                } else if (strcmp(argv[i], "--stack") == 0) {
+                                    opts.stack = true;
+                                } else {
+                                    bad_args = true;
+                                }
+                            }
+
+                            if (bad_args) {
+                                fprintf(stderr, "Usage:\n");
+                                fprintf(stderr, "  %s                      # State of every process → JSON\n", argv[0]);
+                                fprintf(stderr, "  %s --dstate <ms> [--hz <n>] [--max-threads <n>] [--rescan <ms>] [--budget-pct <p>] [--stack]\n", argv[0]);
+                                fprintf(stderr, "      # Sample candidate threads for D-state stalls for <ms>: per-thread stall histograms + wchan\n");
+                                fprintf(stderr, "      # (defaults: 100 Hz, 256 threads, full pass every 2000 ms or longer to fit, 3%% of a core; --stack needs root)\n");
+                                return 1;
+                            }
+
+                            if (opts.dstate) sample_dstate_stalls(&opts);
+                            else scan_process_states();
                             return 0;
                         }
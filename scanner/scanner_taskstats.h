@@ -0,0 +1,303 @@
+#ifndef SCANNER_TASKSTATS_H
+#define SCANNER_TASKSTATS_H
+
+/*
+   Shared TASKSTATS generic-netlink backend (header-only, like scanner_sockowner.h).
+
+   taskstats_query() returns the binary struct taskstats the kernel keeps for a
+   PID or a whole thread group (TGID): CPU time in usec plus delay accounting
+   (run-queue, block I/O, swap-in, memory reclaim, thrashing) that has no /proc
+   text equivalent. taskstats_subscribe_exits() registers for the final record
+   the kernel sends when a process exits.
+
+   Needs root (CAP_NET_ADMIN). Delay fields stay 0 unless delay accounting is on
+   (sysctl kernel.task_delayacct=1 or the "delayacct" boot parameter); check
+   taskstats_delayacct_enabled() instead of reporting those zeros as measurements.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+
+/* Accounting for one process, as used by the scanners */
+typedef struct {
+    int pid;                                /* TGID (or PID for per-thread queries) */
+    int tgid;                               /* per-PID records; 0 before taskstats v13 */
+    int ppid;                               /* exit records only */
+    char comm[17];                          /* exit records only (TGID queries carry no name) */
+    unsigned long long utime_us;            /* user CPU time */
+    unsigned long long stime_us;            /* system CPU time */
+    unsigned long long cpu_delay_count;     /* waits for a CPU (run queue) */
+    unsigned long long cpu_delay_ns;
+    unsigned long long blkio_delay_count;   /* waits for synchronous block I/O */
+    unsigned long long blkio_delay_ns;
+    unsigned long long swapin_delay_count;  /* waits for swap-in */
+    unsigned long long swapin_delay_ns;
+    unsigned long long reclaim_delay_count; /* direct memory reclaim (freepages) */
+    unsigned long long reclaim_delay_ns;
+    unsigned long long thrashing_delay_count;
+    unsigned long long thrashing_delay_ns;
+    unsigned long long hiwater_rss_kb;      /* per-PID queries and exit records only */
+    unsigned long long hiwater_vm_kb;
+} TaskstatsRecord;
+
+typedef struct {
+    int fd;
+    unsigned short family_id;
+    unsigned int seq;
+} TaskstatsConn;
+
+/* Generic netlink request: header + genl header + room for one small attribute */
+typedef struct {
+    struct nlmsghdr nlh;
+    struct genlmsghdr genl;
+    char attrs[256];
+} TaskstatsMsg;
+
+static inline void taskstats_put_attr(TaskstatsMsg *m, unsigned short type, const void *data, size_t len) {
+    struct nlattr *na = (struct nlattr *)((char *)m + NLMSG_ALIGN(m->nlh.nlmsg_len));
+    na->nla_type = type;
+    na->nla_len = (unsigned short)(NLA_HDRLEN + len);
+    memcpy((char *)na + NLA_HDRLEN, data, len);
+    m->nlh.nlmsg_len = NLMSG_ALIGN(m->nlh.nlmsg_len) + NLA_ALIGN(na->nla_len);
+}
+
+static inline int taskstats_send(TaskstatsConn *c, unsigned short type, unsigned char cmd,
+                                 unsigned short attr, const void *data, size_t len) {
+    TaskstatsMsg m;
+    memset(&m, 0, sizeof(m));
+    m.nlh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    m.nlh.nlmsg_type = type;
+    m.nlh.nlmsg_flags = NLM_F_REQUEST;
+    m.nlh.nlmsg_seq = ++c->seq;
+    m.nlh.nlmsg_pid = 0;
+    m.genl.cmd = cmd;
+    m.genl.version = 1;
+    taskstats_put_attr(&m, attr, data, len);
+
+    struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+    if (sendto(c->fd, &m, m.nlh.nlmsg_len, 0, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) return -1;
+    return 0;
+}
+
+/* Resolve the "TASKSTATS" generic netlink family; -1 on failure */
+static inline int taskstats_open(TaskstatsConn *c) {
+    c->seq = 0;
+    c->family_id = 0;
+    c->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (c->fd < 0) {
+        perror("socket NETLINK_GENERIC");
+        return -1;
+    }
+
+    if (taskstats_send(c, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                       TASKSTATS_GENL_NAME, strlen(TASKSTATS_GENL_NAME) + 1) < 0) {
+        perror("sendto CTRL_CMD_GETFAMILY");
+        close(c->fd);
+        return -1;
+    }
+
+    static char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t len = recv(c->fd, buf, sizeof(buf), 0);
+    struct nlmsghdr *h = (struct nlmsghdr *)buf;
+    if (len > 0 && NLMSG_OK(h, (size_t)len) && h->nlmsg_type != NLMSG_ERROR) {
+        struct nlattr *na = (struct nlattr *)((char *)NLMSG_DATA(h) + GENL_HDRLEN);
+        int rem = (int)h->nlmsg_len - (int)NLMSG_LENGTH(GENL_HDRLEN);
+        while (rem >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN && na->nla_len <= rem) {
+            if (na->nla_type == CTRL_ATTR_FAMILY_ID) {
+                c->family_id = *(const unsigned short *)((char *)na + NLA_HDRLEN);
+                break;
+            }
+            rem -= NLA_ALIGN(na->nla_len);
+            na = (struct nlattr *)((char *)na + NLA_ALIGN(na->nla_len));
+        }
+    }
+
+    if (c->family_id == 0) {
+        fprintf(stderr, "taskstats: generic netlink family not available\n");
+        close(c->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void taskstats_close(TaskstatsConn *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+}
+
+/* struct taskstats → TaskstatsRecord (older kernels send a shorter struct: rest stays zero) */
+static inline void taskstats_fill(TaskstatsRecord *r, const void *data, size_t len) {
+    struct taskstats ts;
+    memset(&ts, 0, sizeof(ts));
+    memcpy(&ts, data, len < sizeof(ts) ? len : sizeof(ts));
+
+    r->utime_us = ts.ac_utime;
+    r->stime_us = ts.ac_stime;
+    r->cpu_delay_count = ts.cpu_count;
+    r->cpu_delay_ns = ts.cpu_delay_total;
+    r->blkio_delay_count = ts.blkio_count;
+    r->blkio_delay_ns = ts.blkio_delay_total;
+    r->swapin_delay_count = ts.swapin_count;
+    r->swapin_delay_ns = ts.swapin_delay_total;
+    r->reclaim_delay_count = ts.freepages_count;
+    r->reclaim_delay_ns = ts.freepages_delay_total;
+    r->thrashing_delay_count = ts.thrashing_count;
+    r->thrashing_delay_ns = ts.thrashing_delay_total;
+    r->hiwater_rss_kb = ts.hiwater_rss;
+    r->hiwater_vm_kb = ts.hiwater_vm;
+    r->tgid = (int)ts.ac_tgid;
+    if (ts.ac_comm[0]) {
+        memcpy(r->comm, ts.ac_comm, sizeof(r->comm) - 1);   /* TASK_COMM_LEN, NUL-padded */
+        r->comm[sizeof(r->comm) - 1] = '\0';
+        r->ppid = (int)ts.ac_ppid;
+    }
+}
+
+/*
+   Walk one TASKSTATS reply. Fills *pid_rec from TASKSTATS_TYPE_AGGR_PID and
+   *tgid_rec from TASKSTATS_TYPE_AGGR_TGID (either may be NULL).
+   Returns a bit mask: 1 = PID record found, 2 = TGID record found.
+*/
+static inline int taskstats_parse(const struct nlmsghdr *h, TaskstatsRecord *pid_rec, TaskstatsRecord *tgid_rec) {
+    int found = 0;
+    const struct nlattr *na = (const struct nlattr *)((const char *)NLMSG_DATA(h) + GENL_HDRLEN);
+    int rem = (int)h->nlmsg_len - (int)NLMSG_LENGTH(GENL_HDRLEN);
+
+    while (rem >= NLA_HDRLEN && na->nla_len >= NLA_HDRLEN && na->nla_len <= rem) {
+        if (na->nla_type == TASKSTATS_TYPE_AGGR_PID || na->nla_type == TASKSTATS_TYPE_AGGR_TGID) {
+            bool is_tgid = na->nla_type == TASKSTATS_TYPE_AGGR_TGID;
+            TaskstatsRecord *r = is_tgid ? tgid_rec : pid_rec;
+            int id = 0;
+            const struct nlattr *nested = (const struct nlattr *)((const char *)na + NLA_HDRLEN);
+            int nrem = na->nla_len - NLA_HDRLEN;
+
+            while (r && nrem >= NLA_HDRLEN && nested->nla_len >= NLA_HDRLEN && nested->nla_len <= nrem) {
+                const void *payload = (const char *)nested + NLA_HDRLEN;
+                if (nested->nla_type == TASKSTATS_TYPE_PID || nested->nla_type == TASKSTATS_TYPE_TGID) {
+                    id = *(const int *)payload;
+                } else if (nested->nla_type == TASKSTATS_TYPE_STATS) {
+                    taskstats_fill(r, payload, nested->nla_len - NLA_HDRLEN);
+                    r->pid = id;
+                    found |= is_tgid ? 2 : 1;
+                }
+                nrem -= NLA_ALIGN(nested->nla_len);
+                nested = (const struct nlattr *)((const char *)nested + NLA_ALIGN(nested->nla_len));
+            }
+        }
+        rem -= NLA_ALIGN(na->nla_len);
+        na = (const struct nlattr *)((const char *)na + NLA_ALIGN(na->nla_len));
+    }
+    return found;
+}
+
+/*
+   Query one process. tgid = true sums all threads of the group (what /proc/<pid>/stat
+   reports for CPU time); tgid = false returns the single task, with comm and hiwater.
+   Returns 0 on success, -1 if the process is gone or the query failed.
+*/
+static inline int taskstats_query(TaskstatsConn *c, int pid, bool tgid, TaskstatsRecord *out) {
+    unsigned int id = (unsigned int)pid;
+    if (taskstats_send(c, c->family_id, TASKSTATS_CMD_GET,
+                       tgid ? TASKSTATS_CMD_ATTR_TGID : TASKSTATS_CMD_ATTR_PID, &id, sizeof(id)) < 0) {
+        return -1;
+    }
+
+    static char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+    ssize_t len = recv(c->fd, buf, sizeof(buf), 0);
+    if (len <= 0) return -1;
+
+    struct nlmsghdr *h = (struct nlmsghdr *)buf;
+    if (!NLMSG_OK(h, (size_t)len) || h->nlmsg_type == NLMSG_ERROR) return -1;  /* ESRCH: exited */
+
+    memset(out, 0, sizeof(*out));
+    int found = tgid ? taskstats_parse(h, NULL, out) : taskstats_parse(h, out, NULL);
+    return found ? 0 : -1;
+}
+
+/*
+   Is delay accounting collecting? kernel.task_delayacct exists since 5.14 (default off);
+   older kernels have no switch and account unless booted with "nodelayacct".
+*/
+static inline bool taskstats_delayacct_enabled(void) {
+    FILE *f = fopen("/proc/sys/kernel/task_delayacct", "re");
+    if (!f) return true;
+    int on = 1;
+    if (fscanf(f, "%d", &on) != 1) on = 1;
+    fclose(f);
+    return on != 0;
+}
+
+/* Register for exit records on every CPU; -1 on failure */
+static inline int taskstats_subscribe_exits(TaskstatsConn *c) {
+    char cpumask[32];
+    long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    snprintf(cpumask, sizeof(cpumask), "0-%ld", ncpus > 0 ? ncpus - 1 : 0);
+
+    /* Exit records can arrive in bursts: make room before the kernel drops them */
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (taskstats_send(c, c->family_id, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
+                       cpumask, strlen(cpumask) + 1) < 0) {
+        perror("sendto TASKSTATS_CMD_ATTR_REGISTER_CPUMASK");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+   Wait up to timeout_ms for the next process exit (on a subscribed connection).
+   Returns 1 with *out filled for a whole process: the TGID aggregate when the last
+   thread of a group exits, or the PID record of a single-threaded process.
+   Thread exits are skipped. Returns 0 on timeout, -1 on error.
+*/
+static inline int taskstats_read_exit(TaskstatsConn *c, TaskstatsRecord *out, int timeout_ms) {
+    static char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+        struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+        int rc = poll(&pfd, 1, timeout_ms);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc <= 0) return rc;
+
+        ssize_t len = recv(c->fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == ENOBUFS || errno == EINTR) continue;  /* some exits lost */
+            return -1;
+        }
+
+        struct nlmsghdr *h = (struct nlmsghdr *)buf;
+        for (; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_type != c->family_id) continue;
+
+            TaskstatsRecord pid_rec, tgid_rec;
+            memset(&pid_rec, 0, sizeof(pid_rec));
+            memset(&tgid_rec, 0, sizeof(tgid_rec));
+            int found = taskstats_parse(h, &pid_rec, &tgid_rec);
+
+            if (found & 2) {
+                /* Group aggregate has no name/ppid: take them from the last thread */
+                tgid_rec.ppid = pid_rec.ppid;
+                memcpy(tgid_rec.comm, pid_rec.comm, sizeof(tgid_rec.comm));
+                *out = tgid_rec;
+                return 1;
+            }
+            /* No aggregate: a single-threaded process (its task is the leader) or a thread */
+            if ((found & 1) && (pid_rec.tgid == 0 || pid_rec.tgid == pid_rec.pid)) {
+                *out = pid_rec;
+                return 1;
+            }
+        }
+    }
+}
+
+#endif /* SCANNER_TASKSTATS_H */
@@ -1,22 +1,71 @@
 #include <stdio.h>
-#include <dirent.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
-#include <unistd.h>     /* for readlink */
-#include <limits.h>     /* for PATH_MAX */
+#include <stdbool.h>
+#include <time.h>       /* for nanosleep, clock_gettime */
+#include <unistd.h>     /* for close */
+#include <arpa/inet.h>  /* for inet_ntop, ntohs */
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>   /* for RTA_OK / RTA_NEXT */
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include <linux/tcp.h>         /* for struct tcp_info */
+#include "scanner_sockowner.h"
+
+#define TCP_STATE_ESTABLISHED 1   /* kernel TCP_ESTABLISHED, same as /proc/net/tcp state 01 */
+
+/* Counters pulled from INET_DIAG_INFO (struct tcp_info) and INET_DIAG_SKMEMINFO */
+typedef struct TcpSample {
+    unsigned int       rtt_us;          /* smoothed RTT (usec) */
+    unsigned int       rttvar_us;       /* RTT variance (usec) */
+    unsigned int       snd_cwnd;        /* congestion window (segments) */
+    unsigned int       unacked;         /* segments in flight */
+    unsigned int       total_retrans;   /* retransmitted segments over socket lifetime */
+    unsigned long long bytes_acked;     /* bytes sent and acked by peer */
+    unsigned long long bytes_received;  /* bytes received from peer */
+    unsigned int       rmem_alloc;      /* receive queue memory (bytes) */
+    unsigned int       rcvbuf;          /* receive buffer limit (bytes) */
+    unsigned int       wmem_queued;     /* send queue memory (bytes) */
+    unsigned int       sndbuf;          /* send buffer limit (bytes) */
+    unsigned int       sk_drops;        /* packets dropped by the socket */
+} TcpSample;
 
 /* Tagged struct so 'struct Connection' is defined before use in pid_cmp */
 typedef struct Connection {
     int   pid;
     char  comm[17];           /* short process name */
     unsigned short local_port; /* local port (host byte order) */
-    char  local_ip[32];       /* local IP (e.g., "127.0.0.1") */
+    char  local_ip[INET6_ADDRSTRLEN];  /* local IP (e.g., "127.0.0.1") */
     unsigned short remote_port; /* remote port (host byte order) */
-    char  remote_ip[32];      /* remote IP (e.g., "8.8.8.8") */
+    char  remote_ip[INET6_ADDRSTRLEN]; /* remote IP (e.g., "8.8.8.8") */
+    unsigned char family;     /* AF_INET / AF_INET6 */
+    unsigned char remote_addr[16]; /* remote IP, network byte order (for grouping) */
     char  inode[32];          /* socket inode for reference */
+    unsigned long ino;        /* numeric inode, used to match sock_diag samples */
+    bool  has_info;           /* tcp_info/skmeminfo filled (deep mode) */
+    TcpSample info;
+    bool  has_rate;           /* rates below are valid (--interval) */
+    double send_bps;          /* bytes_acked delta per second */
+    double recv_bps;          /* bytes_received delta per second */
+    double retrans_per_sec;   /* total_retrans delta per second */
 } Connection;
 
+typedef enum {
+    GROUP_NONE,
+    GROUP_PID_REMOTE,         /* (pid, remote_ip) */
+    GROUP_PID_LPORT,          /* (pid, local_port) */
+    GROUP_REMOTE_NET          /* remote /24 (IPv6: /64) */
+} GroupBy;
+
+typedef struct {
+    bool     tcp_info;        /* pull tcp_info + skmeminfo via sock_diag */
+    unsigned interval_ms;     /* > 0: take a second sample and compute rates */
+    const char *owner_cache;  /* socket owner cache file kept between runs (NULL = none) */
+    GroupBy  group_by;        /* aggregate instead of one row per connection */
+    size_t   top_k;           /* > 0: bounded space-saving sketch of the top_k groups */
+} TcpScanOptions;
+
 /* Comparator for qsort by PID, then local_port */
 static int pid_cmp(const void *a, const void *b) {
     const struct Connection *pa = a;
@@ -25,28 +74,36 @@ static int pid_cmp(const void *a, const void *b) {
     return pa->local_port - pb->local_port;
 }
 
-/*
-Scanner: Established TCP connections (with process PID/comm)
-Parses /proc/net/tcp for established entries (state 01), collects inode, local/remote IP/port.
-Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm.
-Output: JSON array of {pid, comm, local_ip, local_port, remote_ip, remote_port, inode} for each established TCP connection.
-Note: Run as root to see all (some /proc/pid/fd restricted).
-Only IPv4 for simplicity; add IPv6 from /proc/net/tcp6 if needed.
-*/
-void scan_established_tcp_connections(void)
-{
-    /* Step 1: Parse /proc/net/tcp for established connections + inodes */
+/* Comparator for qsort/bsearch by numeric inode */
+static int ino_cmp(const void *a, const void *b) {
+    const struct Connection *pa = a;
+    const struct Connection *pb = b;
+    return (pa->ino > pb->ino) - (pa->ino < pb->ino);
+}
+
+/* Grow connections array by one slot; returns NULL on allocation failure */
+static Connection *append_connection(Connection **conns, size_t *count, size_t *capacity) {
+    if (*count >= *capacity) {
+        size_t newcap = *capacity ? *capacity * 2 : 128;
+        Connection *new_conns = realloc(*conns, newcap * sizeof(Connection));
+        if (!new_conns) return NULL;
+        *conns = new_conns;
+        *capacity = newcap;
+    }
+    Connection *c = &(*conns)[(*count)++];
+    memset(c, 0, sizeof(*c));
+    return c;
+}
+
+/* Parse /proc/net/tcp for established connections + inodes (IPv4 only) */
+static int read_proc_net_tcp(Connection **conns, size_t *count, size_t *capacity) {
     FILE *tcp = fopen("/proc/net/tcp", "re");
     if (!tcp) {
         perror("fopen /proc/net/tcp");
-        printf("[]\n");
-        return;
+        return -1;
     }
 
     char line[1024];
-    Connection *connections = NULL;
-    size_t conn_capacity = 0;
-    size_t conn_count = 0;
 
     /* Skip header */
     fgets(line, sizeof(line), tcp);
@@ -64,123 +121,706 @@ void scan_established_tcp_connections(void)
             continue;
         }
 
-        if (st_hex != 0x01) continue;  /* Only established (TCP_ESTABLISHED) */
+        if (st_hex != TCP_STATE_ESTABLISHED) continue;  /* Only established (TCP_ESTABLISHED) */
+
+        Connection *c = append_connection(conns, count, capacity);
+        if (!c) break;
 
         /* Convert IPs to dotted decimal */
-        char local_ip[32];
-        snprintf(local_ip, sizeof(local_ip), "%d.%d.%d.%d",
+        snprintf(c->local_ip, sizeof(c->local_ip), "%d.%d.%d.%d",
                 local_ip_hex & 0xFF,
                 (local_ip_hex >> 8) & 0xFF,
                 (local_ip_hex >> 16) & 0xFF,
                 (local_ip_hex >> 24) & 0xFF);
-
-        char remote_ip[32];
-        snprintf(remote_ip, sizeof(remote_ip), "%d.%d.%d.%d",
+        snprintf(c->remote_ip, sizeof(c->remote_ip), "%d.%d.%d.%d",
                 remote_ip_hex & 0xFF,
                 (remote_ip_hex >> 8) & 0xFF,
                 (remote_ip_hex >> 16) & 0xFF,
                 (remote_ip_hex >> 24) & 0xFF);
 
-        /* Grow connections array */
-        if (conn_count >= conn_capacity) {
-            conn_capacity = conn_capacity ? conn_capacity * 2 : 128;
-            Connection *new_conns = realloc(connections, conn_capacity * sizeof(Connection));
-            if (!new_conns) break;
-            connections = new_conns;
+        c->local_port = local_port_hex;
+        c->remote_port = remote_port_hex;
+        c->family = AF_INET;
+        memcpy(c->remote_addr, &remote_ip_hex, 4);   /* already in network byte order */
+        snprintf(c->inode, sizeof(c->inode), "%s", inode_str);
+        c->ino = strtoul(inode_str, NULL, 10);
+    }
+    fclose(tcp);
+    return 0;
+}
+
+/* Copy one inet_diag_msg (+ INFO/SKMEMINFO attributes) into a Connection */
+static void fill_from_diag(Connection *c, const struct inet_diag_msg *d, int attr_len) {
+    inet_ntop(d->idiag_family, d->id.idiag_src, c->local_ip, sizeof(c->local_ip));
+    inet_ntop(d->idiag_family, d->id.idiag_dst, c->remote_ip, sizeof(c->remote_ip));
+    c->local_port = ntohs(d->id.idiag_sport);
+    c->remote_port = ntohs(d->id.idiag_dport);
+    c->family = d->idiag_family;
+    memcpy(c->remote_addr, d->id.idiag_dst, sizeof(c->remote_addr));
+    c->ino = d->idiag_inode;
+    snprintf(c->inode, sizeof(c->inode), "%lu", c->ino);
+
+    struct rtattr *attr = (struct rtattr *)(d + 1);
+    for (; RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len)) {
+        if (attr->rta_type == INET_DIAG_INFO) {
+            /* Older kernels send a shorter struct — copy what we got, rest stays zero */
+            struct tcp_info ti;
+            size_t len = RTA_PAYLOAD(attr);
+            memset(&ti, 0, sizeof(ti));
+            memcpy(&ti, RTA_DATA(attr), len < sizeof(ti) ? len : sizeof(ti));
+
+            c->info.rtt_us         = ti.tcpi_rtt;
+            c->info.rttvar_us      = ti.tcpi_rttvar;
+            c->info.snd_cwnd       = ti.tcpi_snd_cwnd;
+            c->info.unacked        = ti.tcpi_unacked;
+            c->info.total_retrans  = ti.tcpi_total_retrans;
+            c->info.bytes_acked    = ti.tcpi_bytes_acked;
+            c->info.bytes_received = ti.tcpi_bytes_received;
+            c->has_info = true;
+        } else if (attr->rta_type == INET_DIAG_SKMEMINFO) {
+            const unsigned int *mem = RTA_DATA(attr);
+            size_t n = RTA_PAYLOAD(attr) / sizeof(unsigned int);
+
+            if (n > SK_MEMINFO_RMEM_ALLOC)   c->info.rmem_alloc  = mem[SK_MEMINFO_RMEM_ALLOC];
+            if (n > SK_MEMINFO_RCVBUF)       c->info.rcvbuf      = mem[SK_MEMINFO_RCVBUF];
+            if (n > SK_MEMINFO_WMEM_QUEUED)  c->info.wmem_queued = mem[SK_MEMINFO_WMEM_QUEUED];
+            if (n > SK_MEMINFO_SNDBUF)       c->info.sndbuf      = mem[SK_MEMINFO_SNDBUF];
+            if (n > SK_MEMINFO_DROPS)        c->info.sk_drops    = mem[SK_MEMINFO_DROPS];
+            c->has_info = true;
         }
+    }
+}
 
-        connections[conn_count].pid = 0;  /* To be filled */
-        memset(connections[conn_count].comm, 0, sizeof(connections[conn_count].comm));
-        connections[conn_count].local_port = local_port_hex;
-        /* --- FIX: use snprintf to safely copy and ensure NUL termination --- */
-        snprintf(connections[conn_count].local_ip, sizeof(connections[conn_count].local_ip), "%s", local_ip);
-        connections[conn_count].remote_port = remote_port_hex;
-        snprintf(connections[conn_count].remote_ip, sizeof(connections[conn_count].remote_ip), "%s", remote_ip);
-        snprintf(connections[conn_count].inode, sizeof(connections[conn_count].inode), "%s", inode_str);
+/*
+   One NETLINK_SOCK_DIAG dump of all established TCP sockets of one address family,
+   with INET_DIAG_INFO and INET_DIAG_SKMEMINFO attached to every socket.
+   Returns 0 on success, -1 on netlink failure.
+*/
+static int sock_diag_dump(int family, Connection **conns, size_t *count, size_t *capacity) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd < 0) {
+        perror("socket NETLINK_SOCK_DIAG");
+        return -1;
+    }
 
-        conn_count++;
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+    } msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    msg.req.sdiag_family = family;
+    msg.req.sdiag_protocol = IPPROTO_TCP;
+    msg.req.idiag_states = 1U << TCP_STATE_ESTABLISHED;
+    msg.req.idiag_ext = (1U << (INET_DIAG_INFO - 1)) | (1U << (INET_DIAG_SKMEMINFO - 1));
+
+    struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+    if (sendto(fd, &msg, sizeof(msg), 0, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+        perror("sendto NETLINK_SOCK_DIAG");
+        close(fd);
+        return -1;
     }
-    fclose(tcp);
 
-    if (conn_count == 0) {
-        free(connections);
-        printf("[]\n");
+    /* Large receive buffer: one recv() returns many sockets */
+    static char buf[65536] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int rc = 0;
+    bool done = false;
+
+    while (!done) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            perror("recv NETLINK_SOCK_DIAG");
+            rc = -1;
+            break;
+        }
+        if (len == 0) break;
+
+        struct nlmsghdr *h = (struct nlmsghdr *)buf;
+        for (; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_type == NLMSG_DONE) {
+                done = true;
+                break;
+            }
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                fprintf(stderr, "sock_diag dump failed for family %d\n", family);
+                rc = -1;
+                done = true;
+                break;
+            }
+            if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY) continue;
+
+            const struct inet_diag_msg *d = NLMSG_DATA(h);
+            int attr_len = (int)h->nlmsg_len - (int)NLMSG_LENGTH(sizeof(*d));
+            if (attr_len < 0) continue;
+            if (d->idiag_inode == 0) continue;  /* no owning file (orphaned) */
+
+            Connection *c = append_connection(conns, count, capacity);
+            if (!c) {
+                rc = -1;
+                done = true;
+                break;
+            }
+            fill_from_diag(c, d, attr_len);
+        }
+    }
+
+    close(fd);
+    return rc;
+}
+
+/* Both families in one go; IPv6 failure (e.g. ipv6 disabled) is not fatal */
+static int sock_diag_established(Connection **conns, size_t *count, size_t *capacity) {
+    if (sock_diag_dump(AF_INET, conns, count, capacity) < 0) return -1;
+    sock_diag_dump(AF_INET6, conns, count, capacity);
+    return 0;
+}
+
+static unsigned long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/* Per-connection rates from two samples 'secs' apart (matched by inode) */
+static void compute_rates(Connection *cur, size_t cur_count,
+                          Connection *prev, size_t prev_count, double secs) {
+    qsort(prev, prev_count, sizeof(Connection), ino_cmp);
+
+    for (size_t i = 0; i < cur_count; i++) {
+        Connection key = { .ino = cur[i].ino };
+        const Connection *p = bsearch(&key, prev, prev_count, sizeof(Connection), ino_cmp);
+        if (!p || !p->has_info || !cur[i].has_info) continue;  /* new connection – no baseline */
+
+        /* Counters are monotonic for the lifetime of a socket; guard anyway */
+        if (cur[i].info.bytes_acked >= p->info.bytes_acked)
+            cur[i].send_bps = (cur[i].info.bytes_acked - p->info.bytes_acked) / secs;
+        if (cur[i].info.bytes_received >= p->info.bytes_received)
+            cur[i].recv_bps = (cur[i].info.bytes_received - p->info.bytes_received) / secs;
+        if (cur[i].info.total_retrans >= p->info.total_retrans)
+            cur[i].retrans_per_sec = (cur[i].info.total_retrans - p->info.total_retrans) / secs;
+        cur[i].has_rate = true;
+    }
+}
+
+/* Map each connection inode to its owning PID/comm (one fd walk, incremental with a cache file) */
+static void resolve_owners(Connection *connections, size_t conn_count, const char *cache_file) {
+    SockOwnerCache cache;
+    sockowner_cache_init(&cache);
+    if (cache_file) sockowner_cache_load(&cache, cache_file);
+
+    unsigned long *wanted = NULL;
+    if (conn_count > 0) {
+        wanted = malloc(conn_count * sizeof(unsigned long));
+        if (!wanted) {
+            sockowner_cache_free(&cache);
+            return;
+        }
+        for (size_t i = 0; i < conn_count; i++) wanted[i] = connections[i].ino;
+    }
+    sockowner_refresh(&cache, wanted, conn_count);
+    free(wanted);
+
+    for (size_t k = 0; k < conn_count; k++) {
+        SockOwner owner;
+        if (!sockowner_first(&cache, connections[k].ino, &owner)) continue;
+        connections[k].pid = owner.pid;
+        snprintf(connections[k].comm, sizeof(connections[k].comm), "%s", owner.comm);
+    }
+
+    if (cache_file) sockowner_cache_save(&cache, cache_file);
+    sockowner_cache_free(&cache);
+}
+
+/* Deep-mode output: per-connection tcp_info plus per-process rollup */
+static void print_deep(const Connection *connections, size_t conn_count) {
+    printf("{\"connections\":[\n");
+    bool first = true;
+    for (size_t i = 0; i < conn_count; i++) {
+        const Connection *c = &connections[i];
+        if (c->pid == 0) continue;
+
+        printf("%s  {\"pid\":%d,\"comm\":\"%s\",\"local_ip\":\"%s\",\"local_port\":%hu,"
+               "\"remote_ip\":\"%s\",\"remote_port\":%hu,\"inode\":\"%s\","
+               "\"rtt_us\":%u,\"rttvar_us\":%u,\"snd_cwnd\":%u,\"unacked\":%u,"
+               "\"total_retrans\":%u,\"bytes_acked\":%llu,\"bytes_received\":%llu,"
+               "\"rmem_alloc\":%u,\"rcvbuf\":%u,\"wmem_queued\":%u,\"sndbuf\":%u,\"sk_drops\":%u",
+               first ? "" : ",\n",
+               c->pid, c->comm, c->local_ip, c->local_port,
+               c->remote_ip, c->remote_port, c->inode,
+               c->info.rtt_us, c->info.rttvar_us, c->info.snd_cwnd, c->info.unacked,
+               c->info.total_retrans, c->info.bytes_acked, c->info.bytes_received,
+               c->info.rmem_alloc, c->info.rcvbuf, c->info.wmem_queued, c->info.sndbuf,
+               c->info.sk_drops);
+        if (c->has_rate) {
+            printf(",\"send_bps\":%.0f,\"recv_bps\":%.0f,\"retrans_per_sec\":%.2f",
+                   c->send_bps, c->recv_bps, c->retrans_per_sec);
+        }
+        printf("}");
+        first = false;
+    }
+    printf("\n],\"processes\":[\n");
+
+    /* connections[] is sorted by PID, so each process is one contiguous run */
+    first = true;
+    size_t i = 0;
+    while (i < conn_count) {
+        if (connections[i].pid == 0) { i++; continue; }
+
+        int pid = connections[i].pid;
+        size_t n = 0;
+        unsigned long long rtt_sum = 0;
+        unsigned int rtt_max = 0;
+        unsigned long long rmem = 0, wmem = 0, drops = 0;
+        double send_bps = 0, recv_bps = 0, retrans = 0;
+        bool has_rate = false;
+        const char *comm = connections[i].comm;
+
+        for (; i < conn_count && connections[i].pid == pid; i++) {
+            const Connection *c = &connections[i];
+            n++;
+            rtt_sum += c->info.rtt_us;
+            if (c->info.rtt_us > rtt_max) rtt_max = c->info.rtt_us;
+            rmem  += c->info.rmem_alloc;
+            wmem  += c->info.wmem_queued;
+            drops += c->info.sk_drops;
+            if (c->has_rate) {
+                send_bps += c->send_bps;
+                recv_bps += c->recv_bps;
+                retrans  += c->retrans_per_sec;
+                has_rate = true;
+            }
+        }
+
+        printf("%s  {\"pid\":%d,\"comm\":\"%s\",\"connections\":%zu,"
+               "\"avg_rtt_us\":%llu,\"max_rtt_us\":%u,"
+               "\"rmem_alloc\":%llu,\"wmem_queued\":%llu,\"sk_drops\":%llu",
+               first ? "" : ",\n",
+               pid, comm, n, rtt_sum / n, rtt_max, rmem, wmem, drops);
+        if (has_rate) {
+            printf(",\"send_bps\":%.0f,\"recv_bps\":%.0f,\"retrans_per_sec\":%.2f",
+                   send_bps, recv_bps, retrans);
+        }
+        printf("}");
+        first = false;
+    }
+    printf("\n]}\n");
+}
+
+/* ---------- Aggregation (--group-by / --top-k) ---------- */
+
+/* Group key; unused members stay zero so keys hash and compare bytewise */
+typedef struct {
+    int            pid;
+    unsigned short local_port;
+    unsigned char  family;       /* AF_INET / AF_INET6, 0 when address not part of key */
+    unsigned char  prefix_len;   /* mask applied to addr (32/128 exact, 24 or 64 for networks) */
+    unsigned char  addr[16];
+} GroupKey;
+
+typedef struct {
+    GroupKey key;
+    char     comm[17];
+    unsigned long count;         /* connections in this group */
+    unsigned long error;         /* space-saving overestimation bound (0 when exact) */
+    unsigned long samples;       /* connections actually summed below (count minus inherited error) */
+    /* tcp_info sums (deep mode) */
+    unsigned long long bytes_acked;
+    unsigned long long bytes_received;
+    unsigned long long total_retrans;
+    unsigned long long rtt_sum_us;
+    unsigned long long rmem_alloc;
+    unsigned long long wmem_queued;
+    double send_bps;
+    double recv_bps;
+    double retrans_per_sec;
+} Group;
+
+/*
+   Groups + open-addressing index (linear probing, backward-shift delete).
+   Exact mode grows without bound; sketch mode (max_groups > 0) is the
+   space-saving algorithm: at most max_groups counters, a new key replaces the
+   smallest counter (kept at the root of a min-heap) and inherits its count
+   as the error bound.
+*/
+typedef struct {
+    Group  *groups;
+    size_t  count;
+    size_t  capacity;
+    size_t  max_groups;     /* 0 = exact */
+    int    *slots;          /* group index, -1 = empty */
+    size_t  slot_mask;
+    size_t *heap;           /* sketch only: group indices, min count at [0] */
+    size_t *heap_pos;       /* sketch only: group index → heap position */
+} GroupTable;
+
+static size_t group_key_hash(const GroupKey *k) {
+    /* FNV-1a over the key bytes */
+    const unsigned char *p = (const unsigned char *)k;
+    size_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < sizeof(*k); i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int group_table_init(GroupTable *t, size_t max_groups) {
+    memset(t, 0, sizeof(*t));
+    t->max_groups = max_groups;
+
+    size_t slots = 1024;
+    while (max_groups && slots < max_groups * 2) slots *= 2;
+    t->slots = malloc(slots * sizeof(int));
+    if (!t->slots) return -1;
+    memset(t->slots, 0xff, slots * sizeof(int));
+    t->slot_mask = slots - 1;
+
+    if (max_groups) {
+        t->groups = calloc(max_groups, sizeof(Group));
+        t->heap = malloc(max_groups * sizeof(size_t));
+        t->heap_pos = malloc(max_groups * sizeof(size_t));
+        t->capacity = max_groups;
+        if (!t->groups || !t->heap || !t->heap_pos) return -1;
+    }
+    return 0;
+}
+
+static void group_table_free(GroupTable *t) {
+    free(t->groups);
+    free(t->slots);
+    free(t->heap);
+    free(t->heap_pos);
+    memset(t, 0, sizeof(*t));
+}
+
+/* Slot holding 'k', or the empty slot where it would go */
+static size_t group_slot(const GroupTable *t, const GroupKey *k) {
+    size_t i = group_key_hash(k) & t->slot_mask;
+    while (t->slots[i] >= 0 && memcmp(&t->groups[t->slots[i]].key, k, sizeof(*k)) != 0)
+        i = (i + 1) & t->slot_mask;
+    return i;
+}
+
+static void group_rehash(GroupTable *t, size_t new_size) {
+    int *slots = malloc(new_size * sizeof(int));
+    if (!slots) return;
+    memset(slots, 0xff, new_size * sizeof(int));
+    free(t->slots);
+    t->slots = slots;
+    t->slot_mask = new_size - 1;
+    for (size_t g = 0; g < t->count; g++) t->slots[group_slot(t, &t->groups[g].key)] = (int)g;
+}
+
+/* Remove the index entry in slot i, shifting later probe-chain members back */
+static void group_slot_delete(GroupTable *t, size_t i) {
+    size_t j = i;
+    t->slots[i] = -1;
+    for (;;) {
+        j = (j + 1) & t->slot_mask;
+        if (t->slots[j] < 0) return;
+        size_t home = group_key_hash(&t->groups[t->slots[j]].key) & t->slot_mask;
+        /* move j back into the hole unless its home lies cyclically in (i, j] */
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            t->slots[i] = t->slots[j];
+            t->slots[j] = -1;
+            i = j;
+        }
+    }
+}
+
+static void heap_swap(GroupTable *t, size_t a, size_t b) {
+    size_t ga = t->heap[a], gb = t->heap[b];
+    t->heap[a] = gb; t->heap_pos[gb] = a;
+    t->heap[b] = ga; t->heap_pos[ga] = b;
+}
+
+static void heap_sift_down(GroupTable *t, size_t pos) {
+    for (;;) {
+        size_t l = 2 * pos + 1, r = l + 1, m = pos;
+        if (l < t->count && t->groups[t->heap[l]].count < t->groups[t->heap[m]].count) m = l;
+        if (r < t->count && t->groups[t->heap[r]].count < t->groups[t->heap[m]].count) m = r;
+        if (m == pos) return;
+        heap_swap(t, pos, m);
+        pos = m;
+    }
+}
+
+static void heap_sift_up(GroupTable *t, size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (t->groups[t->heap[parent]].count <= t->groups[t->heap[pos]].count) return;
+        heap_swap(t, pos, parent);
+        pos = parent;
+    }
+}
+
+static void group_add_conn(Group *g, const Connection *c) {
+    g->count++;
+    g->samples++;
+    g->bytes_acked     += c->info.bytes_acked;
+    g->bytes_received  += c->info.bytes_received;
+    g->total_retrans   += c->info.total_retrans;
+    g->rtt_sum_us      += c->info.rtt_us;
+    g->rmem_alloc      += c->info.rmem_alloc;
+    g->wmem_queued     += c->info.wmem_queued;
+    g->send_bps        += c->send_bps;
+    g->recv_bps        += c->recv_bps;
+    g->retrans_per_sec += c->retrans_per_sec;
+}
+
+static void group_table_add(GroupTable *t, const GroupKey *k, const Connection *c) {
+    size_t slot = group_slot(t, k);
+
+    if (t->slots[slot] >= 0) {
+        size_t g = (size_t)t->slots[slot];
+        group_add_conn(&t->groups[g], c);
+        if (t->max_groups) heap_sift_down(t, t->heap_pos[g]);
         return;
     }
 
-    /* Step 2: Scan all processes to find who owns each inode */
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
-        free(connections);
+    if (t->max_groups && t->count == t->max_groups) {
+        /* Space-saving: evict the minimum counter and reuse it for the new key */
+        size_t g = t->heap[0];
+        unsigned long min_count = t->groups[g].count;
+        group_slot_delete(t, group_slot(t, &t->groups[g].key));
+
+        memset(&t->groups[g], 0, sizeof(Group));
+        t->groups[g].key = *k;
+        snprintf(t->groups[g].comm, sizeof(t->groups[g].comm), "%s", c->comm);
+        group_add_conn(&t->groups[g], c);
+        t->groups[g].count += min_count;
+        t->groups[g].error = min_count;
+        t->slots[group_slot(t, k)] = (int)g;
+        heap_sift_down(t, 0);
+        return;
+    }
+
+    if (!t->max_groups && t->count >= t->capacity) {
+        size_t newcap = t->capacity ? t->capacity * 2 : 1024;
+        Group *ng = realloc(t->groups, newcap * sizeof(Group));
+        if (!ng) return;
+        t->groups = ng;
+        t->capacity = newcap;
+    }
+
+    size_t g = t->count++;
+    memset(&t->groups[g], 0, sizeof(Group));
+    t->groups[g].key = *k;
+    snprintf(t->groups[g].comm, sizeof(t->groups[g].comm), "%s", c->comm);
+    group_add_conn(&t->groups[g], c);
+    t->slots[slot] = (int)g;
+
+    if (t->max_groups) {
+        t->heap[g] = g;
+        t->heap_pos[g] = g;
+        heap_sift_up(t, g);
+    } else if (t->count * 2 > t->slot_mask + 1) {
+        group_rehash(t, (t->slot_mask + 1) * 2);
+    }
+}
+
+/* Build the group key for one connection; false if it does not belong in any group */
+static bool make_group_key(const Connection *c, GroupBy by, GroupKey *k) {
+    memset(k, 0, sizeof(*k));
+
+    switch (by) {
+    case GROUP_PID_LPORT:
+        if (c->pid == 0) return false;
+        k->pid = c->pid;
+        k->local_port = c->local_port;
+        return true;
+
+    case GROUP_PID_REMOTE:
+        if (c->pid == 0) return false;
+        k->pid = c->pid;
+        k->family = c->family;
+        k->prefix_len = c->family == AF_INET ? 32 : 128;
+        memcpy(k->addr, c->remote_addr, sizeof(k->addr));
+        return true;
+
+    case GROUP_REMOTE_NET: {
+        /* Unowned connections still count towards their remote network */
+        static const unsigned char v4mapped[12] = { 0,0,0,0, 0,0,0,0, 0,0,0xff,0xff };
+        if (c->family == AF_INET6 && memcmp(c->remote_addr, v4mapped, sizeof(v4mapped)) == 0) {
+            k->family = AF_INET;
+            memcpy(k->addr, c->remote_addr + 12, 3);          /* /24 */
+            k->prefix_len = 24;
+        } else if (c->family == AF_INET6) {
+            k->family = AF_INET6;
+            memcpy(k->addr, c->remote_addr, 8);               /* /64 */
+            k->prefix_len = 64;
+        } else {
+            k->family = AF_INET;
+            memcpy(k->addr, c->remote_addr, 3);               /* /24 */
+            k->prefix_len = 24;
+        }
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/* Largest groups first; ties by key for stable output */
+static int group_count_cmp(const void *a, const void *b) {
+    const Group *ga = a;
+    const Group *gb = b;
+    if (ga->count != gb->count) return ga->count < gb->count ? 1 : -1;
+    return memcmp(&ga->key, &gb->key, sizeof(GroupKey));
+}
+
+/* Aggregated output: one row per group, sorted by connection count */
+static void print_groups(const Connection *connections, size_t conn_count, const TcpScanOptions *opts) {
+    GroupTable table;
+    if (group_table_init(&table, opts->top_k) < 0) {
+        group_table_free(&table);
         printf("[]\n");
         return;
     }
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
+    for (size_t i = 0; i < conn_count; i++) {
+        GroupKey k;
+        if (make_group_key(&connections[i], opts->group_by, &k))
+            group_table_add(&table, &k, &connections[i]);
+    }
 
-        int pid = atoi(ent->d_name);
+    qsort(table.groups, table.count, sizeof(Group), group_count_cmp);
 
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
+    /* === OUTPUT – replace this block with your database insert === */
+    printf("[\n");
+    for (size_t i = 0; i < table.count; i++) {
+        const Group *g = &table.groups[i];
+        char ip[INET6_ADDRSTRLEN] = "";
+        if (g->key.family) inet_ntop(g->key.family, g->key.addr, ip, sizeof(ip));
+
+        switch (opts->group_by) {
+        case GROUP_PID_REMOTE:
+            printf("  {\"pid\":%d,\"comm\":\"%s\",\"remote_ip\":\"%s\"", g->key.pid, g->comm, ip);
+            break;
+        case GROUP_PID_LPORT:
+            printf("  {\"pid\":%d,\"comm\":\"%s\",\"local_port\":%hu", g->key.pid, g->comm, g->key.local_port);
+            break;
+        default:
+            printf("  {\"remote_net\":\"%s/%u\"", ip, g->key.prefix_len);
+            break;
+        }
+
+        printf(",\"connections\":%lu", g->count);
+        if (opts->top_k) printf(",\"count_error\":%lu", g->error);
+        if (opts->tcp_info) {
+            printf(",\"bytes_acked\":%llu,\"bytes_received\":%llu,\"total_retrans\":%llu,"
+                   "\"avg_rtt_us\":%llu,\"rmem_alloc\":%llu,\"wmem_queued\":%llu",
+                   g->bytes_acked, g->bytes_received, g->total_retrans,
+                   g->rtt_sum_us / g->samples, g->rmem_alloc, g->wmem_queued);
+            if (opts->interval_ms)
+                printf(",\"send_bps\":%.0f,\"recv_bps\":%.0f,\"retrans_per_sec\":%.2f",
+                       g->send_bps, g->recv_bps, g->retrans_per_sec);
+        }
+        printf("}");
+
+        if (i < table.count - 1) printf(",");
+        printf("\n");
+    }
+    printf("]\n");
+
+    group_table_free(&table);
+}
+
+/*
+Scanner: Established TCP connections (with process PID/comm)
+Parses /proc/net/tcp for established entries (state 01), collects inode, local/remote IP/port.
+Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm
+(scanner_sockowner.h; with opts->owner_cache only changed fd tables are re-read).
+Output: JSON array of {pid, comm, local_ip, local_port, remote_ip, remote_port, inode} for each established TCP connection.
+Note: Run as root to see all (some /proc/pid/fd restricted).
+Only IPv4 for simplicity; add IPv6 from /proc/net/tcp6 if needed.
+
+Deep mode (opts->tcp_info): one NETLINK_SOCK_DIAG dump per family (IPv4 + IPv6) replaces
+/proc/net/tcp and carries struct tcp_info + skmeminfo for every established socket.
+With opts->interval_ms a second dump is taken and per-connection / per-process
+throughput and retransmit rates are computed from the deltas over the measured time
+between the two dumps.
+Output: {"connections":[...], "processes":[...]}
+
+Aggregation (opts->group_by): rows are grouped by (pid, remote_ip), (pid, local_port)
+or remote /24 in a hash table and emitted as one row per group with a connection
+count (plus tcp_info sums in deep mode), largest first. With opts->top_k only a
+space-saving sketch of top_k counters is kept, so memory stays bounded no matter
+how many distinct peers there are; count_error is the per-row overestimate bound.
+*/
+void scan_established_tcp_connections(const TcpScanOptions *opts)
+{
+    Connection *connections = NULL;
+    size_t conn_capacity = 0;
+    size_t conn_count = 0;
+
+    /* Step 1: Collect established connections + inodes */
+    if (opts->tcp_info) {
+        /* Rates use the measured time between the midpoints of the two dumps, not the
+           nominal interval: a slow dump on a busy host would otherwise inflate them */
+        unsigned long long dump_start = now_us();
+        if (sock_diag_established(&connections, &conn_count, &conn_capacity) < 0) {
+            free(connections);
+            printf("[]\n");
+            return;
         }
 
-        /* Scan /proc/pid/fd for socket:[inode] */
-        char fd_path[64];
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
-        DIR *fddir = opendir(fd_path);
-        if (!fddir) continue;
-
-        struct dirent *fdent;
-        while ((fdent = readdir(fddir)) != NULL) {
-            if (!isdigit((unsigned char)fdent->d_name[0])) continue;
-
-            char link_path[128];
-            /* Bound the written fd name to avoid snprintf truncation warning */
-            size_t fd_path_len = strlen(fd_path);
-            int max_name_len = (int)sizeof(link_path) - (int)fd_path_len - 2;
-            if (max_name_len < 0) max_name_len = 0;
-            snprintf(link_path, sizeof(link_path), "%s/%.*s", fd_path, max_name_len, fdent->d_name);
-
-            char target[PATH_MAX + 1];
-            ssize_t tlen = readlink(link_path, target, PATH_MAX);
-            if (tlen < 0) continue;
-            target[tlen] = '\0';
-
-            /* Check if socket:[inode] */
-            char inode_str[32];
-            if (sscanf(target, "socket:[%31[^]]", inode_str) != 1) continue;
-
-            /* Match against connections */
-            for (size_t k = 0; k < conn_count; k++) {
-                if (connections[k].pid == 0 && strcmp(inode_str, connections[k].inode) == 0) {
-                    connections[k].pid = pid;
-                    /* --- FIX: use snprintf to safely copy comm and ensure NUL termination --- */
-                    snprintf(connections[k].comm, sizeof(connections[k].comm), "%s", comm);
-                    break;  /* Assume one owner per inode */
-                }
+        if (opts->interval_ms > 0) {
+            unsigned long long prev_us = (dump_start + now_us()) / 2;
+            Connection *prev = connections;
+            size_t prev_count = conn_count;
+            connections = NULL;
+            conn_count = conn_capacity = 0;
+
+            struct timespec ts = { .tv_sec = opts->interval_ms / 1000,
+                                   .tv_nsec = (long)(opts->interval_ms % 1000) * 1000000L };
+            nanosleep(&ts, NULL);
+
+            dump_start = now_us();
+            if (sock_diag_established(&connections, &conn_count, &conn_capacity) < 0) {
+                free(prev);
+                free(connections);
+                printf("[]\n");
+                return;
             }
+            double secs = (double)((dump_start + now_us()) / 2 - prev_us) / 1e6;
+            if (secs <= 0) secs = opts->interval_ms / 1000.0;
+            compute_rates(connections, conn_count, prev, prev_count, secs);
+            free(prev);
         }
-        closedir(fddir);
+    } else if (read_proc_net_tcp(&connections, &conn_count, &conn_capacity) < 0) {
+        printf("[]\n");
+        return;
     }
 
-    closedir(proc);
+    if (conn_count == 0) {
+        free(connections);
+        printf(opts->tcp_info && opts->group_by == GROUP_NONE ? "{\"connections\":[],\"processes\":[]}\n" : "[]\n");
+        return;
+    }
+
+    /* Step 2: Scan all processes to find who owns each inode */
+    resolve_owners(connections, conn_count, opts->owner_cache);
 
     /* Sort by PID then local_port */
     qsort(connections, conn_count, sizeof(Connection), pid_cmp);
 
+    if (opts->group_by != GROUP_NONE) {
+        print_groups(connections, conn_count, opts);
+        free(connections);
+        return;
+    }
+
+    if (opts->tcp_info) {
+        print_deep(connections, conn_count);
+        free(connections);
+        return;
+    }
+
     /* === OUTPUT – replace this block with your database insert === */
     printf("[\n");
     for (size_t i = 0; i < conn_count; i++) {
@@ -209,8 +849,46 @@ void scan_established_tcp_connections(void)
     free(connections);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_established_tcp_connections();
+    TcpScanOptions opts = { .tcp_info = false, .interval_ms = 0, .owner_cache = NULL,
+                            .group_by = GROUP_NONE, .top_k = 0 };
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tcp-info") == 0) {
+            opts.tcp_info = true;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            opts.interval_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+            opts.tcp_info = true;   /* rates need tcp_info counters */
+        } else if (strcmp(argv[i], "--owner-cache") == 0 && i + 1 < argc) {
+            opts.owner_cache = argv[++i];
+        } else if (strcmp(argv[i], "--group-by") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "pid-remote") == 0)      opts.group_by = GROUP_PID_REMOTE;
+            else if (strcmp(argv[i], "pid-lport") == 0)  opts.group_by = GROUP_PID_LPORT;
+            else if (strcmp(argv[i], "remote24") == 0)   opts.group_by = GROUP_REMOTE_NET;
+            else bad_args = true;
+        } else if (strcmp(argv[i], "--top-k") == 0 && i + 1 < argc) {
+            opts.top_k = strtoul(argv[++i], NULL, 10);
+            if (opts.top_k == 0) bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+    if (opts.top_k && opts.group_by == GROUP_NONE) bad_args = true;
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                       # Established TCP connections → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --tcp-info            # + RTT/retransmits/bytes/socket memory via sock_diag\n", argv[0]);
+        fprintf(stderr, "  %s --interval <ms>       # + per-connection and per-process rates over <ms>\n", argv[0]);
+        fprintf(stderr, "  %s --owner-cache <file>  # Reuse socket owners from previous run (incremental fd walk)\n", argv[0]);
+        fprintf(stderr, "  %s --group-by <pid-remote|pid-lport|remote24>   # One row per group with counts\n", argv[0]);
+        fprintf(stderr, "  %s --group-by <key> --top-k <K>                 # Bounded top-K heavy hitters (space-saving)\n", argv[0]);
+        return 1;
+    }
+
+    scan_established_tcp_connections(&opts);
     return 0;
 }
@@ -4,6 +4,11 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_topn.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
@@ -17,6 +22,7 @@ typedef struct {
     char **thread_names;          /* array of thread comm names */
     size_t name_count;
     size_t name_capacity;
+    ProcAttr attr;                /* namespaces/cgroup/container (--ns, --group-by) */
 } ProcThreads;
 
 static void add_thread_name(ProcThreads *p, const char *name) {
@@ -45,13 +51,19 @@ static void free_procthreads(ProcThreads *p) {
    - thread_count: from /proc/<pid>/status "Threads:" or by counting entries under /proc/<pid>/task/
    - thread_names: comm from each /proc/<pid>/task/<tid>/comm
 
+   scope (may be NULL) limits the scan to members of cgroups; attrs adds
+   namespace/cgroup/container columns or grouping (scanner_proc_attrs.h).
+   top > 0 keeps only the processes with most threads (bounded heap, scanner_topn.h):
+   the count comes from the link count of /proc/<pid>/task, and comm, attributes
+   and thread names are only read for processes that can make the cut; rows come
+   out most threads first.
+
    Output: JSON array of {pid, comm, thread_count, threads: ["name1", "name2", ...]}
 */
-void scan_process_threads(void)
+void scan_process_threads(const ProcScope *scope, ProcAttrs *attrs, size_t top_n)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, scope)) {
         return;
     }
 
@@ -59,38 +71,41 @@ void scan_process_threads(void)
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Get main comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
+    TopN top;
+    if (!topn_init(&top, top_n, sizeof(ProcThreads))) {
+        proc_iter_close(&it);
+        printf("[]\n");
+        return;
+    }
+
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        int pid = h.pid;
+
+        /* --top: a task directory's link count is threads + 2, no need to walk it first */
+        double key = 0;
+        if (topn_enabled(&top)) {
+            struct stat st;
+            if (fstatat(h.dirfd, "task", &st, 0) != 0 || st.st_nlink < 3 ||
+                !topn_would_enter(&top, (double)(st.st_nlink - 2))) {
+                proc_handle_close(&h);
+                continue;
             }
-            fclose(fc);
+            key = (double)(st.st_nlink - 2);
         }
 
         /* Open /proc/<pid>/task directory */
-        char task_path[64];
-        snprintf(task_path, sizeof(task_path), "/proc/%d/task", pid);
-
-        DIR *taskdir = opendir(task_path);
-        if (!taskdir) continue;
+        DIR *taskdir = proc_handle_opendir(&h, "task");
+        if (!taskdir) {
+            proc_handle_close(&h);
+            continue;
+        }
 
         ProcThreads info = { .pid = pid, .thread_count = 0,
                              .name_count = 0, .name_capacity = 0, .thread_names = NULL };
-        /* safe copy of comm to avoid truncation warnings */
-        snprintf(info.comm, sizeof(info.comm), "%s", comm);
+        if (proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, pid, &info.attr);
+        /* main comm came with the iterator's stat read */
+        snprintf(info.comm, sizeof(info.comm), "%s", proc_handle_comm(&h));
 
         struct dirent *taskent;
         while ((taskent = readdir(taskdir)) != NULL) {
@@ -101,10 +116,10 @@ void scan_process_threads(void)
             if (tid <= 0) continue;
 
             /* Get thread comm */
-            char tcomm_path[128];
-            snprintf(tcomm_path, sizeof(tcomm_path), "/proc/%d/task/%d/comm", pid, tid);
+            char tcomm_path[64];
+            snprintf(tcomm_path, sizeof(tcomm_path), "task/%d/comm", tid);
 
-            FILE *ftc = fopen(tcomm_path, "re");
+            FILE *ftc = proc_handle_fopen(&h, tcomm_path);
             if (!ftc) continue;
 
             char tcomm[17] = "[thread]";
@@ -118,12 +133,19 @@ void scan_process_threads(void)
             info.thread_count++;
         }
         closedir(taskdir);
+        proc_handle_close(&h);
 
         if (info.thread_count == 0) {
             free_procthreads(&info);
             continue;
         }
 
+        if (topn_enabled(&top)) {
+            ProcThreads evicted;
+            if (topn_push(&top, key, &info, &evicted)) free_procthreads(&evicted);
+            continue;
+        }
+
         /* Grow main array */
         if (count >= capacity) {
             capacity = capacity ? capacity * 2 : 8192;
@@ -138,7 +160,8 @@ void scan_process_threads(void)
         processes[count++] = info;
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
+    if (topn_enabled(&top)) processes = topn_finish(&top, &count);
 
     if (count == 0) {
         free(processes);
@@ -146,13 +169,19 @@ void scan_process_threads(void)
         return;
     }
 
-    /* Sort by PID */
-    qsort(processes, count, sizeof(ProcThreads), pid_cmp);
+    /* Sort by PID (--top: already most threads first) */
+    if (!top_n) {
+        qsort(processes, count, sizeof(ProcThreads), pid_cmp);
+        proc_attrs_sort(attrs, processes, count, sizeof(ProcThreads), offsetof(ProcThreads, attr));
+    } else {
+        proc_attrs_sort_ranked(attrs, processes, count, sizeof(ProcThreads), offsetof(ProcThreads, attr));
+    }
 
     /* === OUTPUT – replace this block with your DB insert === */
     printf("[\n");
     for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\",\"thread_count\":%d,\"threads\":[",
+        proc_attrs_row_sep(attrs, i ? &processes[i-1].attr : NULL, &processes[i].attr);
+        printf("{\"pid\":%d,\"comm\":\"%s\",\"thread_count\":%d,\"threads\":[",
                processes[i].pid, processes[i].comm, processes[i].thread_count);
 
         for (size_t j = 0; j < processes[i].name_count; j++) {
@@ -166,10 +195,11 @@ void scan_process_threads(void)
             if (j < processes[i].name_count - 1) printf(",");
         }
 
-        printf("]}");
-        if (i < count - 1) printf(",");
-        printf("\n");
+        printf("]");
+        proc_attrs_print(attrs, &processes[i].attr);
+        printf("}");
     }
+    proc_attrs_end(attrs, count > 0);
     printf("]\n");
 
     /* Cleanup */
@@ -179,8 +209,43 @@ void scan_process_threads(void)
     free(processes);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_process_threads();
+    ProcScope scope = { 0 };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    size_t top_n = 0;
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top_n = strtoul(argv[++i], NULL, 10);
+            if (top_n == 0) bad_args = true;
+        } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+            if (strcmp(argv[++i], "threads") != 0) bad_args = true;
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                  # Threads and thread names per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --top <n> [--by threads]\n", argv[0]);
+        fprintf(stderr, "      # Only the n processes with most threads, most first; thread names skipped for the rest\n");
+        fprintf(stderr, "  %s --cgroup <path>[,<path>...] [--cgroup-threads]\n", argv[0]);
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  %s --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n", argv[0]);
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  %s --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n", argv[0]);
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them\n");
+        return 1;
+    }
+
+    scan_process_threads(&scope, &attrs, top_n);
+    proc_scope_free(&scope);
+    proc_attrs_free(&attrs);
     return 0;
 }
@@ -0,0 +1,152 @@
+/*
+   scanner_topn.h - bounded top-N selection for per-process scanners
+
+   Header-only (static inline) so every scanner still builds as a single file:
+       gcc scanner_memory.c -o scanner_memory -pthread
+
+   A TopN keeps the N rows with the largest keys seen so far in a min-heap of
+   fixed-size rows: memory is O(N) however many processes the host runs, and
+   topn_would_enter() lets a scanner skip secondary reads (taskstats, smaps_rollup,
+   thread names, ...) for a process whose primary key cannot make the cut.
+
+       TopN top;
+       topn_init(&top, n, sizeof(Row));              n = 0: off
+       per process:  key from the cheap read
+                     if (!topn_would_enter(&top, key)) continue;
+                     ... secondary reads ...
+                     topn_push(&top, key, &row, &evicted)   evicted may be NULL
+       topn_row(&top, i) / topn_rekey(&top, i, key)  update a kept row in place
+       rows = topn_finish(&top, &count);             largest key first; caller frees
+*/
+#ifndef SCANNER_TOPN_H
+#define SCANNER_TOPN_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+typedef struct {
+    size_t  limit;            /* N; 0 = selection off */
+    size_t  row_size;
+    size_t  count;
+    char   *rows;             /* limit rows, heap order (smallest key at 0) */
+    double *keys;
+    char   *tmp;              /* one row of swap space */
+} TopN;
+
+/* false on allocation failure (the TopN is then off) */
+static inline bool topn_init(TopN *t, size_t limit, size_t row_size) {
+    memset(t, 0, sizeof(*t));
+    if (limit == 0) return true;
+    t->rows = malloc(limit * row_size);
+    t->keys = malloc(limit * sizeof(double));
+    t->tmp = malloc(row_size);
+    if (!t->rows || !t->keys || !t->tmp) {
+        free(t->rows);
+        free(t->keys);
+        free(t->tmp);
+        memset(t, 0, sizeof(*t));
+        return false;
+    }
+    t->limit = limit;
+    t->row_size = row_size;
+    return true;
+}
+
+static inline void topn_free(TopN *t) {
+    free(t->rows);
+    free(t->keys);
+    free(t->tmp);
+    memset(t, 0, sizeof(*t));
+}
+
+static inline bool topn_enabled(const TopN *t) {
+    return t->limit > 0;
+}
+
+/* Would a row with this key be kept right now? (always true while the heap is not full) */
+static inline bool topn_would_enter(const TopN *t, double key) {
+    return t->limit == 0 || t->count < t->limit || key > t->keys[0];
+}
+
+static inline void topn_swap(TopN *t, size_t a, size_t b) {
+    double k = t->keys[a];
+    t->keys[a] = t->keys[b];
+    t->keys[b] = k;
+    memcpy(t->tmp, t->rows + a * t->row_size, t->row_size);
+    memcpy(t->rows + a * t->row_size, t->rows + b * t->row_size, t->row_size);
+    memcpy(t->rows + b * t->row_size, t->tmp, t->row_size);
+}
+
+static inline void topn_sift_down(TopN *t, size_t i, size_t n) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && t->keys[l] < t->keys[m]) m = l;
+        if (r < n && t->keys[r] < t->keys[m]) m = r;
+        if (m == i) return;
+        topn_swap(t, i, m);
+        i = m;
+    }
+}
+
+/*
+   Add a row (caller checked topn_would_enter). When the heap is full the current
+   minimum is dropped: copied to evicted if non-NULL (so the caller can release
+   memory it owns) and true is returned.
+*/
+static inline bool topn_push(TopN *t, double key, const void *row, void *evicted) {
+    if (t->count < t->limit) {
+        size_t i = t->count++;
+        t->keys[i] = key;
+        memcpy(t->rows + i * t->row_size, row, t->row_size);
+        while (i > 0 && t->keys[(i - 1) / 2] > t->keys[i]) {
+            topn_swap(t, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+        return false;
+    }
+    if (evicted) memcpy(evicted, t->rows, t->row_size);
+    t->keys[0] = key;
+    memcpy(t->rows, row, t->row_size);
+    topn_sift_down(t, 0, t->count);
+    return true;
+}
+
+/* Row i of the heap (unordered), to update a kept row in place */
+static inline void *topn_row(TopN *t, size_t i) {
+    return t->rows + i * t->row_size;
+}
+
+/* Row i's key changed: restore heap order */
+static inline void topn_rekey(TopN *t, size_t i, double key) {
+    t->keys[i] = key;
+    while (i > 0 && t->keys[(i - 1) / 2] > t->keys[i]) {
+        topn_swap(t, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    topn_sift_down(t, i, t->count);
+}
+
+/* Rows ordered by key, largest first; ownership passes to the caller (free()). The TopN is reset */
+static inline void *topn_finish(TopN *t, size_t *count) {
+    /* Heapsort on the min-heap: each pass moves the smallest to the end */
+    for (size_t n = t->count; n > 1; n--) {
+        topn_swap(t, 0, n - 1);
+        topn_sift_down(t, 0, n - 1);
+    }
+    void *rows = t->rows;
+    *count = t->count;
+    t->rows = NULL;
+    topn_free(t);
+    return rows;
+}
+
+/* Index of name in names[0..n), -1 if absent (for --by) */
+static inline int topn_field(const char *name, const char *const *names, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(name, names[i]) == 0) return (int)i;
+    }
+    return -1;
+}
+
+#endif /* SCANNER_TOPN_H */
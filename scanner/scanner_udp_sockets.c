@@ -1,10 +1,10 @@
 #include <stdio.h>
-#include <dirent.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
-#include <unistd.h> /* for readlink */
-#include <limits.h> /* for PATH_MAX */
+#include <stdbool.h>
+#include <time.h> /* for nanosleep, clock_gettime */
+#include <arpa/inet.h> /* for inet_ntop */
+#include "scanner_sockowner.h"
 
 /* Tagged struct so 'struct Socket' is defined before use in pid_cmp */
 typedef struct Socket {
@@ -15,6 +15,7 @@ typedef struct Socket {
     unsigned short remote_port; /* remote port (host byte order) */
     char remote_ip[32]; /* remote IP (e.g., "8.8.8.8") */
     char inode[32]; /* socket inode for reference */
+    unsigned long ino; /* numeric inode for owner lookup */
 } Socket;
 
 /* Comparator for qsort by PID, then local_port */
@@ -28,13 +29,14 @@ static int pid_cmp(const void *a, const void *b) {
 /*
 Scanner: UDP sockets (with process PID/comm)
 Parses /proc/net/udp for all entries, collects inode, local/remote IP/port.
-Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm.
+Then scans all /proc/<pid>/fd to match socket:[inode] and associate PID/comm
+(scanner_sockowner.h; with owner_cache only changed fd tables are re-read).
 Output: JSON array of {pid, comm, local_ip, local_port, remote_ip, remote_port, inode} for each UDP socket.
 Note: Run as root to see all (some /proc/pid/fd restricted).
 Only IPv4 for simplicity; add IPv6 from /proc/net/udp6 if needed.
 Remote IP/port may be "0.0.0.0:0" for unbound/listening sockets.
 */
-void scan_udp_sockets(void)
+void scan_udp_sockets(const char *owner_cache)
 {
     /* Step 1: Parse /proc/net/udp for all sockets + inodes */
     FILE *udp = fopen("/proc/net/udp", "re");
@@ -54,10 +56,10 @@ void scan_udp_sockets(void)
         unsigned short local_port_hex;
         unsigned int remote_ip_hex;
         unsigned short remote_port_hex;
-        char inode_str[32];
-        /* Corrected sscanf: skip to inode properly (7 skips after st) */
-        if (sscanf(line, "%*d: %8X:%4hX %8X:%4hX %*2X %*s %*s %*s %*s %*s %*s %*s %31s",
-                &local_ip_hex, &local_port_hex, &remote_ip_hex, &remote_port_hex, inode_str) != 5) {
+        unsigned long inode;
+        /* After st: tx_queue:rx_queue tr:tm->when retrnsmt uid timeout, then inode */
+        if (sscanf(line, "%*d: %8X:%4hX %8X:%4hX %*2X %*s %*s %*s %*s %*s %lu",
+                &local_ip_hex, &local_port_hex, &remote_ip_hex, &remote_port_hex, &inode) != 5) {
             continue;
         }
         /* Convert IPs to dotted decimal */
@@ -86,7 +88,8 @@ void scan_udp_sockets(void)
         snprintf(sockets[sock_count].local_ip, sizeof(sockets[sock_count].local_ip), "%s", local_ip);
         sockets[sock_count].remote_port = remote_port_hex;
         snprintf(sockets[sock_count].remote_ip, sizeof(sockets[sock_count].remote_ip), "%s", remote_ip);
-        snprintf(sockets[sock_count].inode, sizeof(sockets[sock_count].inode), "%s", inode_str);
+        snprintf(sockets[sock_count].inode, sizeof(sockets[sock_count].inode), "%lu", inode);
+        sockets[sock_count].ino = inode;
         sock_count++;
     }
     fclose(udp);
@@ -95,63 +98,24 @@ void scan_udp_sockets(void)
         printf("[]\n");
         return;
     }
-    /* Step 2: Scan all processes to find who owns each inode */
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
-        free(sockets);
-        printf("[]\n");
-        return;
+    /* Step 2: Find who owns each inode */
+    SockOwnerCache cache;
+    sockowner_cache_init(&cache);
+    if (owner_cache) sockowner_cache_load(&cache, owner_cache);
+    unsigned long *wanted = malloc(sock_count * sizeof(unsigned long));
+    if (wanted) {
+        for (size_t i = 0; i < sock_count; i++) wanted[i] = sockets[i].ino;
+        sockowner_refresh(&cache, wanted, sock_count);
+        free(wanted);
     }
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-        int pid = atoi(ent->d_name);
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
-        }
-        /* Scan /proc/pid/fd for socket:[inode] */
-        char fd_path[64];
-        snprintf(fd_path, sizeof(fd_path), "/proc/%d/fd", pid);
-        DIR *fddir = opendir(fd_path);
-        if (!fddir) continue;
-        struct dirent *fdent;
-        while ((fdent = readdir(fddir)) != NULL) {
-            if (!isdigit((unsigned char)fdent->d_name[0])) continue;
-            char link_path[128];
-            size_t fd_path_len = strlen(fd_path);
-            int max_name_len = (int)sizeof(link_path) - (int)fd_path_len - 2;
-            if (max_name_len < 0) max_name_len = 0;
-            snprintf(link_path, sizeof(link_path), "%s/%.*s", fd_path, max_name_len, fdent->d_name);
-            char target[PATH_MAX + 1];
-            ssize_t tlen = readlink(link_path, target, PATH_MAX);
-            if (tlen < 0) continue;
-            target[tlen] = '\0';
-            /* Check if socket:[inode] */
-            char inode_str[32];
-            if (sscanf(target, "socket:[%31[^]]", inode_str) != 1) continue;
-            /* Match against sockets */
-            for (size_t k = 0; k < sock_count; k++) {
-                if (sockets[k].pid == 0 && strcmp(inode_str, sockets[k].inode) == 0) {
-                    sockets[k].pid = pid;
-                    snprintf(sockets[k].comm, sizeof(sockets[k].comm), "%s", comm);
-                    break; /* Assume one owner per inode */
-                }
-            }
-        }
-        closedir(fddir);
+    for (size_t k = 0; k < sock_count; k++) {
+        SockOwner owner;
+        if (!sockowner_first(&cache, sockets[k].ino, &owner)) continue; /* Assume one owner per inode */
+        sockets[k].pid = owner.pid;
+        snprintf(sockets[k].comm, sizeof(sockets[k].comm), "%s", owner.comm);
     }
-    closedir(proc);
+    if (owner_cache) sockowner_cache_save(&cache, owner_cache);
+    sockowner_cache_free(&cache);
     /* Sort by PID then local_port */
     qsort(sockets, sock_count, sizeof(Socket), pid_cmp);
     /* === OUTPUT – replace this block with your database insert === */
@@ -178,8 +142,251 @@ void scan_udp_sockets(void)
     free(sockets);
 }
 
-int main(void)
+/* One row of /proc/net/udp{,6} with the queue/drop columns kept */
+typedef struct {
+    int pid;
+    char comm[17];
+    unsigned short local_port;
+    char local_ip[INET6_ADDRSTRLEN];
+    unsigned short remote_port;
+    char remote_ip[INET6_ADDRSTRLEN];
+    unsigned long ino;
+    unsigned long tx_queue;   /* bytes in send queue */
+    unsigned long rx_queue;   /* bytes in receive queue */
+    unsigned long drops;      /* datagrams dropped (cumulative, per socket) */
+    bool has_rate;
+    double drop_rate;         /* drops per second between the two samples */
+} UdpQueue;
+
+typedef struct {
+    unsigned interval_ms;     /* > 0: second sample, compute drop_rate */
+    unsigned long min_rx_queue;
+    unsigned long min_tx_queue;
+    unsigned long min_drops;
+    double min_drop_rate;
+    const char *owner_cache;
+} UdpDropOptions;
+
+static int udpq_pid_cmp(const void *a, const void *b) {
+    const UdpQueue *pa = a;
+    const UdpQueue *pb = b;
+    if (pa->pid != pb->pid) return pa->pid - pb->pid;
+    return pa->local_port - pb->local_port;
+}
+
+static int udpq_ino_cmp(const void *a, const void *b) {
+    const UdpQueue *pa = a;
+    const UdpQueue *pb = b;
+    return (pa->ino > pb->ino) - (pa->ino < pb->ino);
+}
+
+/* Kernel prints addresses as 32-bit words in host order: 8 hex chars (IPv4) or 32 (IPv6) */
+static void format_proc_net_addr(const char *hex, int family, char *out, size_t outlen) {
+    unsigned char addr[16] = {0};
+    int words = family == AF_INET6 ? 4 : 1;
+    for (int w = 0; w < words; w++) {
+        char part[9];
+        memcpy(part, hex + w * 8, 8);
+        part[8] = '\0';
+        unsigned int v = (unsigned int)strtoul(part, NULL, 16);
+        memcpy(addr + w * 4, &v, 4);
+    }
+    if (!inet_ntop(family, addr, out, outlen)) snprintf(out, outlen, "?");
+}
+
+/* Parse /proc/net/udp or /proc/net/udp6, keeping tx_queue/rx_queue/drops */
+static void read_udp_queues(const char *path, int family, UdpQueue **socks, size_t *count, size_t *capacity) {
+    FILE *udp = fopen(path, "re");
+    if (!udp) {
+        if (family == AF_INET) perror(path);   /* udp6 may not exist (ipv6 disabled) */
+        return;
+    }
+    char line[1024];
+    /* Skip header */
+    fgets(line, sizeof(line), udp);
+    while (fgets(line, sizeof(line), udp)) {
+        char local_hex[33], remote_hex[33];
+        unsigned int local_port_hex, remote_port_hex;
+        unsigned long tx_queue, rx_queue, inode, drops;
+        /* sl local:port rem:port st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode ref pointer drops */
+        if (sscanf(line, "%*d: %32[0-9A-Fa-f]:%X %32[0-9A-Fa-f]:%X %*X %lX:%lX %*s %*s %*s %*s %lu %*s %*s %lu",
+                local_hex, &local_port_hex, remote_hex, &remote_port_hex,
+                &tx_queue, &rx_queue, &inode, &drops) != 8) {
+            continue;
+        }
+        if (*count >= *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 128;
+            UdpQueue *new_socks = realloc(*socks, *capacity * sizeof(UdpQueue));
+            if (!new_socks) break;
+            *socks = new_socks;
+        }
+        UdpQueue *q = &(*socks)[(*count)++];
+        memset(q, 0, sizeof(*q));
+        format_proc_net_addr(local_hex, family, q->local_ip, sizeof(q->local_ip));
+        format_proc_net_addr(remote_hex, family, q->remote_ip, sizeof(q->remote_ip));
+        q->local_port = (unsigned short)local_port_hex;
+        q->remote_port = (unsigned short)remote_port_hex;
+        q->tx_queue = tx_queue;
+        q->rx_queue = rx_queue;
+        q->ino = inode;
+        q->drops = drops;
+    }
+    fclose(udp);
+}
+
+static void read_all_udp_queues(UdpQueue **socks, size_t *count, size_t *capacity) {
+    read_udp_queues("/proc/net/udp", AF_INET, socks, count, capacity);
+    read_udp_queues("/proc/net/udp6", AF_INET6, socks, count, capacity);
+}
+
+/* Socket passes when it exceeds any configured threshold (none configured: any queue or drops) */
+static bool udpq_over_threshold(const UdpQueue *q, const UdpDropOptions *opts) {
+    bool any = opts->min_rx_queue || opts->min_tx_queue || opts->min_drops || opts->min_drop_rate > 0;
+    if (!any) return q->rx_queue || q->tx_queue || q->drops || (q->has_rate && q->drop_rate > 0);
+    if (opts->min_rx_queue && q->rx_queue >= opts->min_rx_queue) return true;
+    if (opts->min_tx_queue && q->tx_queue >= opts->min_tx_queue) return true;
+    if (opts->min_drops && q->drops >= opts->min_drops) return true;
+    if (opts->min_drop_rate > 0 && q->has_rate && q->drop_rate >= opts->min_drop_rate) return true;
+    return false;
+}
+
+static unsigned long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/*
+Scanner: UDP queue pressure and drops (IPv4 + IPv6)
+Decodes tx_queue/rx_queue and the per-socket drops counter from /proc/net/udp and
+/proc/net/udp6. With opts->interval_ms a second sample is taken and drop_rate
+(drops/s over the measured time between the reads, matched by inode) is computed.
+Only sockets above the configured thresholds are joined to their owning PID and
+emitted.
+Output: JSON array of {pid, comm, local_ip, local_port, remote_ip, remote_port, inode,
+tx_queue, rx_queue, drops[, drop_rate]} sorted by PID then local_port.
+*/
+void scan_udp_drops(const UdpDropOptions *opts)
+{
+    UdpQueue *socks = NULL;
+    size_t sock_count = 0, sock_capacity = 0;
+    unsigned long long read_start = now_us();
+    read_all_udp_queues(&socks, &sock_count, &sock_capacity);
+    if (opts->interval_ms > 0) {
+        /* drop_rate over the measured time between the midpoints of the two reads */
+        unsigned long long prev_us = (read_start + now_us()) / 2;
+        UdpQueue *prev = socks;
+        size_t prev_count = sock_count;
+        socks = NULL;
+        sock_count = sock_capacity = 0;
+        struct timespec ts = { .tv_sec = opts->interval_ms / 1000,
+                               .tv_nsec = (long)(opts->interval_ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        read_start = now_us();
+        read_all_udp_queues(&socks, &sock_count, &sock_capacity);
+        double secs = (double)((read_start + now_us()) / 2 - prev_us) / 1e6;
+        if (secs <= 0) secs = opts->interval_ms / 1000.0;
+        qsort(prev, prev_count, sizeof(UdpQueue), udpq_ino_cmp);
+        for (size_t i = 0; i < sock_count; i++) {
+            const UdpQueue *p = bsearch(&socks[i], prev, prev_count, sizeof(UdpQueue), udpq_ino_cmp);
+            if (!p || socks[i].drops < p->drops) continue;  /* new socket – no baseline */
+            socks[i].drop_rate = (socks[i].drops - p->drops) / secs;
+            socks[i].has_rate = true;
+        }
+        free(prev);
+    }
+    /* Apply thresholds before the (more expensive) owner join */
+    size_t kept = 0;
+    for (size_t i = 0; i < sock_count; i++) {
+        if (udpq_over_threshold(&socks[i], opts)) socks[kept++] = socks[i];
+    }
+    sock_count = kept;
+    if (sock_count == 0) {
+        free(socks);
+        printf("[]\n");
+        return;
+    }
+    SockOwnerCache cache;
+    sockowner_cache_init(&cache);
+    if (opts->owner_cache) sockowner_cache_load(&cache, opts->owner_cache);
+    unsigned long *wanted = malloc(sock_count * sizeof(unsigned long));
+    if (wanted) {
+        for (size_t i = 0; i < sock_count; i++) wanted[i] = socks[i].ino;
+        sockowner_refresh(&cache, wanted, sock_count);
+        free(wanted);
+    }
+    for (size_t k = 0; k < sock_count; k++) {
+        SockOwner owner;
+        snprintf(socks[k].comm, sizeof(socks[k].comm), "%s", "[unknown]");
+        if (!sockowner_first(&cache, socks[k].ino, &owner)) continue;
+        socks[k].pid = owner.pid;
+        snprintf(socks[k].comm, sizeof(socks[k].comm), "%s", owner.comm);
+    }
+    if (opts->owner_cache) sockowner_cache_save(&cache, opts->owner_cache);
+    sockowner_cache_free(&cache);
+    qsort(socks, sock_count, sizeof(UdpQueue), udpq_pid_cmp);
+    /* === OUTPUT – replace this block with your database insert === */
+    printf("[\n");
+    for (size_t i = 0; i < sock_count; i++) {
+        /* Unowned sockets are kept here (pid 0): drops on them are still worth seeing */
+        printf(" {\"pid\":%d,\"comm\":\"%s\",\"local_ip\":\"%s\",\"local_port\":%hu,\"remote_ip\":\"%s\",\"remote_port\":%hu,\"inode\":\"%lu\","
+               "\"tx_queue\":%lu,\"rx_queue\":%lu,\"drops\":%lu",
+            socks[i].pid, socks[i].comm, socks[i].local_ip, socks[i].local_port,
+            socks[i].remote_ip, socks[i].remote_port, socks[i].ino,
+            socks[i].tx_queue, socks[i].rx_queue, socks[i].drops);
+        if (socks[i].has_rate) printf(",\"drop_rate\":%.2f", socks[i].drop_rate);
+        printf("}");
+        if (i < sock_count - 1) printf(",");
+        printf("\n");
+    }
+    printf("]\n");
+    free(socks);
+}
+
+int main(int argc, char **argv)
 {
-    scan_udp_sockets();
+    const char *owner_cache = NULL;
+    bool drops_mode = false;
+    bool bad_args = false;
+    UdpDropOptions drop_opts = { .interval_ms = 0, .min_rx_queue = 0, .min_tx_queue = 0,
+                                 .min_drops = 0, .min_drop_rate = 0.0, .owner_cache = NULL };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--owner-cache") == 0 && i + 1 < argc) {
+            owner_cache = argv[++i];
+        } else if (strcmp(argv[i], "--drops") == 0) {
+            drops_mode = true;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            drop_opts.interval_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+            drops_mode = true;
+        } else if (strcmp(argv[i], "--min-rx-queue") == 0 && i + 1 < argc) {
+            drop_opts.min_rx_queue = strtoul(argv[++i], NULL, 10);
+            drops_mode = true;
+        } else if (strcmp(argv[i], "--min-tx-queue") == 0 && i + 1 < argc) {
+            drop_opts.min_tx_queue = strtoul(argv[++i], NULL, 10);
+            drops_mode = true;
+        } else if (strcmp(argv[i], "--min-drops") == 0 && i + 1 < argc) {
+            drop_opts.min_drops = strtoul(argv[++i], NULL, 10);
+            drops_mode = true;
+        } else if (strcmp(argv[i], "--min-drop-rate") == 0 && i + 1 < argc) {
+            drop_opts.min_drop_rate = strtod(argv[++i], NULL);
+            drops_mode = true;
+        } else {
+            bad_args = true;
+        }
+    }
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                       # UDP sockets → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --owner-cache <file>  # Reuse socket owners from previous run (incremental fd walk)\n", argv[0]);
+        fprintf(stderr, "  %s --drops [--interval <ms>] [--min-rx-queue <bytes>] [--min-tx-queue <bytes>]\n", argv[0]);
+        fprintf(stderr, "      [--min-drops <n>] [--min-drop-rate <per_sec>]  # Queue pressure / drops (v4 + v6)\n");
+        return 1;
+    }
+    if (drops_mode) {
+        drop_opts.owner_cache = owner_cache;
+        scan_udp_drops(&drop_opts);
+        return 0;
+    }
+    scan_udp_sockets(owner_cache);
     return 0;
 }
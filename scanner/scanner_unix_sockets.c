@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+#include "scanner_sockowner.h"
+
+/* Unix socket states as reported by UNIX_DIAG (kernel reuses TCP state numbers) */
+#define UNIX_STATE_CONNECTED   1    /* TCP_ESTABLISHED */
+#define UNIX_STATE_CONNECTING  2    /* TCP_SYN_SENT */
+#define UNIX_STATE_UNCONNECTED 7    /* TCP_CLOSE */
+#define UNIX_STATE_LISTEN      10   /* TCP_LISTEN */
+
+#define UNIX_NAME_MAX 108           /* sizeof(sun_path) */
+
+/* Tagged struct so 'struct UnixSocket' is defined before use in pid_cmp */
+typedef struct UnixSocket {
+    int   pid;
+    char  comm[17];                 /* short process name */
+    unsigned long ino;              /* socket inode */
+    unsigned char type;             /* SOCK_STREAM / SOCK_DGRAM / SOCK_SEQPACKET */
+    unsigned char state;
+    char  path[UNIX_NAME_MAX * 4 + 2]; /* bound name; abstract names start with '@' */
+    unsigned long peer_ino;         /* 0 if not connected */
+    int   peer_pid;
+    char  peer_comm[17];
+    unsigned int rqueue;            /* bytes queued (listen: pending connections) */
+    unsigned int wqueue;            /* bytes queued to send (listen: backlog limit) */
+} UnixSocket;
+
+/* Comparator for qsort by PID, then inode */
+static int pid_cmp(const void *a, const void *b) {
+    const struct UnixSocket *pa = a;
+    const struct UnixSocket *pb = b;
+    if (pa->pid != pb->pid) return pa->pid - pb->pid;
+    return (pa->ino > pb->ino) - (pa->ino < pb->ino);
+}
+
+/*
+Helper: Escape string for JSON (minimal: ", \, \n, \r, \t)
+Returns malloc'd escaped string.
+*/
+static char *json_escape(const char *str) {
+    size_t len = strlen(str);
+    char *esc = malloc(len * 2 + 1); /* Worst case */
+    if (!esc) return NULL;
+
+    char *p = esc;
+    for (; *str; str++) {
+        switch (*str) {
+            case '"': *p++ = '\\'; *p++ = '"'; break;
+            case '\\': *p++ = '\\'; *p++ = '\\'; break;
+            case '\n': *p++ = '\\'; *p++ = 'n'; break;
+            case '\r': *p++ = '\\'; *p++ = 'r'; break;
+            case '\t': *p++ = '\\'; *p++ = 't'; break;
+            default: *p++ = *str; break;
+        }
+    }
+    *p = '\0';
+    return esc;
+}
+
+static const char *type_name(unsigned char type) {
+    switch (type) {
+        case SOCK_STREAM:    return "stream";
+        case SOCK_DGRAM:     return "dgram";
+        case SOCK_SEQPACKET: return "seqpacket";
+        default:             return "other";
+    }
+}
+
+static const char *state_name(unsigned char state) {
+    switch (state) {
+        case UNIX_STATE_CONNECTED:   return "connected";
+        case UNIX_STATE_CONNECTING:  return "connecting";
+        case UNIX_STATE_UNCONNECTED: return "unconnected";
+        case UNIX_STATE_LISTEN:      return "listen";
+        default:                     return "other";
+    }
+}
+
+/* UNIX_DIAG_NAME payload → printable: abstract names (leading NUL) get '@', pathnames end at their NUL, other control bytes '?' */
+static void copy_unix_name(char *out, size_t outlen, const char *name, size_t len) {
+    size_t o = 0, i = 0;
+    if (len > 0 && name[0] == '\0') {
+        out[o++] = '@';
+        i = 1;
+    } else {
+        /* Pathname payload carries the trailing NUL: stop there */
+        len = strnlen(name, len);
+    }
+    for (; i < len && o + 1 < outlen; i++) {
+        unsigned char ch = (unsigned char)name[i];
+        if (ch < 0x20 || ch == 0x7f) out[o++] = '?';
+        else out[o++] = (char)ch;
+    }
+    out[o] = '\0';
+}
+
+/* Copy one unix_diag_msg (+ NAME/PEER/RQLEN attributes) into a UnixSocket */
+static void fill_from_diag(UnixSocket *s, const struct unix_diag_msg *d, int attr_len) {
+    memset(s, 0, sizeof(*s));
+    s->ino = d->udiag_ino;
+    s->type = d->udiag_type;
+    s->state = d->udiag_state;
+
+    struct rtattr *attr = (struct rtattr *)(d + 1);
+    for (; RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len)) {
+        if (attr->rta_type == UNIX_DIAG_NAME) {
+            copy_unix_name(s->path, sizeof(s->path), RTA_DATA(attr), RTA_PAYLOAD(attr));
+        } else if (attr->rta_type == UNIX_DIAG_PEER && RTA_PAYLOAD(attr) >= sizeof(__u32)) {
+            s->peer_ino = *(const __u32 *)RTA_DATA(attr);
+        } else if (attr->rta_type == UNIX_DIAG_RQLEN && RTA_PAYLOAD(attr) >= sizeof(struct unix_diag_rqlen)) {
+            const struct unix_diag_rqlen *rq = RTA_DATA(attr);
+            s->rqueue = rq->udiag_rqueue;
+            s->wqueue = rq->udiag_wqueue;
+        }
+    }
+}
+
+/*
+   One NETLINK_SOCK_DIAG dump of all AF_UNIX sockets (every state) with
+   UDIAG_SHOW_NAME | UDIAG_SHOW_PEER | UDIAG_SHOW_RQLEN.
+   Returns 0 on success, -1 on netlink failure.
+*/
+static int unix_diag_dump(UnixSocket **socks, size_t *count, size_t *capacity) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd < 0) {
+        perror("socket NETLINK_SOCK_DIAG");
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct unix_diag_req req;
+    } msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    msg.req.sdiag_family = AF_UNIX;
+    msg.req.udiag_states = ~0U;
+    msg.req.udiag_show = UDIAG_SHOW_NAME | UDIAG_SHOW_PEER | UDIAG_SHOW_RQLEN;
+
+    struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+    if (sendto(fd, &msg, sizeof(msg), 0, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+        perror("sendto NETLINK_SOCK_DIAG");
+        close(fd);
+        return -1;
+    }
+
+    /* Large receive buffer: one recv() returns many sockets */
+    static char buf[65536] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int rc = 0;
+    bool done = false;
+
+    while (!done) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            perror("recv NETLINK_SOCK_DIAG");
+            rc = -1;
+            break;
+        }
+        if (len == 0) break;
+
+        struct nlmsghdr *h = (struct nlmsghdr *)buf;
+        for (; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_type == NLMSG_DONE) {
+                done = true;
+                break;
+            }
+            if (h->nlmsg_type == NLMSG_ERROR) {
+                fprintf(stderr, "unix_diag dump failed\n");
+                rc = -1;
+                done = true;
+                break;
+            }
+            if (h->nlmsg_type != SOCK_DIAG_BY_FAMILY) continue;
+
+            const struct unix_diag_msg *d = NLMSG_DATA(h);
+            int attr_len = (int)h->nlmsg_len - (int)NLMSG_LENGTH(sizeof(*d));
+            if (attr_len < 0) continue;
+
+            /* Grow socket array */
+            if (*count >= *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 256;
+                UnixSocket *new_socks = realloc(*socks, *capacity * sizeof(UnixSocket));
+                if (!new_socks) {
+                    rc = -1;
+                    done = true;
+                    break;
+                }
+                *socks = new_socks;
+            }
+            fill_from_diag(&(*socks)[(*count)++], d, attr_len);
+        }
+    }
+
+    close(fd);
+    return rc;
+}
+
+/*
+Scanner: Unix domain sockets (with process PID/comm for both endpoints)
+Dumps every AF_UNIX socket through sock_diag UNIX_DIAG (name, peer inode, queue lengths),
+then resolves the owner of each socket and of its peer with a single /proc/<pid>/fd walk
+(scanner_sockowner.h; with owner_cache only changed fd tables are re-read).
+Output: JSON array of {pid, comm, inode, type, state, path, peer_inode, peer_pid, peer_comm,
+rqueue, wqueue} sorted by PID then inode. For listening sockets rqueue/wqueue are the
+pending-connection count and the backlog limit. peer_pid is 0 if the peer is not visible.
+Note: Run as root to see all (some /proc/pid/fd restricted). Sockets with no visible owner are skipped.
+*/
+void scan_unix_sockets(const char *owner_cache)
+{
+    /* Step 1: Dump all unix sockets */
+    UnixSocket *socks = NULL;
+    size_t sock_capacity = 0;
+    size_t sock_count = 0;
+
+    if (unix_diag_dump(&socks, &sock_count, &sock_capacity) < 0 || sock_count == 0) {
+        free(socks);
+        printf("[]\n");
+        return;
+    }
+
+    /* Step 2: Find who owns each inode (peers are sockets in the same dump) */
+    SockOwnerCache cache;
+    sockowner_cache_init(&cache);
+    if (owner_cache) sockowner_cache_load(&cache, owner_cache);
+
+    unsigned long *wanted = malloc(sock_count * sizeof(unsigned long));
+    if (wanted) {
+        for (size_t i = 0; i < sock_count; i++) wanted[i] = socks[i].ino;
+        sockowner_refresh(&cache, wanted, sock_count);
+        free(wanted);
+    }
+
+    for (size_t k = 0; k < sock_count; k++) {
+        SockOwner owner;
+        if (sockowner_first(&cache, socks[k].ino, &owner)) {
+            socks[k].pid = owner.pid;
+            snprintf(socks[k].comm, sizeof(socks[k].comm), "%s", owner.comm);
+        }
+        if (socks[k].peer_ino && sockowner_first(&cache, socks[k].peer_ino, &owner)) {
+            socks[k].peer_pid = owner.pid;
+            snprintf(socks[k].peer_comm, sizeof(socks[k].peer_comm), "%s", owner.comm);
+        }
+    }
+
+    if (owner_cache) sockowner_cache_save(&cache, owner_cache);
+    sockowner_cache_free(&cache);
+
+    /* Drop unowned sockets (e.g. permission issues, in-flight SCM_RIGHTS) */
+    size_t kept = 0;
+    for (size_t i = 0; i < sock_count; i++) {
+        if (socks[i].pid != 0) socks[kept++] = socks[i];
+    }
+    sock_count = kept;
+
+    /* Sort by PID then inode */
+    qsort(socks, sock_count, sizeof(UnixSocket), pid_cmp);
+
+    /* === OUTPUT – replace this block with your database insert === */
+    printf("[\n");
+    for (size_t i = 0; i < sock_count; i++) {
+        const UnixSocket *s = &socks[i];
+        char *path = json_escape(s->path);
+
+        printf("  {\"pid\":%d,\"comm\":\"%s\",\"inode\":\"%lu\",\"type\":\"%s\",\"state\":\"%s\",\"path\":\"%s\","
+               "\"peer_inode\":\"%lu\",\"peer_pid\":%d,\"peer_comm\":\"%s\",\"rqueue\":%u,\"wqueue\":%u}",
+               s->pid, s->comm, s->ino, type_name(s->type), state_name(s->state), path ? path : "",
+               s->peer_ino, s->peer_pid, s->peer_comm, s->rqueue, s->wqueue);
+        free(path);
+
+        if (i < sock_count - 1) printf(",");
+        printf("\n");
+    }
+    printf("]\n");
+
+    free(socks);
+}
+
+int main(int argc, char **argv)
+{
+    const char *owner_cache = NULL;
+
+    if (argc == 3 && strcmp(argv[1], "--owner-cache") == 0) {
+        owner_cache = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                       # Unix domain sockets (both endpoints, queue lengths) → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --owner-cache <file>  # Reuse socket owners from previous run (incremental fd walk)\n", argv[0]);
+        return 1;
+    }
+
+    scan_unix_sockets(owner_cache);
+    return 0;
+}
@@ -4,116 +4,551 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>     /* for unlink */
+#include <limits.h>     /* for PATH_MAX */
+#include <sys/stat.h>
+#include "scanner_proc_handle.h"
+#include "scanner_proc_attrs.h"
+#include "scanner_budget.h"
 
 /* Comparator for qsort by PID */
 static int pid_cmp(const void *a, const void *b) {
     return (*(const int *)a) - (*(const int *)b);
 }
 
+/* One distinct mapped library host-wide: (dev, inode, path) interned once */
 typedef struct {
-    int    pid;
-    char   comm[17];
-    char **libs;           /* dynamic array of library paths */
-    size_t lib_count;
-    size_t lib_capacity;
+    size_t   path_off;     /* offset into LibTable.arena (NUL-terminated) */
+    unsigned long hash;
+    unsigned int dev_major;
+    unsigned int dev_minor;
+    unsigned long ino;
+    size_t   refcount;     /* number of processes mapping it */
+    int      last_pid;     /* per-process dedup marker */
+} LibEntry;
+
+/* Interned string table: path bytes in one arena, open-addressing set of ids */
+typedef struct {
+    char     *arena;
+    size_t    arena_len;
+    size_t    arena_cap;
+    LibEntry *libs;        /* id → entry */
+    size_t    lib_count;
+    size_t    lib_capacity;
+    unsigned *slots;       /* hash slot → id + 1 (0 = empty) */
+    size_t    slot_mask;
+} LibTable;
+
+typedef struct {
+    int       pid;
+    char      comm[17];
+    unsigned long long starttime;  /* identity: /proc/<pid>/stat field 22 (ProcHandle) */
+    unsigned long exe_dev;         /* identity: stat() of /proc/<pid>/exe (changes on exec) */
+    unsigned long exe_ino;
+    unsigned long vmlib;           /* VmLib (kB) from status: grows on dlopen() */
+    unsigned *lib_ids;     /* ids into LibTable, in first-seen order */
+    size_t    lib_count;
+    size_t    lib_capacity;
+    ProcAttr  attr;                /* --ns / --group-by */
 } ProcLibs;
 
-static void add_library(ProcLibs *p, const char *path) {
+/* Library sets from the previous run (--cache), sorted by PID */
+typedef struct {
+    ProcLibs *procs;
+    size_t    count;
+    size_t    capacity;
+} LibCache;
+
+static unsigned long lib_hash(const char *path, size_t len, unsigned int dev_major,
+                              unsigned int dev_minor, unsigned long ino) {
+    unsigned long h = 1469598103934665603UL;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)path[i]) * 1099511628211UL;
+    h ^= ino + ((unsigned long)dev_major << 20) + dev_minor;
+    return h * 1099511628211UL;
+}
+
+static const char *lib_path(const LibTable *t, unsigned id) {
+    return t->arena + t->libs[id].path_off;
+}
+
+static bool lib_table_init(LibTable *t) {
+    memset(t, 0, sizeof(*t));
+    t->slot_mask = 1023;
+    t->slots = calloc(t->slot_mask + 1, sizeof(unsigned));
+    return t->slots != NULL;
+}
+
+static void lib_table_free(LibTable *t) {
+    free(t->arena);
+    free(t->libs);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static bool lib_table_rehash(LibTable *t) {
+    size_t new_size = (t->slot_mask + 1) * 2;
+    unsigned *new_slots = calloc(new_size, sizeof(unsigned));
+    if (!new_slots) return false;
+    free(t->slots);
+    t->slots = new_slots;
+    t->slot_mask = new_size - 1;
+    for (size_t id = 0; id < t->lib_count; id++) {
+        size_t i = t->libs[id].hash & t->slot_mask;
+        while (t->slots[i]) i = (i + 1) & t->slot_mask;
+        t->slots[i] = (unsigned)id + 1;
+    }
+    return true;
+}
+
+/* Id of (path, dev, inode), adding it on first sight; -1 on allocation failure */
+static long lib_intern(LibTable *t, const char *path, size_t len,
+                       unsigned int dev_major, unsigned int dev_minor, unsigned long ino) {
+    unsigned long h = lib_hash(path, len, dev_major, dev_minor, ino);
+    size_t i = h & t->slot_mask;
+    for (; t->slots[i]; i = (i + 1) & t->slot_mask) {
+        const LibEntry *e = &t->libs[t->slots[i] - 1];
+        if (e->hash == h && e->ino == ino && e->dev_major == dev_major && e->dev_minor == dev_minor &&
+            strncmp(t->arena + e->path_off, path, len) == 0 && t->arena[e->path_off + len] == '\0') {
+            return (long)t->slots[i] - 1;
+        }
+    }
+
+    /* New library: copy path into the arena */
+    if (t->arena_len + len + 1 > t->arena_cap) {
+        size_t new_cap = t->arena_cap ? t->arena_cap * 2 : 65536;
+        while (new_cap < t->arena_len + len + 1) new_cap *= 2;
+        char *new_arena = realloc(t->arena, new_cap);
+        if (!new_arena) return -1;
+        t->arena = new_arena;
+        t->arena_cap = new_cap;
+    }
+    if (t->lib_count >= t->lib_capacity) {
+        size_t new_cap = t->lib_capacity ? t->lib_capacity * 2 : 512;
+        LibEntry *new_libs = realloc(t->libs, new_cap * sizeof(LibEntry));
+        if (!new_libs) return -1;
+        t->libs = new_libs;
+        t->lib_capacity = new_cap;
+    }
+
+    unsigned id = (unsigned)t->lib_count++;
+    LibEntry *e = &t->libs[id];
+    e->path_off = t->arena_len;
+    e->hash = h;
+    e->dev_major = dev_major;
+    e->dev_minor = dev_minor;
+    e->ino = ino;
+    e->refcount = 0;
+    e->last_pid = 0;
+    memcpy(t->arena + t->arena_len, path, len);
+    t->arena[t->arena_len + len] = '\0';
+    t->arena_len += len + 1;
+
+    t->slots[i] = id + 1;
+    if (t->lib_count * 2 > t->slot_mask + 1) lib_table_rehash(t);
+    return id;
+}
+
+static void add_library(ProcLibs *p, LibTable *t, unsigned id) {
+    /* Deduplicate — marker instead of scanning the process's list */
+    if (t->libs[id].last_pid == p->pid) return;
+
     if (p->lib_count >= p->lib_capacity) {
         p->lib_capacity = p->lib_capacity ? p->lib_capacity * 2 : 32;
-        char **new_libs = realloc(p->libs, p->lib_capacity * sizeof(char *));
-        if (!new_libs) return;
-        p->libs = new_libs;
+        unsigned *new_ids = realloc(p->lib_ids, p->lib_capacity * sizeof(unsigned));
+        if (!new_ids) return;
+        p->lib_ids = new_ids;
     }
 
-    /* Deduplicate — skip if already present */
-    for (size_t i = 0; i < p->lib_count; i++) {
-        if (strcmp(p->libs[i], path) == 0) return;
+    t->libs[id].last_pid = p->pid;
+    t->libs[id].refcount++;
+    p->lib_ids[p->lib_count++] = id;
+}
+
+static void free_proclib(ProcLibs *p) {
+    free(p->lib_ids);
+    p->lib_ids = NULL;
+    p->lib_count = p->lib_capacity = 0;
+}
+
+/* Parse the maps file of h into p's library ids; false if maps is unreadable. --max-core-pct applies per line */
+static bool read_maps_libs(ProcLibs *p, const ProcHandle *h, LibTable *t, ScanBudget *budget) {
+    FILE *fm = proc_handle_fopen(h, "maps");
+    if (!fm) return false;
+
+    char line[4096 + 128];
+    while (fgets(line, sizeof(line), fm)) {
+        budget_throttle(budget);
+        /* Typical line: address           perms offset  dev   inode       pathname
+           Example: 7f8b5c000000-7f8b5c021000 r-xp 00000000 08:01 1234567 /usr/lib/x86_64-linux-gnu/libc.so.6
+        */
+        unsigned int dev_major, dev_minor;
+        unsigned long ino;
+        int path_pos = 0;
+        if (sscanf(line, "%*s %*s %*s %x:%x %lu %n", &dev_major, &dev_minor, &ino, &path_pos) != 3) continue;
+
+        char *pathname = line + path_pos;
+        if (*pathname != '/') continue;   /* anonymous, [heap], [vdso], ... */
+
+        /* Look for .so in the file name */
+        char *base = strrchr(pathname, '/');
+        if (strstr(base, ".so") == NULL) continue;
+
+        /* Trim trailing whitespace/newline */
+        size_t len = strlen(pathname);
+        while (len > 0 && isspace((unsigned char)pathname[len - 1])) len--;
+
+        long id = lib_intern(t, pathname, len, dev_major, dev_minor, ino);
+        if (id >= 0) add_library(p, t, (unsigned)id);
+    }
+    fclose(fm);
+    return true;
+}
+
+/*
+   Cheap identity of a process, read through its handle without touching its
+   mmap_lock: starttime (PID reuse, taken when the handle was opened), exe
+   dev/inode (exec) and VmLib (dlopen/dlclose). False if the process is gone.
+*/
+static bool read_proc_identity(ProcLibs *p, const ProcHandle *h) {
+    char buf[1024];
+
+    p->starttime = h->starttime;
+
+    FILE *fp = proc_handle_fopen(h, "status");
+    if (!fp) return false;
+    p->vmlib = 0;
+    while (fgets(buf, sizeof(buf), fp)) {
+        if (strncmp(buf, "VmLib:", 6) == 0) {
+            sscanf(buf + 6, "%lu", &p->vmlib);
+            break;
+        }
     }
+    fclose(fp);
 
-    p->libs[p->lib_count] = strdup(path);
-    if (p->libs[p->lib_count]) p->lib_count++;
+    struct stat st;
+    p->exe_dev = p->exe_ino = 0;
+    if (fstatat(h->dirfd, "exe", &st, 0) == 0) {
+        p->exe_dev = (unsigned long)st.st_dev;
+        p->exe_ino = (unsigned long)st.st_ino;
+    }
+    return true;
 }
 
-static void free_proclib(ProcLibs *p) {
-    for (size_t i = 0; i < p->lib_count; i++) {
-        free(p->libs[i]);
+static int cached_pid_cmp(const void *key, const void *elem) {
+    return *(const int *)key - ((const ProcLibs *)elem)->pid;
+}
+
+/* Cached entry for p if its identity is unchanged since the last run */
+static const ProcLibs *lib_cache_lookup(const LibCache *c, const ProcLibs *p) {
+    if (c->count == 0) return NULL;
+    const ProcLibs *hit = bsearch(&p->pid, c->procs, c->count, sizeof(ProcLibs), cached_pid_cmp);
+    if (!hit) return NULL;
+    if (hit->starttime != p->starttime || hit->exe_dev != p->exe_dev ||
+        hit->exe_ino != p->exe_ino || hit->vmlib != p->vmlib) {
+        return NULL;
     }
-    free(p->libs);
-    p->libs = NULL;
-    p->lib_count = p->lib_capacity = 0;
+    return hit;
+}
+
+/*
+   Load a cache written by lib_cache_save(). Library records are interned into t
+   (their file ids remapped), so cached processes reuse the same ids as fresh ones.
+   Format (text, one record per line):
+       L <id> <dev_major> <dev_minor> <inode> <path>
+       P <pid> <starttime> <exe_dev> <exe_ino> <vmlib_kb> <id> <id> ...
+   A missing or unreadable file just means a cold run.
+*/
+static void lib_cache_load(LibCache *c, LibTable *t, const char *filename, ScanBudget *budget) {
+    FILE *f = fopen(filename, "re");
+    if (!f) return;
+
+    unsigned *remap = NULL;
+    size_t remap_cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &line_cap, f)) > 0) {
+        budget_throttle(budget);
+        if (line[len - 1] == '\n') line[--len] = '\0';
+
+        if (line[0] == 'L') {
+            unsigned file_id, dev_major, dev_minor;
+            unsigned long ino;
+            int path_pos = 0;
+            if (sscanf(line, "L %u %x %x %lu %n", &file_id, &dev_major, &dev_minor, &ino, &path_pos) != 4) continue;
+            if (file_id >= remap_cap) {
+                size_t new_cap = remap_cap ? remap_cap * 2 : 1024;
+                while (new_cap <= file_id) new_cap *= 2;
+                unsigned *new_remap = realloc(remap, new_cap * sizeof(unsigned));
+                if (!new_remap) break;
+                memset(new_remap + remap_cap, 0xff, (new_cap - remap_cap) * sizeof(unsigned));
+                remap = new_remap;
+                remap_cap = new_cap;
+            }
+            long id = lib_intern(t, line + path_pos, strlen(line + path_pos), dev_major, dev_minor, ino);
+            if (id >= 0) remap[file_id] = (unsigned)id;
+        } else if (line[0] == 'P') {
+            ProcLibs p = { .pid = 0, .lib_ids = NULL, .lib_count = 0, .lib_capacity = 0 };
+            int pos = 0;
+            if (sscanf(line, "P %d %llu %lu %lu %lu%n", &p.pid, &p.starttime, &p.exe_dev,
+                       &p.exe_ino, &p.vmlib, &pos) != 5) {
+                continue;
+            }
+
+            char *cur = line + pos;
+            for (;;) {
+                char *end;
+                unsigned long file_id = strtoul(cur, &end, 10);
+                if (end == cur) break;
+                cur = end;
+                if (file_id >= remap_cap || remap[file_id] == (unsigned)-1) continue;  /* corrupt: skip id */
+                if (p.lib_count >= p.lib_capacity) {
+                    p.lib_capacity = p.lib_capacity ? p.lib_capacity * 2 : 32;
+                    unsigned *new_ids = realloc(p.lib_ids, p.lib_capacity * sizeof(unsigned));
+                    if (!new_ids) break;
+                    p.lib_ids = new_ids;
+                }
+                p.lib_ids[p.lib_count++] = remap[file_id];
+            }
+
+            if (c->count >= c->capacity) {
+                c->capacity = c->capacity ? c->capacity * 2 : 1024;
+                ProcLibs *new_procs = realloc(c->procs, c->capacity * sizeof(ProcLibs));
+                if (!new_procs) {
+                    free(p.lib_ids);
+                    break;
+                }
+                c->procs = new_procs;
+            }
+            c->procs[c->count++] = p;
+        }
+    }
+
+    free(line);
+    free(remap);
+    fclose(f);
+    qsort(c->procs, c->count, sizeof(ProcLibs), pid_cmp);
+}
+
+/*
+   A budgeted cycle visits only PIDs in (after, until) (until 0 = to the end). Cached
+   sets outside that range are kept for the cycles that will visit them; inside it,
+   a PID the walk did not see is gone. A full pass (0, 0) drops everything.
+*/
+static void lib_cache_keep_unvisited(LibCache *c, int after, int until) {
+    size_t n = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        int pid = c->procs[i].pid;
+        if (pid > after && (until == 0 || pid < until)) {
+            free(c->procs[i].lib_ids);
+        } else {
+            c->procs[n++] = c->procs[i];
+        }
+    }
+    c->count = n;
+}
+
+static void lib_cache_free(LibCache *c) {
+    for (size_t i = 0; i < c->count; i++) free(c->procs[i].lib_ids);
+    free(c->procs);
+    memset(c, 0, sizeof(*c));
+}
+
+/* Library set of one process as a "P" record */
+static void lib_cache_write_proc(FILE *f, const ProcLibs *p) {
+    fprintf(f, "P %d %llu %lu %lu %lu", p->pid, p->starttime, p->exe_dev, p->exe_ino, p->vmlib);
+    for (size_t j = 0; j < p->lib_count; j++) fprintf(f, " %u", p->lib_ids[j]);
+    fprintf(f, "\n");
+}
+
+/*
+   Write this run's library sets plus kept (carried-over) cached ones, with only the
+   libraries they reference; temp file + rename
+*/
+static int lib_cache_save(const LibTable *t, const ProcLibs *processes, size_t count,
+                          const ProcLibs *kept, size_t kept_count, const char *filename) {
+    char tmp[PATH_MAX];
+    int needed = snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    if (needed < 0 || needed >= (int)sizeof(tmp)) return -1;
+
+    bool *referenced = calloc(t->lib_count ? t->lib_count : 1, sizeof(bool));
+    if (!referenced) return -1;
+    for (size_t id = 0; id < t->lib_count; id++) referenced[id] = t->libs[id].refcount > 0;
+    for (size_t i = 0; i < kept_count; i++) {
+        for (size_t j = 0; j < kept[i].lib_count; j++) referenced[kept[i].lib_ids[j]] = true;
+    }
+
+    FILE *f = fopen(tmp, "we");
+    if (!f) {
+        fprintf(stderr, "Cannot write libs cache '%s'\n", tmp);
+        free(referenced);
+        return -1;
+    }
+
+    for (size_t id = 0; id < t->lib_count; id++) {
+        const LibEntry *e = &t->libs[id];
+        if (!referenced[id]) continue;
+        fprintf(f, "L %zu %x %x %lu %s\n", id, e->dev_major, e->dev_minor, e->ino, lib_path(t, (unsigned)id));
+    }
+    free(referenced);
+    for (size_t i = 0; i < count; i++) lib_cache_write_proc(f, &processes[i]);
+    for (size_t i = 0; i < kept_count; i++) lib_cache_write_proc(f, &kept[i]);
+
+    if (fclose(f) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return rename(tmp, filename);
+}
+
+/* JSON string with " and \ escaped */
+static void print_json_path(const char *path) {
+    printf("\"");
+    for (const char *p = path; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        putchar(*p);
+    }
+    printf("\"");
+}
+
+/* Library order for --by-library: most shared first, then by path */
+static const LibTable *sort_table;
+static int lib_ref_cmp(const void *a, const void *b) {
+    const LibEntry *la = &sort_table->libs[*(const unsigned *)a];
+    const LibEntry *lb = &sort_table->libs[*(const unsigned *)b];
+    if (la->refcount != lb->refcount) return la->refcount < lb->refcount ? 1 : -1;
+    return strcmp(sort_table->arena + la->path_off, sort_table->arena + lb->path_off);
+}
+
+/* Reverse index: one row per (path, dev, inode) with refcount and the PIDs mapping it */
+static void print_by_library(const LibTable *t, const ProcLibs *processes, size_t count) {
+    /* CSR layout: pid lists for all libraries in one array, sliced by refcount */
+    size_t *start = calloc(t->lib_count + 1, sizeof(size_t));
+    size_t *fill = calloc(t->lib_count, sizeof(size_t));
+    unsigned *order = malloc(t->lib_count * sizeof(unsigned));
+    int *pids = NULL;
+    if (!start || !fill || !order) goto out;
+
+    for (size_t id = 0; id < t->lib_count; id++) start[id + 1] = start[id] + t->libs[id].refcount;
+    pids = malloc((start[t->lib_count] ? start[t->lib_count] : 1) * sizeof(int));
+    if (!pids) goto out;
+
+    /* processes are sorted by PID, so every list comes out sorted */
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < processes[i].lib_count; j++) {
+            unsigned id = processes[i].lib_ids[j];
+            pids[start[id] + fill[id]++] = processes[i].pid;
+        }
+    }
+
+    for (size_t id = 0; id < t->lib_count; id++) order[id] = (unsigned)id;
+    sort_table = t;
+    qsort(order, t->lib_count, sizeof(unsigned), lib_ref_cmp);
+
+    /* === OUTPUT – replace this block with your DB insert === */
+    /* Libraries only known from the cache (refcount 0) sort last and are not printed */
+    size_t shown = 0;
+    while (shown < t->lib_count && t->libs[order[shown]].refcount > 0) shown++;
+
+    printf("[\n");
+    for (size_t k = 0; k < shown; k++) {
+        unsigned id = order[k];
+        const LibEntry *e = &t->libs[id];
+        printf("  {\"path\":");
+        print_json_path(lib_path(t, id));
+        printf(",\"dev\":\"%02x:%02x\",\"inode\":%lu,\"refcount\":%zu,\"pids\":[",
+               e->dev_major, e->dev_minor, e->ino, e->refcount);
+        for (size_t j = start[id]; j < start[id + 1]; j++) {
+            printf("%d%s", pids[j], j + 1 < start[id + 1] ? "," : "");
+        }
+        printf("]}");
+        if (k < shown - 1) printf(",");
+        printf("\n");
+    }
+    printf("]\n");
+
+out:
+    free(start);
+    free(fill);
+    free(order);
+    free(pids);
 }
 
 /*
    Scanner: Loaded shared libraries (.so files) per process
-   Parses /proc/<pid>/maps and collects unique .so paths
+   Parses /proc/<pid>/maps and collects unique .so paths. Paths are interned once
+   host-wide (keyed by path + dev + inode), so each process holds only library ids.
    Output: JSON array of {pid, comm, libraries: [...]}
+   With by_library: JSON array of {path, dev, inode, refcount, pids: [...]}, most
+   shared first; a library replaced on disk shows up once per (dev, inode) still mapped.
+   With cache_file, maps (which takes the target's mmap_lock) is only re-read for
+   processes that are new, exec'd or changed VmLib since the previous run; the
+   others reuse their cached library set.
+   attrs adds namespace/cgroup/container columns or grouping to the per-process
+   output (scanner_proc_attrs.h); it does not apply to by_library.
+   budget (scanner_budget.h) stops the walk at its limit, resuming after its cursor
+   PID; cached sets of PIDs outside the range visited this cycle stay in the cache.
+   comm, the cache identity, maps and attributes are all read through the process's
+   ProcHandle (scanner_proc_handle.h), so a recycled PID cannot mix two processes.
 */
-void scan_loaded_shared_libraries(void)
+void scan_loaded_shared_libraries(bool by_library, const char *cache_file, const ProcScope *scope,
+                                  ProcAttrs *attrs, ScanBudget *budget)
 {
-    DIR *proc = opendir("/proc");
-    if (!proc) {
-        perror("opendir /proc");
+    LibTable table;
+    if (!lib_table_init(&table)) {
+        printf("[]\n");
+        return;
+    }
+
+    LibCache cache = { .procs = NULL, .count = 0, .capacity = 0 };
+    if (cache_file) lib_cache_load(&cache, &table, cache_file, budget);
+
+    ProcIter it;
+    if (!proc_iter_open_scope(&it, scope)) {
+        lib_cache_free(&cache);
+        lib_table_free(&table);
         return;
     }
+    int resume_after = budget_resume_pid(budget);
+    int stopped_at = 0;       /* first PID left for the next cycle */
+    proc_iter_resume_after(&it, resume_after);
 
     ProcLibs *processes = NULL;
     size_t capacity = 0;
     size_t count = 0;
 
-    struct dirent *ent;
-    while ((ent = readdir(proc)) != NULL) {
-        if (ent->d_type != DT_DIR) continue;
-        if (!isdigit((unsigned char)ent->d_name[0])) continue;
-
-        int pid = atoi(ent->d_name);
-        if (pid <= 0) continue;
-
-        /* Get comm */
-        char comm_path[64];
-        snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
-        FILE *fc = fopen(comm_path, "re");
-        char comm[17] = "[unknown]";
-        if (fc) {
-            if (fgets(comm, sizeof(comm), fc)) {
-                size_t len = strlen(comm);
-                if (len > 0 && comm[len-1] == '\n') comm[len-1] = '\0';
-            }
-            fclose(fc);
+    ProcHandle h;
+    while (proc_iter_next(&it, &h)) {
+        if (budget_stop(budget)) {
+            stopped_at = h.pid;
+            proc_handle_close(&h);
+            break;
         }
+        budget_done_pid(budget, h.pid);   /* once started, a process is always finished */
 
-        /* Open /proc/<pid>/maps */
-        char maps_path[64];
-        snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid);
-
-        FILE *fm = fopen(maps_path, "re");
-        if (!fm) continue;
-
-        ProcLibs info = { .pid = pid, .lib_count = 0, .lib_capacity = 0, .libs = NULL };
-        snprintf(info.comm, sizeof(info.comm), "%s", comm);
-        info.comm[sizeof(info.comm) - 1] = '\0';
-
-        char line[1024];
-        while (fgets(line, sizeof(line), fm)) {
-            /* Typical line: address           perms offset  dev   inode       pathname
-               Example: 7f8b5c000000-7f8b5c021000 r-xp 00000000 08:01 1234567 /usr/lib/x86_64-linux-gnu/libc.so.6
-            */
-            char *pathname = strrchr(line, '/');
-            if (!pathname) continue;
-
-            /* Look for .so at the end */
-            if (strstr(pathname, ".so") == NULL) continue;
+        ProcLibs info = { .pid = h.pid, .lib_count = 0, .lib_capacity = 0, .lib_ids = NULL };
+        snprintf(info.comm, sizeof(info.comm), "%s", proc_handle_comm(&h));
 
-            /* Trim trailing whitespace/newline */
-            char *end = pathname + strlen(pathname) - 1;
-            while (end >= pathname && isspace((unsigned char)*end)) *end-- = '\0';
+        const ProcLibs *cached = NULL;
+        if (cache_file) {
+            if (!read_proc_identity(&info, &h)) {   /* gone */
+                proc_handle_close(&h);
+                continue;
+            }
+            cached = lib_cache_lookup(&cache, &info);
+        }
 
-            add_library(&info, pathname);
+        if (cached) {
+            for (size_t j = 0; j < cached->lib_count; j++) add_library(&info, &table, cached->lib_ids[j]);
+        } else if (!read_maps_libs(&info, &h, &table, budget)) {
+            proc_handle_close(&h);
+            continue;
         }
-        fclose(fm);
 
         if (info.lib_count == 0) {
             free_proclib(&info);
+            proc_handle_close(&h);
             continue;
         }
 
@@ -123,18 +558,25 @@ void scan_loaded_shared_libraries(void)
             ProcLibs *new_proc = realloc(processes, capacity * sizeof(ProcLibs));
             if (!new_proc) {
                 free_proclib(&info);
+                proc_handle_close(&h);
                 continue;
             }
             processes = new_proc;
         }
 
+        if (!by_library && proc_attrs_enabled(attrs)) proc_attrs_read_at(attrs, h.dirfd, h.pid, &info.attr);
+        proc_handle_close(&h);
         processes[count++] = info;
     }
 
-    closedir(proc);
+    proc_iter_close(&it);
+    lib_cache_keep_unvisited(&cache, resume_after, stopped_at);
 
     if (count == 0) {
+        if (cache_file && cache.count) lib_cache_save(&table, NULL, 0, cache.procs, cache.count, cache_file);
+        lib_cache_free(&cache);
         free(processes);
+        lib_table_free(&table);
         printf("[]\n");
         return;
     }
@@ -142,38 +584,91 @@ void scan_loaded_shared_libraries(void)
     /* Sort by PID */
     qsort(processes, count, sizeof(ProcLibs), pid_cmp);
 
-    /* === OUTPUT – replace this block with your DB insert === */
-    printf("[\n");
-    for (size_t i = 0; i < count; i++) {
-        printf("  {\"pid\":%d,\"comm\":\"%s\",\"libraries\":[",
-               processes[i].pid, processes[i].comm);
+    if (cache_file) lib_cache_save(&table, processes, count, cache.procs, cache.count, cache_file);
+    lib_cache_free(&cache);
 
-        for (size_t j = 0; j < processes[i].lib_count; j++) {
-            /* Escape quotes in path (very rare in real paths, but safe) */
-            printf("\"");
-            for (char *p = processes[i].libs[j]; *p; p++) {
-                if (*p == '"' || *p == '\\') putchar('\\');
-                putchar(*p);
+    if (by_library) {
+        print_by_library(&table, processes, count);
+    } else {
+        proc_attrs_sort(attrs, processes, count, sizeof(ProcLibs), offsetof(ProcLibs, attr));
+
+        /* === OUTPUT – replace this block with your DB insert === */
+        printf("[\n");
+        for (size_t i = 0; i < count; i++) {
+            proc_attrs_row_sep(attrs, i ? &processes[i-1].attr : NULL, &processes[i].attr);
+            printf("{\"pid\":%d,\"comm\":\"%s\",\"libraries\":[",
+                   processes[i].pid, processes[i].comm);
+
+            for (size_t j = 0; j < processes[i].lib_count; j++) {
+                print_json_path(lib_path(&table, processes[i].lib_ids[j]));
+                if (j < processes[i].lib_count - 1) printf(",");
             }
-            printf("\"");
-            if (j < processes[i].lib_count - 1) printf(",");
-        }
 
-        printf("]}");
-        if (i < count - 1) printf(",");
-        printf("\n");
+            printf("]");
+            proc_attrs_print(attrs, &processes[i].attr);
+            printf("}");
+        }
+        proc_attrs_end(attrs, true);
+        printf("]\n");
     }
-    printf("]\n");
 
     /* Cleanup */
     for (size_t i = 0; i < count; i++) {
         free_proclib(&processes[i]);
     }
     free(processes);
+    lib_table_free(&table);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    scan_loaded_shared_libraries();
+    bool by_library = false;
+    const char *cache_file = NULL;
+    ProcScope scope = { 0 };
+    ProcAttrs attrs;
+    proc_attrs_init(&attrs);
+    ScanBudget budget;
+    budget_init(&budget);
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (proc_scope_arg(&scope, argc, argv, &i)) continue;
+        if (proc_attrs_arg(&attrs, argc, argv, &i)) continue;
+        if (budget_arg(&budget, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--by-library") == 0) {
+            by_library = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_file = argv[++i];
+        } else {
+            bad_args = true;
+        }
+    }
+
+    if (bad_args) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "  %s                # Shared libraries per process → JSON\n", argv[0]);
+        fprintf(stderr, "  %s --by-library   # Library → {dev, inode, refcount, pids} reverse index\n", argv[0]);
+        fprintf(stderr, "  %s --cache <file> # Re-read maps only for new/exec'd/VmLib-changed processes\n", argv[0]);
+        fprintf(stderr, "  ... --budget-cpu-ms <ms> | --budget-wall-ms <ms> | --budget-io-kb <kb> | --max-core-pct <pct> --cursor <file>\n");
+        fprintf(stderr, "      # Stop at the budget and resume from the cursor next cycle; output gains coverage metadata\n");
+        fprintf(stderr, "  ... --cgroup <path>[,<path>...] [--cgroup-threads]\n");
+        fprintf(stderr, "      # Only processes in these cgroups and below (cgroup.procs, or TIDs from cgroup.threads)\n");
+        fprintf(stderr, "  ... --filter kthread=0,uid!=0,comm=GLOB|GLOB,ppid=N,tree=N,cgroup=PATH\n");
+        fprintf(stderr, "      # Only processes matching every term (key=v1|v2 or key!=v), checked before any other read\n");
+        fprintf(stderr, "  ... --ns | --group-by container|cgroup|pid_ns|mnt_ns|net_ns|user_ns\n");
+        fprintf(stderr, "      # Namespace/cgroup/container columns, or rows grouped by one of them (not with --by-library)\n");
+        return 1;
+    }
+
+    bool budgeted = budget_active(&budget);
+    budget_begin(&budget);
+    if (budgeted) printf("{\"rows\":");
+    scan_loaded_shared_libraries(by_library, cache_file, &scope, &attrs, &budget);
+    if (budgeted) {
+        budget_finish(&budget);
+        budget_print_coverage(&budget);
+    }
+    proc_scope_free(&scope);
+    proc_attrs_free(&attrs);
     return 0;
 }